@@ -43,7 +43,7 @@ Application::Application(int width, int height, const char* title)
       bloomPrefilterShader(0), bloomBlurShader(0), bloomCompositeShader(0),
       reprojectionShader(0), atrousShader(0),
       vao(0), vbo(0),
-      uboObjects(0), objectBufBindingPoint(0),
+      objectBufBindingPoint(0),
       curr_acc_index(0), frame_acc_count(1),
       last_fov(0.0f),
       reprojectionFBO(0), reprojectionTex(0),
@@ -55,6 +55,7 @@ Application::Application(int width, int height, const char* title)
 
     accFBO[0] = accFBO[1] = 0;
     for (int i = 0; i < 10; ++i) accTex[i] = 0;
+    sampleStatsTex[0] = sampleStatsTex[1] = 0;
     denoiseFBO[0] = denoiseFBO[1] = 0;
     denoiseTex[0] = denoiseTex[1] = 0;
     
@@ -89,8 +90,8 @@ Application::Application(int width, int height, const char* title)
     #endif
 
     glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
-    renderWidth = static_cast<int>(static_cast<float>(fbWidth) * resScale);
-    renderHeight = static_cast<int>(static_cast<float>(fbHeight) * resScale);
+    renderWidth = std::max(1, static_cast<int>(static_cast<float>(fbWidth) * resScale));
+    renderHeight = std::max(1, static_cast<int>(static_cast<float>(fbHeight) * resScale));
 
     glfwSetWindowUserPointer(window, this);
     glfwSetKeyCallback(window, Application::KeyCallback);
@@ -107,10 +108,12 @@ Application::Application(int width, int height, const char* title)
 Application::~Application() {
 
     shutdown_ImGui();
+    orbitPredictor.Stop();
     cleanup_trails();
 
     if (accFBO[0] != 0 || accFBO[1] != 0) glDeleteFramebuffers(2, accFBO);
     if (accTex[0] != 0) glDeleteTextures(10, accTex);
+    if (sampleStatsTex[0] != 0) glDeleteTextures(2, sampleStatsTex);
 
     if (reprojectionFBO != 0) glDeleteFramebuffers(1, &reprojectionFBO);
     if (reprojectionTex != 0) glDeleteTextures(1, &reprojectionTex);
@@ -127,7 +130,6 @@ Application::~Application() {
     }
     bloomMipChain.clear();
 
-    if (pathTracerShader != 0) glDeleteProgram(pathTracerShader);
     if (reprojectionShader != 0) glDeleteProgram(reprojectionShader);
     if (atrousShader != 0) glDeleteProgram(atrousShader);
     if (bloomPrefilterShader != 0) glDeleteProgram(bloomPrefilterShader);
@@ -137,10 +139,20 @@ Application::~Application() {
     
     if (sky_dome_texture_id != 0) glDeleteTextures(1, &sky_dome_texture_id);
     if (sphere_texture_array_id != 0) glDeleteTextures(1, &sphere_texture_array_id);
+    if (blue_noise_texture_id != 0) glDeleteTextures(1, &blue_noise_texture_id);
 
     if (vao != 0) glDeleteVertexArrays(1, &vao);
     if (vbo != 0) glDeleteBuffers(1, &vbo);
-    if (uboObjects != 0) glDeleteBuffers(1, &uboObjects);
+    objectBuffer.Release();
+    materialBuffer.Release();
+    bvhBuffer.Release();
+    bvhPrimitiveBuffer.Release();
+    lightBuffer.Release();
+    wavefrontPathTracer.Release();
+    tileCuller.Release();
+    visibilityPrepass.Release();
+    shaderVariants.Release(); // the path tracer programs
+    glDeleteQueries(PATH_TRACER_TIMER_COUNT, pathTracerTimers);
     
     if (window) glfwDestroyWindow(window);
     glfwTerminate();  
@@ -150,7 +162,18 @@ Application::~Application() {
 
 void Application::init() {
 
-    pathTracerShader = InitShader("./src/shaders/vshader.glsl", "./src/shaders/path_tracer_fs.glsl");
+    // The general variant; render() narrows it to the scene.
+    pathTracerShader = path_tracer_program(pathTracerVariant);
+    if (pathTracerShader == 0) exit(EXIT_FAILURE);
+    if (!wavefrontPathTracer.Init(shaderVariants)) {
+        std::cerr << "Warning: Wavefront path tracer unavailable, using the fragment pass." << std::endl;
+    }
+    if (!tileCuller.Init()) {
+        std::cerr << "Warning: Tile culling unavailable, camera rays walk the BVH." << std::endl;
+    }
+    if (!visibilityPrepass.Init()) {
+        std::cerr << "Warning: Visibility pre-pass unavailable, the path tracer finds its own first hits." << std::endl;
+    }
 
     reprojectionShader = InitShader("./src/shaders/vshader.glsl", "./src/shaders/reproject_fs.glsl");
     atrousShader = InitShader("./src/shaders/vshader.glsl", "./src/shaders/atrous_fs.glsl");
@@ -186,11 +209,10 @@ void Application::init() {
 
     camera = std::make_unique<Camera>();
 
-    init_trails();
     init_textures();
     init_framebuffers();
     load_scene_from_file("./saves/empty.scene");
-    init_uniform_buffer_object();
+    init_object_buffer();
     scan_for_save_files();
 
     glViewport(0, 0, fbWidth, fbHeight);
@@ -234,7 +256,8 @@ void Application::render() {
     // --- Camera State Update ---
 
     camera->UpdateCameraVectors();
-    update_uniform_buffer_object();
+    update_object_buffer();
+    select_path_tracer_variant();
 
     vec4 curr_cam_pos = camera->Position;
     vec4 curr_cam_quat = camera->OrientationQuat;
@@ -243,7 +266,7 @@ void Application::render() {
     float curr_yaw = camera->Yaw;
     float curr_pitch = camera->Pitch;
 
-    bool camera_is_stationary = (curr_fov == last_fov && curr_distance == last_distance && curr_yaw == last_yaw && curr_pitch == last_pitch && timeScale == last_timeScale && selectedObjectIndex == lastSelectedObjectIndex);
+    bool camera_is_stationary = (curr_fov == last_fov && curr_distance == last_distance && curr_yaw == last_yaw && curr_pitch == last_pitch && timeScale == last_timeScale && selectedObject == lastSelectedObject);
 
     if (camera_is_stationary) {
 
@@ -265,43 +288,97 @@ void Application::render() {
     last_yaw = curr_yaw;
     last_pitch = curr_pitch;
     last_timeScale = timeScale;
-    lastSelectedObjectIndex = selectedObjectIndex;
+    lastSelectedObject = selectedObject;
 
     int writeIndex = curr_acc_index;
     int readIndex = 1 - curr_acc_index;
 
     // --- PASS 1: Ray Trace the Scene ---
 
-    glUseProgram(pathTracerShader);
-    
-    glUniform4fv(glGetUniformLocation(pathTracerShader, "camPos"), 1, camera->Position);
-    glUniform4fv(glGetUniformLocation(pathTracerShader, "camRot_quat"), 1, camera->OrientationQuat);
-    glUniform1f(glGetUniformLocation(pathTracerShader, "camFov"), DegreesToRadians * camera->Fov);
-    glUniform2f(glGetUniformLocation(pathTracerShader, "res"), (float)renderWidth, (float)renderHeight);
-    glUniform1f(glGetUniformLocation(pathTracerShader, "time"), static_cast<float>(glfwGetTime()));
-    glUniform1f(glGetUniformLocation(pathTracerShader, "nearPlane"), 0.01f);
-    glUniform1f(glGetUniformLocation(pathTracerShader, "farPlane"), 1.0e10f);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, accFBO[writeIndex]);
-    glViewport(0, 0, renderWidth, renderHeight);
-
-    glUniform1i(glGetUniformLocation(pathTracerShader, "frame_count"), frame_acc_count);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, accTex[readIndex * 5 + 0]);
-    glUniform1i(glGetUniformLocation(pathTracerShader, "previous_acc"), 0);
 
     glActiveTexture(GL_TEXTURE0 + 1);
     glBindTexture(GL_TEXTURE_2D, sky_dome_texture_id);
-    glUniform1i(glGetUniformLocation(pathTracerShader, "skyDomeTexture"), 1);
 
     if (sphere_texture_array_id != 0) {
         glActiveTexture(GL_TEXTURE0 + 2);
         glBindTexture(GL_TEXTURE_2D_ARRAY, sphere_texture_array_id);
-        glUniform1i(glGetUniformLocation(pathTracerShader, "sphere_texture_array"), 2);
     }
 
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glActiveTexture(GL_TEXTURE0 + 3);
+    glBindTexture(GL_TEXTURE_2D, blue_noise_texture_id);
+
+    glActiveTexture(GL_TEXTURE0 + 4);
+    glBindTexture(GL_TEXTURE_2D, sampleStatsTex[readIndex]);
+
+    unsigned int frameIndex = samplerFrameIndex++;
+    bool wavefront = useWavefrontPathTracer && wavefrontPathTracer.IsReady();
+    bool prepass = !wavefront && useVisibilityPrepass && visibilityPrepass.IsReady() && visibilityPrepass.GetDepthStencilTexture() != 0;
+    for (GLuint program : pathTracerPixelShaders) prepass = prepass && program != 0;
+    if (tileCulling && tileCuller.IsReady()) {
+        for (int i = 0; i < TileCuller::GetProgramCount(); ++i)
+            set_path_tracer_uniforms(tileCuller.GetPrograms()[i], frameIndex);
+    }
+    if (wavefront) {
+        for (int i = 0; i < WavefrontPathTracer::GetProgramCount(); ++i)
+            set_path_tracer_uniforms(wavefrontPathTracer.GetPrograms()[i], frameIndex);
+    }
+    else if (prepass) {
+        set_path_tracer_uniforms(visibilityPrepass.GetProgram(), frameIndex);
+        for (GLuint program : pathTracerPixelShaders) set_path_tracer_uniforms(program, frameIndex);
+        glActiveTexture(GL_TEXTURE0 + 5);
+        glBindTexture(GL_TEXTURE_2D, visibilityPrepass.GetObjectTexture());
+    }
+    else {
+        set_path_tracer_uniforms(pathTracerShader, frameIndex);
+        glBindFramebuffer(GL_FRAMEBUFFER, accFBO[writeIndex]);
+        glViewport(0, 0, renderWidth, renderHeight);
+    }
+
+    int timer = pathTracerTimerFrame % PATH_TRACER_TIMER_COUNT;
+    if (pathTracerTimerFrame >= PATH_TRACER_TIMER_COUNT) read_path_tracer_timer(timer);
+    glBeginQuery(GL_TIME_ELAPSED, pathTracerTimers[timer]);
+
+    if (tileCulling && tileCuller.IsReady()) tileCuller.Build(renderWidth, renderHeight, gpuObjectsActive);
+    if (wavefront) {
+        wavefrontPathTracer.Render(renderWidth, renderHeight, adaptiveSampling, &accTex[writeIndex * 5], sampleStatsTex[writeIndex]);
+    }
+    else if (prepass) {
+        visibilityPrepass.Render(writeIndex, gpuObjectsActive);
+        // The pre-pass wrote the G-buffer; each pixel class only adds colour
+        // and sample statistics.
+        const GLenum colorTargets[6] = { GL_COLOR_ATTACHMENT0, GL_NONE, GL_NONE, GL_NONE, GL_NONE, GL_COLOR_ATTACHMENT5 };
+        const GLenum allTargets[6] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2,
+                                       GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5 };
+        glBindFramebuffer(GL_FRAMEBUFFER, accFBO[writeIndex]);
+        glDrawBuffers(6, colorTargets);
+        glBindVertexArray(vao);
+        for (int i = 0; i < VisibilityPrepass::PIXEL_CLASS_COUNT; ++i) {
+            glUseProgram(pathTracerPixelShaders[i]);
+            visibilityPrepass.SelectPixels(static_cast<VisibilityPrepass::PixelClass>(i));
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        }
+        visibilityPrepass.EndPixels();
+        glDrawBuffers(6, allTargets);
+    }
+    else {
+        glUseProgram(pathTracerShader);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    objectBuffer.EndFrame(); // the path tracer is the only reader of the object buffers
+    materialBuffer.EndFrame();
+    bvhBuffer.EndFrame();
+    bvhPrimitiveBuffer.EndFrame();
+    lightBuffer.EndFrame();
+
+    glEndQuery(GL_TIME_ELAPSED);
+    glBindTexture(GL_TEXTURE_2D, sampleStatsTex[writeIndex]);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    pathTracerTimerObjects[timer] = gpuObjectsActive;
+    pathTracerTimerPixels[timer] = static_cast<size_t>(renderWidth) * renderHeight;
+    pathTracerTimerFrame++;
 
     // --- PASS 2: Temporal Reprojection ---
 
@@ -531,148 +608,259 @@ void Application::render() {
 }
 
 void Application::update() {
-    vec3 centerOfMass(0.0f);
-    if (!sceneObjects.empty()) {
-        vec3 weightedPositionSum(0.0f);
-        float totalMass = 0.0f;
-        for (const auto& obj_ptr : sceneObjects) {
-            weightedPositionSum += obj_ptr->GetPosition() * obj_ptr->Mass;
-            totalMass += obj_ptr->Mass;
-        }
-        if (totalMass > 0.0f) {
-            centerOfMass = weightedPositionSum / totalMass;
+    poll_catalog_import();
+    poll_scene_save();
+
+    float scaled_dt = dt * timeScale;
+
+    // The centre of mass and momentum come from the conservation monitor, which
+    // the physics step fills as it goes.
+    if (scaled_dt > 0.0f) {
+        float step_dt = scaled_dt / physicsSubsteps;
+        int mergeCount = 0;
+        for (int s = 0; s < physicsSubsteps; ++s) {
+            PhysicsStepStats stats = physics.Step(sceneObjects.Dense(), step_dt);
+            analyticBodyCount = stats.analyticBodies;
+            regularizedPairCount = stats.regularizedPairs;
+            mergeCount += stats.mergeCount;
+            for (const TypeTransitionEvent& event : physics.GetTypeTransitions()) log_type_transition(event);
+            // Merged-away bodies release their own trail; survivors keep theirs.
+            if (stats.mergeCount > 0) {
+                sceneObjects.Resync([](const std::unique_ptr<SceneObject>& obj) { return obj->Handle; },
+                                    [this](ObjectHandle gone) { release_object_resources(gone); });
+            }
         }
+        simulationTime += scaled_dt;
+        if (mergeCount > 0) mark_prediction_reseed();
+    }
+    else {
+        physics.MeasureConservedQuantities(sceneObjects.Dense());
     }
-    
-    float scaled_dt = dt * timeScale;
 
+    const ConservedQuantities& totals = physics.GetConservationStats().current;
+    vec3 centerOfMass = totals.centerOfMass;
     if (scaled_dt > 0.0f) {
+        update_trails(centerOfMass, totals.centerOfMassVelocity);
+        update_conservation_monitor();
+    }
 
-        std::vector<int> objects_to_delete;
-        objects_to_delete.reserve(sceneObjects.size());
+    if (showPredictions) update_predictions(centerOfMass);
 
-        for (int i = 0; i < sceneObjects.size(); ++i) {
+    if (SceneObject* selected = selected_object()) 
+        camera->Target = selected->GetPosition();
+    else camera->Target = centerOfMass;
+}
 
-            if (std::find(objects_to_delete.begin(), objects_to_delete.end(), i) != objects_to_delete.end()) {
-                continue;
-            }
+void Application::init_object_buffer() {
+    size_t initialSize = sizeof(ObjectBufferHeader) + sizeof(GPUpackedObject) * INITIAL_GPU_OBJECT_CAPACITY;
 
-            vec3 totalForce(0.0f);
-            
-            for (int j = 0; j < sceneObjects.size(); ++j) {
-                if (i == j) continue;
-                
-                if (std::find(objects_to_delete.begin(), objects_to_delete.end(), j) != objects_to_delete.end()) {
-                    continue;
-                }
+    if (!objectBuffer.Init(GL_SHADER_STORAGE_BUFFER, initialSize) ||
+        !materialBuffer.Init(GL_SHADER_STORAGE_BUFFER, sizeof(GPUmaterial) * INITIAL_GPU_OBJECT_CAPACITY) ||
+        !bvhBuffer.Init(GL_SHADER_STORAGE_BUFFER, sizeof(GPUbvhNode) * 2 * INITIAL_GPU_OBJECT_CAPACITY) ||
+        !bvhPrimitiveBuffer.Init(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t) * INITIAL_GPU_OBJECT_CAPACITY) ||
+        !lightBuffer.Init(GL_SHADER_STORAGE_BUFFER, sizeof(LightBufferHeader) + sizeof(GPUlight) * INITIAL_GPU_OBJECT_CAPACITY))
+        std::cerr << "Error: Could not create the object buffers." << std::endl;
 
-                SceneObject& obj_i = *sceneObjects[i];
-                SceneObject& obj_j = *sceneObjects[j];
-                vec3 direction = obj_j.GetPosition() - obj_i.GetPosition();
-                float distanceSq = dot(direction, direction);
-                float distance = sqrt(distanceSq);
+    GLuint blockIndex = glGetProgramResourceIndex(pathTracerShader, GL_SHADER_STORAGE_BLOCK, "object_buf");
+    if (blockIndex == GL_INVALID_INDEX) 
+        std::cerr << "Error: Storage block 'object_buf' not found in shader." << std::endl;
+    else glShaderStorageBlockBinding(pathTracerShader, blockIndex, objectBufBindingPoint);
 
-                float radius_i = obj_i.GetGpuObject(0).r1;
-                float radius_j = obj_j.GetGpuObject(0).r1;
-                if (distance <= (radius_i + radius_j)) {
+    blockIndex = glGetProgramResourceIndex(pathTracerShader, GL_SHADER_STORAGE_BLOCK, "material_buf");
+    if (blockIndex == GL_INVALID_INDEX) 
+        std::cerr << "Error: Storage block 'material_buf' not found in shader." << std::endl;
+    else glShaderStorageBlockBinding(pathTracerShader, blockIndex, materialBufBindingPoint);
 
+    blockIndex = glGetProgramResourceIndex(pathTracerShader, GL_SHADER_STORAGE_BLOCK, "bvh_buf");
+    if (blockIndex == GL_INVALID_INDEX) 
+        std::cerr << "Error: Storage block 'bvh_buf' not found in shader." << std::endl;
+    else glShaderStorageBlockBinding(pathTracerShader, blockIndex, bvhBufBindingPoint);
 
-                    SceneObject* larger_obj = (obj_i.Mass > obj_j.Mass) ? &obj_i : &obj_j;
-                    SceneObject* smaller_obj = (obj_i.Mass > obj_j.Mass) ? &obj_j : &obj_i;
-                    int smaller_obj_index = (obj_i.Mass > obj_j.Mass) ? j : i;
+    blockIndex = glGetProgramResourceIndex(pathTracerShader, GL_SHADER_STORAGE_BLOCK, "bvh_prim_buf");
+    if (blockIndex == GL_INVALID_INDEX) 
+        std::cerr << "Error: Storage block 'bvh_prim_buf' not found in shader." << std::endl;
+    else glShaderStorageBlockBinding(pathTracerShader, blockIndex, bvhPrimitiveBufBindingPoint);
 
-                    vec3 new_velocity = (larger_obj->velocity * larger_obj->Mass + smaller_obj->velocity * smaller_obj->Mass) / (larger_obj->Mass + smaller_obj->Mass);
+    blockIndex = glGetProgramResourceIndex(pathTracerShader, GL_SHADER_STORAGE_BLOCK, "light_buf");
+    if (blockIndex == GL_INVALID_INDEX) 
+        std::cerr << "Error: Storage block 'light_buf' not found in shader." << std::endl;
+    else glShaderStorageBlockBinding(pathTracerShader, blockIndex, lightBufBindingPoint);
 
-                    float r1_cubed = std::pow(larger_obj->GetGpuObject(0).r1, 3);
-                    float r2_cubed = std::pow(smaller_obj->GetGpuObject(0).r1, 3);
-                    float new_radius = std::cbrt(r1_cubed + r2_cubed);
+    glGenQueries(PATH_TRACER_TIMER_COUNT, pathTracerTimers);
+}
 
-                    larger_obj->Mass += smaller_obj->Mass;
-                    larger_obj->velocity = new_velocity;
-                    larger_obj->GetGpuObject(0).r1 = new_radius;
-                    
-                    objects_to_delete.push_back(smaller_obj_index);
-                    
-                    break; 
-                }
-                
-                if (gravityEnabled) {
-                    if (distanceSq < 1.0f) distanceSq = 1.0f;
-                    float forceMagnitude = gravitationalConstant * (obj_i.Mass * obj_j.Mass) / distanceSq;
-                    totalForce += normalize(direction) * forceMagnitude;
-                }
+// Writes this frame's ring regions. Transforms go out with the rotation
+// matrix and squared radii the intersection tests use already worked out,
+// and materials go to their own table; either is copied only where it differs
+// from what the region already holds, so materials are written only after
+// an edit (or when bodies are reordered) and a still scene uploads nothing.
+// The BVH over the same objects is refitted (or rebuilt) and uploaded too,
+// and so is the alias table the path tracer samples lights from.
+void Application::update_object_buffer() {
+    size_t gpuObjectCount = 0;
+    for (const auto& sceneObj : sceneObjects) gpuObjectCount += sceneObj->GetGpuObjectCount();
+
+    size_t requiredSize = sizeof(ObjectBufferHeader) + sizeof(GPUpackedObject) * gpuObjectCount;
+    if (!objectBuffer.Grow(requiredSize) || !materialBuffer.Grow(sizeof(GPUmaterial) * gpuObjectCount))
+        std::cerr << "Error: Could not grow the object buffers for " << gpuObjectCount << " objects." << std::endl;
+    objectBuffer.BeginFrame();
+    materialBuffer.BeginFrame();
+
+    size_t capacity = std::min((objectBuffer.GetRegionSize() - sizeof(ObjectBufferHeader)) / sizeof(GPUpackedObject),
+                               materialBuffer.GetRegionSize() / sizeof(GPUmaterial));
+    ObjectBufferHeader header;
+    sceneFeatures = 0;
+    gpuObjectBounds.clear();
+    lightPowers.clear();
+    lightObjects.clear();
+    for (const auto& sceneObj : sceneObjects) {
+        for (size_t i = 0; i < sceneObj->GetGpuObjectCount() && static_cast<size_t>(header.num_objects_active) < capacity; ++i) {
+            const GPUobject& gpuObj = sceneObj->GetGpuObject(i);
+            uint32_t index = static_cast<uint32_t>(header.num_objects_active);
+            GPUpackedObject packed = pack_gpu_object(gpuObj, index);
+            objectBuffer.Write(sizeof(ObjectBufferHeader) + index * sizeof(GPUpackedObject), &packed, sizeof(packed));
+            materialBuffer.Write(index * sizeof(GPUmaterial), &gpuObj.m, sizeof(GPUmaterial));
+            vec3 extent(std::max(gpuObj.r1, gpuObj.r2)); // sphere radius or ring outer radius
+            gpuObjectBounds.push_back({ gpuObj.center - extent, gpuObj.center + extent });
+            if (packed.bits & GPU_OBJECT_EMISSIVE_BIT) {
+                lightPowers.push_back(emitted_power(gpuObj));
+                lightObjects.push_back(index);
             }
-            sceneObjects[i]->ApplyForce(totalForce, scaled_dt);
-        }
-
-        if (!objects_to_delete.empty()) {
-            std::sort(objects_to_delete.rbegin(), objects_to_delete.rend());
-            
-            for (int index : objects_to_delete) {
-                sceneObjects.erase(sceneObjects.begin() + index);
+            if (gpuObj.type == 1) sceneFeatures |= PathTracerVariant::RINGS;
+            if (gpuObj.m.textureID > -1) {
+                // Layers past the array clamp to the last one; assume the worst.
+                size_t layer = static_cast<size_t>(gpuObj.m.textureID);
+                sceneFeatures |= PathTracerVariant::TEXTURES;
+                if (layer >= textureLayerTranslucent.size() || textureLayerTranslucent[layer]) sceneFeatures |= PathTracerVariant::ALPHA;
             }
-            init_trails();
+            header.num_objects_active++;
         }
-
-        for (auto& obj : sceneObjects) {
-            obj->Update(scaled_dt);
-        }
-
-        update_trails(centerOfMass);
     }
+    gpuObjectsActive = header.num_objects_active;
+
+    objectBvh.Update(gpuObjectBounds);
+    const std::vector<GPUbvhNode>& nodes = objectBvh.GetNodes();
+    const std::vector<uint32_t>& primitives = objectBvh.GetPrimitiveIndices();
+    if (!bvhBuffer.Grow(sizeof(GPUbvhNode) * nodes.size()) || !bvhPrimitiveBuffer.Grow(sizeof(uint32_t) * primitives.size()))
+        std::cerr << "Error: Could not grow the BVH buffers for " << nodes.size() << " nodes." << std::endl;
+    bvhBuffer.BeginFrame();
+    bvhPrimitiveBuffer.BeginFrame();
+    if (bvhBuffer.GetRegionSize() >= sizeof(GPUbvhNode) * nodes.size() &&
+        bvhPrimitiveBuffer.GetRegionSize() >= sizeof(uint32_t) * primitives.size()) {
+        for (size_t i = 0; i < nodes.size(); ++i) bvhBuffer.Write(i * sizeof(GPUbvhNode), &nodes[i], sizeof(GPUbvhNode));
+        if (!primitives.empty()) bvhPrimitiveBuffer.Write(0, primitives.data(), sizeof(uint32_t) * primitives.size());
+        header.num_bvh_nodes = static_cast<int>(nodes.size());
+    }
+    objectBuffer.Write(0, &header, sizeof(header));
+
+    lightTable.Build(lightPowers, lightObjects);
+    const std::vector<GPUlight>& lights = lightTable.GetEntries();
+    if (!lightBuffer.Grow(sizeof(LightBufferHeader) + sizeof(GPUlight) * lights.size()))
+        std::cerr << "Error: Could not grow the light buffer for " << lights.size() << " lights." << std::endl;
+    lightBuffer.BeginFrame();
+    LightBufferHeader lightHeader;
+    if (lightBuffer.GetRegionSize() >= sizeof(LightBufferHeader) + sizeof(GPUlight) * lights.size()) {
+        if (!lights.empty()) lightBuffer.Write(sizeof(LightBufferHeader), lights.data(), sizeof(GPUlight) * lights.size());
+        lightHeader.num_lights = static_cast<int>(lights.size());
+        lightHeader.total_power = static_cast<float>(lightTable.GetTotalPower());
+    }
+    lightBuffer.Write(0, &lightHeader, sizeof(lightHeader));
 
-    if (selectedObjectIndex >= 0 && selectedObjectIndex < sceneObjects.size()) 
-        camera->Target = sceneObjects[selectedObjectIndex]->GetPosition();
-    else camera->Target = centerOfMass;
+    objectBuffer.BindRange(objectBufBindingPoint);
+    materialBuffer.BindRange(materialBufBindingPoint);
+    bvhBuffer.BindRange(bvhBufBindingPoint);
+    bvhPrimitiveBuffer.BindRange(bvhPrimitiveBufBindingPoint);
+    lightBuffer.BindRange(lightBufBindingPoint);
 }
 
-void Application::init_uniform_buffer_object() {
-    size_t maxUboSize = sizeof(GPUobject) * MAX_OBJECTS_CPP + sizeof(int);
-
-    glGenBuffers(1, &uboObjects);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboObjects);
-    glBufferData(GL_UNIFORM_BUFFER, maxUboSize, NULL, GL_DYNAMIC_DRAW);
-    GLuint blockIndex = glGetUniformBlockIndex(pathTracerShader, "object_buf");
-    if (blockIndex == GL_INVALID_INDEX) 
-        std::cerr << "Error: Uniform block 'object_buf' not found in shader." << std::endl;
-    glUniformBlockBinding(pathTracerShader, blockIndex, objectBufBindingPoint);
-    glBindBufferBase(GL_UNIFORM_BUFFER, objectBufBindingPoint, uboObjects);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+// The fragment pass of variant, built the first time it is asked for; for
+// one class of the visibility pre-pass's pixels if pixelClass is given.
+GLuint Application::path_tracer_program(const PathTracerVariant& variant, const char* pixelClass) {
+    std::string defines = variant.ToDefines();
+    if (pixelClass) defines += std::string("#define VISIBILITY_PREPASS\n#define ") + pixelClass + "\n";
+    return shaderVariants.Get("path_tracer_fs", defines, [&defines]() {
+        return link_shader_program({
+            compile_shader_stage(GL_VERTEX_SHADER, { "./src/shaders/vshader.glsl" }),
+            compile_shader_stage(GL_FRAGMENT_SHADER, { "./src/shaders/path_tracer_common.glsl", "./src/shaders/path_tracer_fs.glsl" },
+                                 GLSL_VERSION_LINE + defines)
+        });
+    });
 }
 
-void Application::update_uniform_buffer_object() {
-    ObjectUBOData uboData;
-    int current_gpu_object_index = 0;
-
-    for (const auto& sceneObj : sceneObjects) {
-        for (size_t i = 0; i < sceneObj->GetGpuObjectCount(); ++i) {
-            if (current_gpu_object_index >= MAX_OBJECTS_CPP) {
-                std::cerr << "Warning: Exceeded maximum number of GPU objects!" << std::endl;
-                break;
+// Narrows the path tracer in use to what this frame's scene needs, so
+// shading never branches over features no object has. Only the pass that
+// will run is built; a variant that fails to build falls back to the
+// general one, which init() built.
+void Application::select_path_tracer_variant() {
+    PathTracerVariant variant;
+    variant.features = sceneFeatures;
+    if (nextEventEstimation) variant.features |= PathTracerVariant::NEXT_EVENT_ESTIMATION;
+    variant.maxBounces = maxBounces;
+    variant.samplesPerFrame = samplesPerFrame;
+
+    if (useWavefrontPathTracer && wavefrontPathTracer.IsReady()) {
+        if (!wavefrontPathTracer.SetVariant(shaderVariants, variant))
+            wavefrontPathTracer.SetVariant(shaderVariants, PathTracerVariant());
+    }
+    else {
+        bool prepass = useVisibilityPrepass && visibilityPrepass.IsReady();
+        if (variant == pathTracerVariant && (!prepass || pathTracerPixelShaders[0] != 0)) return;
+
+        GLuint program = path_tracer_program(variant);
+        pathTracerShader = program != 0 ? program : path_tracer_program(PathTracerVariant());
+        for (int i = 0; i < VisibilityPrepass::PIXEL_CLASS_COUNT; ++i) {
+            program = 0;
+            if (prepass) {
+                const char* pixelClass = VisibilityPrepass::GetPixelClassDefine(static_cast<VisibilityPrepass::PixelClass>(i));
+                program = path_tracer_program(variant, pixelClass);
+                if (program == 0) program = path_tracer_program(PathTracerVariant(), pixelClass);
             }
-            uboData.objects[current_gpu_object_index] = sceneObj->GetGpuObject(i);
-            current_gpu_object_index++;
+            pathTracerPixelShaders[i] = program;
         }
+        pathTracerVariant = variant;
     }
-    uboData.num_objects_active = current_gpu_object_index;
+}
 
-    size_t maxUboSize = sizeof(GPUobject) * MAX_OBJECTS_CPP + sizeof(int);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboObjects);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, maxUboSize, &uboData);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+// Everything the path tracer stages read besides the scene buffers; the
+// textures themselves are bound to units 0-5 by render().
+void Application::set_path_tracer_uniforms(GLuint program, unsigned int frameIndex) {
+    glUseProgram(program);
+
+    glUniform4fv(glGetUniformLocation(program, "camPos"), 1, camera->Position);
+    glUniform4fv(glGetUniformLocation(program, "camRot_quat"), 1, camera->OrientationQuat);
+    glUniform1f(glGetUniformLocation(program, "camFov"), DegreesToRadians * camera->Fov);
+    glUniform2f(glGetUniformLocation(program, "res"), (float)renderWidth, (float)renderHeight);
+    glUniform1ui(glGetUniformLocation(program, "frame_index"), frameIndex);
+    glUniform1i(glGetUniformLocation(program, "sampler_mode"), samplerMode);
+    glUniform1i(glGetUniformLocation(program, "adaptive_sampling"), adaptiveSampling ? 1 : 0);
+    glUniform1f(glGetUniformLocation(program, "nearPlane"), 0.01f);
+    glUniform1f(glGetUniformLocation(program, "farPlane"), 1.0e10f);
+    glUniform1i(glGetUniformLocation(program, "frame_count"), frame_acc_count);
+    glUniform1i(glGetUniformLocation(program, "tile_culling"), tileCulling && tileCuller.IsReady() ? 1 : 0);
+
+    glUniform1i(glGetUniformLocation(program, "previous_acc"), 0);
+    glUniform1i(glGetUniformLocation(program, "skyDomeTexture"), 1);
+    glUniform1i(glGetUniformLocation(program, "sphere_texture_array"), 2);
+    glUniform1i(glGetUniformLocation(program, "blueNoiseTexture"), 3);
+    glUniform1i(glGetUniformLocation(program, "previous_stats"), 4);
+    glUniform1i(glGetUniformLocation(program, "visibility_objects"), 5);
 }
 
 void Application::init_framebuffers() {
 
     glGenFramebuffers(2, accFBO);
     glGenTextures(10, accTex);
-    GLenum attachments[5] = { 
+    glGenTextures(2, sampleStatsTex);
+    GLenum attachments[6] = { 
         GL_COLOR_ATTACHMENT0, // Final Color 
         GL_COLOR_ATTACHMENT1, // World Normal 
         GL_COLOR_ATTACHMENT2, // Albedo 
         GL_COLOR_ATTACHMENT3, // World Position 
-        GL_COLOR_ATTACHMENT4  // ObjectInfo (ID, Metallic, Roughness)
+        GL_COLOR_ATTACHMENT4, // ObjectInfo (ID, Metallic, Roughness)
+        GL_COLOR_ATTACHMENT5  // Sample statistics (luminance second moment, count, relative error)
     };
+    int statsLevels = 1;
+    while ((std::max(renderWidth, renderHeight) >> statsLevels) > 0) statsLevels++;
 
     for (int i = 0; i < 2; ++i) {
         glBindFramebuffer(GL_FRAMEBUFFER, accFBO[i]);
@@ -683,10 +871,24 @@ void Application::init_framebuffers() {
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
             glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + j, GL_TEXTURE_2D, accTex[i * 5 + j], 0);
         }
-        glDrawBuffers(5, attachments);
+        // 32-bit floats: sample counts grow past what half floats count exactly.
+        glBindTexture(GL_TEXTURE_2D, sampleStatsTex[i]);
+        glTexStorage2D(GL_TEXTURE_2D, statsLevels, GL_RGBA32F, renderWidth, renderHeight);
+        glClearTexImage(sampleStatsTex[i], 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT5, GL_TEXTURE_2D, sampleStatsTex[i], 0);
+        glDrawBuffers(6, attachments);
         if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
             std::cerr << "ERROR::FRAMEBUFFER:: G-Buffer FBO " << i << " is not complete!" << std::endl;
     }
+    // The visibility pre-pass writes into the G-buffers, and its stencil
+    // selects pixels for the path tracer.
+    visibilityPrepass.Resize(renderWidth, renderHeight, accTex);
+    for (int i = 0; i < 2; ++i) {
+        glBindFramebuffer(GL_FRAMEBUFFER, accFBO[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, visibilityPrepass.GetDepthStencilTexture(), 0);
+    }
 
     glGenFramebuffers(1, &reprojectionFBO);
     glBindFramebuffer(GL_FRAMEBUFFER, reprojectionFBO);
@@ -769,6 +971,7 @@ void Application::init_framebuffers() {
 void Application::init_textures() {
 
      init_sky_dome_texture("./textures/skydome2.jpg");
+     init_blue_noise_texture();
 
     std::vector<std::string> texture_paths = {
         "./textures/saturn_rings2.png",
@@ -804,6 +1007,8 @@ void Application::init_sphere_texture_array(const std::vector<std::string>& path
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, Width, Height, paths.size());
+    // Layers that fail to load keep undefined contents, so they count as translucent.
+    textureLayerTranslucent.assign(paths.size(), true);
     
     stbi_set_flip_vertically_on_load(true);
 
@@ -821,6 +1026,12 @@ void Application::init_sphere_texture_array(const std::vector<std::string>& path
             }
             
             glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            // The shaders treat alpha below 0.99 (252 of 255) as translucent;
+            // filtering between texels above that stays above it.
+            bool translucent = false;
+            size_t bytes = static_cast<size_t>(width) * height * 4;
+            for (size_t k = 3; k < bytes && !translucent; k += 4) translucent = data[k] <= 252;
+            textureLayerTranslucent[i] = translucent;
             
             std::cout << "Loaded texture '" << paths[i] << "' into texture array layer " << i << std::endl;
             stbi_image_free(data);
@@ -866,6 +1077,30 @@ void Application::init_sky_dome_texture(const char* filePath) {
 
 }
 
+// Two independent blue-noise tiles, one per channel, so each 2D sample the
+// path tracer draws in blue-noise mode is blue in both coordinates.
+void Application::init_blue_noise_texture() {
+    std::vector<float> x = generate_blue_noise(BLUE_NOISE_SIZE, 1);
+    std::vector<float> y = generate_blue_noise(BLUE_NOISE_SIZE, 2);
+    std::vector<float> texels(2 * x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        texels[2 * i] = x[i];
+        texels[2 * i + 1] = y[i];
+    }
+
+    glGenTextures(1, &blue_noise_texture_id);
+    glBindTexture(GL_TEXTURE_2D, blue_noise_texture_id);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, BLUE_NOISE_SIZE, BLUE_NOISE_SIZE, 0, GL_RG, GL_FLOAT, texels.data());
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 void Application::init_ImGui() {
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -902,17 +1137,40 @@ void Application::render_ImGui() {
 
    if (ImGui::CollapsingHeader("File Operations")) {
         // --- SAVE Section ---
-        static char save_filename_buffer[128] = "new.scene";
+        static char save_filename_buffer[128] = "new";
         ImGui::InputText("Save Filename", save_filename_buffer, sizeof(save_filename_buffer));
         if (ImGui::Button("Save Scene")) {
+            std::string final_path = "./saves/" + std::string(save_filename_buffer);
+            if (std::filesystem::path(final_path).extension() != ".sceneb") {
+                final_path += ".sceneb";
+            }
+            save_scene_to_file(final_path);
+            scan_for_save_files();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Export as Text")) {
             std::string final_path = "./saves/" + std::string(save_filename_buffer);
             if (std::filesystem::path(final_path).extension() != ".scene") {
                 final_path += ".scene";
             }
-            save_scene_to_file(final_path);
+            export_scene_as_text(final_path);
             scan_for_save_files();
         }
 
+        ImGui::Checkbox("Autosave", &autosaveEnabled);
+        if (autosaveEnabled) {
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(120.0f);
+            ImGui::DragFloat("Interval (min)", &autosaveIntervalMinutes, 0.1f, 0.5f, 120.0f, "%.1f");
+        }
+        if (sceneSaver.IsRunning()) {
+            ImGui::ProgressBar(sceneSaver.GetProgress(), ImVec2(-1.0f, 0.0f), "Saving...");
+        }
+        else if (!saveStatus.empty()) {
+            if (saveFailed) ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "Save failed: %s", saveStatus.c_str());
+            else ImGui::TextDisabled("%s", saveStatus.c_str());
+        }
+
         ImGui::Separator();
 
         // --- LOAD Section ---
@@ -938,11 +1196,87 @@ void Application::render_ImGui() {
                 load_scene_from_file(final_path);
             }
         }
+
+        ImGui::Separator();
+
+        // --- CATALOG IMPORT Section ---
+        static char catalog_path_buffer[256] = "./catalogs/MPCORB.DAT";
+        ImGui::Text("Import Orbital Catalog (around selected body):");
+        ImGui::InputText("Catalog File", catalog_path_buffer, sizeof(catalog_path_buffer));
+
+        const char* catalog_formats[] = { "Auto Detect", "CSV (a, e, i, om, w, ma)", "MPC Fixed Width" };
+        int format_index = static_cast<int>(catalogSettings.format);
+        if (ImGui::Combo("Catalog Format", &format_index, catalog_formats, IM_ARRAYSIZE(catalog_formats))) {
+            catalogSettings.format = static_cast<CatalogFormat>(format_index);
+        }
+        ImGui::DragFloat("Scene Units per AU", &catalogSettings.unitsPerAU, 1.0f, 1.0f, 10000.0f);
+        ImGui::DragFloat("Body Mass (0 = test particle)", &catalogSettings.bodyMass, 0.001f, 0.0f, 10.0f);
+        ImGui::DragFloat("Body Radius", &catalogBodyRadius, 0.01f, 0.01f, 5.0f);
+        ImGui::Checkbox("Trails for Imported Bodies", &catalogTrails);
+
+        if (catalogImporter.IsRunning() || catalogImporter.HasPendingBodies()) {
+            char overlay[64];
+            std::snprintf(overlay, sizeof(overlay), "%zu bodies", catalogImporter.GetParsedCount());
+            ImGui::ProgressBar(catalogImporter.GetProgress(), ImVec2(-1.0f, 0.0f), overlay);
+            if (ImGui::Button("Cancel Import")) {
+                catalogImporter.Cancel();
+            }
+        }
+        else if (ImGui::Button("Import Catalog")) {
+            start_catalog_import(catalog_path_buffer);
+        }
+
+        std::string catalog_error = catalogImporter.GetError();
+        if (!catalog_error.empty()) {
+            ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "%s", catalog_error.c_str());
+        }
+        else if (catalogImporter.GetRejectedCount() > 0) {
+            ImGui::Text("Skipped %zu unreadable or unbound rows.", catalogImporter.GetRejectedCount());
+        }
     }
 
     if (ImGui::CollapsingHeader("Global Physics Settings")) {
-        ImGui::Checkbox("Enable Gravity", &gravityEnabled);
-        ImGui::DragFloat("Gravitational Constant", &gravitationalConstant, 0.01f, 0.0f, 10.0f);
+        ImGui::Checkbox("Enable Gravity", &physics.Settings.gravityEnabled);
+        if (ImGui::DragFloat("Gravitational Constant", &physics.Settings.gravitationalConstant, 0.01f, 0.0f, 10.0f)) {
+            physics.InvalidateAccelerations();
+            mark_prediction_reseed();
+        }
+
+        const char* integrators[] = { "Semi-implicit Euler", "Leapfrog (KDK)" };
+        int integrator_index = static_cast<int>(physics.Settings.integrator);
+        if (ImGui::Combo("Integrator", &integrator_index, integrators, IM_ARRAYSIZE(integrators))) {
+            physics.Settings.integrator = static_cast<IntegratorType>(integrator_index);
+            physics.InvalidateAccelerations();
+            mark_prediction_reseed();
+        }
+        ImGui::SliderInt("Physics Threads", &physics.Settings.threadCount, 1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+
+        if (ImGui::Checkbox("Kepler Propagation", &physics.Settings.keplerPropagation)) mark_prediction_reseed();
+        if (physics.Settings.keplerPropagation) {
+            ImGui::DragFloat("Perturbation Threshold", &physics.Settings.keplerThreshold, 0.0001f, 0.0f, 0.1f, "%.4f");
+            ImGui::SliderInt("Check Interval (steps)", &physics.Settings.keplerCheckInterval, 1, 240);
+            ImGui::Text("Analytic bodies: %zu / %zu", analyticBodyCount, sceneObjects.size());
+        }
+
+        if (ImGui::Checkbox("Regularize Close Encounters", &physics.Settings.regularizeEncounters)) mark_prediction_reseed();
+        if (physics.Settings.regularizeEncounters) {
+            ImGui::DragFloat("Encounter Distance", &physics.Settings.encounterDistance, 0.05f, 0.0f, 100.0f);
+            ImGui::DragFloat("Encounter Time (steps)", &physics.Settings.encounterDynamicalSteps, 0.5f, 1.0f, 256.0f);
+            ImGui::Text("Regularized pairs: %zu", regularizedPairCount);
+        }
+
+        if (ImGui::Checkbox("Show Predicted Paths", &showPredictions)) {
+            if (!showPredictions) {
+                orbitPredictor.Stop();
+                predictedPaths.reset();
+            }
+            predictionReseed = true;
+        }
+        if (showPredictions) {
+            // A new horizon keeps the scene indices, so current paths stay valid
+            // until the predictor publishes the longer or shorter ones.
+            if (ImGui::DragFloat("Prediction Horizon (s)", &predictionHorizon, 0.5f, 1.0f, 600.0f)) predictionReseed = true;
+        }
         
         // --- IME CONTROL ---
         ImGui::Separator();
@@ -953,14 +1287,58 @@ void Application::render_ImGui() {
         }
         ImGui::SameLine();
         ImGui::SliderFloat("Time Scale", &timeScale, 0.0f, 20.0f);
+        if (ImGui::SliderInt("Physics Substeps", &physicsSubsteps, 1, MAX_PHYSICS_SUBSTEPS)) {
+            physics.ResetConservationBaseline();
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Conservation Monitor")) {
+        render_conservation_monitor();
+    }
+
+    if (ImGui::CollapsingHeader("Type Transitions")) {
+        render_transition_log();
+    }
+
+    if (ImGui::CollapsingHeader("Render Throughput")) {
+        render_throughput_monitor();
+    }
+
+    const char* samplerModes[] = { "Owen-scrambled Sobol", "Blue noise" };
+    if (ImGui::Combo("Sampler", &samplerMode, samplerModes, IM_ARRAYSIZE(samplerModes))) {
+        frame_acc_count = 1;
+    }
+    if (ImGui::Checkbox("Adaptive Sampling", &adaptiveSampling)) {
+        frame_acc_count = 1;
+    }
+    if (ImGui::SliderInt("Samples per Frame", &samplesPerFrame, 1, WavefrontPathTracer::MAX_SAMPLES_PER_PIXEL)) {
+        frame_acc_count = 1;
+    }
+    if (ImGui::SliderInt("Max Bounces", &maxBounces, 1, MAX_PATH_TRACER_BOUNCES)) {
+        frame_acc_count = 1;
+    }
+    if (ImGui::Checkbox("Next Event Estimation", &nextEventEstimation)) {
+        frame_acc_count = 1;
+    }
+    ImGui::Text("Shader variants built: %zu", shaderVariants.GetVariantCount());
+    if (wavefrontPathTracer.IsReady()) {
+        ImGui::Checkbox("Wavefront Path Tracer", &useWavefrontPathTracer);
+        if (useWavefrontPathTracer) {
+            ImGui::Text("Wavefront buffers: %zu MiB", wavefrontPathTracer.GetBufferBytes() / (1024 * 1024));
+        }
+    }
+    if (tileCuller.IsReady()) {
+        if (ImGui::Checkbox("Tiled Culling", &tileCulling)) {
+            frame_acc_count = 1;
+        }
+    }
+    if (visibilityPrepass.IsReady() && !useWavefrontPathTracer) {
+        ImGui::Checkbox("Raster Visibility Pre-pass", &useVisibilityPrepass);
     }
     ImGui::Separator();
 
     if (ImGui::Button("Add New Scene Object...")) {
-        SceneObject* parentObject = nullptr;
-        if (selectedObjectIndex >= 0 && selectedObjectIndex < sceneObjects.size()) {
-            parentObject = sceneObjects[selectedObjectIndex].get();
-        }
+        SceneObject* parentObject = selected_object();
         if (parentObject) {
             float parentRadius = parentObject->GetGpuObject(0).r1;
             newObjectDistance = parentRadius * 3.0f;
@@ -983,10 +1361,10 @@ void Application::render_ImGui() {
     if (ImGui::BeginPopupModal("Create New Object", &showAddObjectPopup, ImGuiWindowFlags_AlwaysAutoResize)) {
         
         ImGui::Text("Configure the new object to be placed in orbit around the selected target.");
-        if (selectedObjectIndex == -1) {
+        if (SceneObject* target = selected_object()) {
+            ImGui::TextColored(ImVec4(0,1,1,1), "Target: %s", target->Name.c_str());
+        } else {
             ImGui::TextColored(ImVec4(1,1,0,1), "Target: World Origin (0,0,0)");
-        } else if (selectedObjectIndex < sceneObjects.size()){
-            ImGui::TextColored(ImVec4(0,1,1,1), "Target: %s", sceneObjects[selectedObjectIndex]->Name.c_str());
         }
         ImGui::Separator();
 
@@ -1041,111 +1419,195 @@ void Application::render_ImGui() {
     ImGui::Separator();
 
     // --- Loop over SceneObjects ---
-    for (int i = 0; i < sceneObjects.size(); ++i) {
-        ImGui::PushID(i); 
+    // Widgets are keyed by slot, so their state follows the body when others
+    // are added or removed.
+    if (sceneObjects.size() <= MAX_LISTED_OBJECTS) {
+        for (size_t i = 0; i < sceneObjects.size(); ++i) {
+            ObjectHandle handle = sceneObjects.HandleAt(i);
+            ImGui::PushID(static_cast<int>(handle.index));
+            bool deleted = render_object_editor(handle);
+            ImGui::PopID();
+            if (deleted) break;
+        }
+    }
+    else {
+        // Large scenes (e.g. imported catalogs): edit the selected object and
+        // list the rest through a clipper so only visible rows are submitted.
+        ImGui::Text("%zu objects in scene. Select one to edit it.", sceneObjects.size());
+        if (sceneObjects.Contains(selectedObject)) {
+            ImGui::PushID(static_cast<int>(selectedObject.index));
+            render_object_editor(selectedObject);
+            ImGui::PopID();
+        }
 
-        SceneObject& sceneObj = *sceneObjects[i];
-        std::string object_label = sceneObj.Name + " " + std::to_string(i);
+        ImGui::BeginChild("Object List", ImVec2(0.0f, 250.0f), true);
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(sceneObjects.size()));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                ObjectHandle handle = sceneObjects.HandleAt(i);
+                ImGui::PushID(static_cast<int>(handle.index));
+                std::string object_label = sceneObjects[i]->Name + " " + std::to_string(handle.index);
+                if (ImGui::Selectable(object_label.c_str(), handle == selectedObject)) {
+                    selectedObject = handle;
+                }
+                ImGui::PopID();
+            }
+        }
+        ImGui::EndChild();
+    }
+    ImGui::End();
+}
 
-        if (ImGui::CollapsingHeader(object_label.c_str())) {
+bool Application::render_object_editor(ObjectHandle handle) {
+    SceneObject& sceneObj = **sceneObjects.Get(handle);
+    int i = static_cast<int>(sceneObjects.DenseIndex(handle)); // the predictor's index for it
+    std::string object_label = sceneObj.Name + " " + std::to_string(handle.index);
 
-            const char* typeName = "Unknown";
-            switch(sceneObj.Type) {
-                case ObjectType::Star: typeName = "Star"; break;
-                case ObjectType::BrownDwarf: typeName = "Brown Dwarf"; break;
-                case ObjectType::GasGiant: typeName = "Gas Giant"; break;
-                case ObjectType::RockyPlanet: typeName = "Rocky Planet"; break;
-                case ObjectType::BlackHole: typeName = "Black Hole"; break;
-            }
-            ImGui::Text("Current Type: %s", typeName);
+    if (ImGui::CollapsingHeader(object_label.c_str())) {
 
-            if (sceneObj.Type == ObjectType::GasGiant || sceneObj.Type == ObjectType::RockyPlanet) {
-                if (ImGui::Checkbox("Has Rings", &sceneObj.hasRings)) {
-                    sceneObj.SetupAs(sceneObj.Type);
-                }
-            }
+        const char* typeName = "Unknown";
+        switch(sceneObj.Type) {
+            case ObjectType::Star: typeName = "Star"; break;
+            case ObjectType::BrownDwarf: typeName = "Brown Dwarf"; break;
+            case ObjectType::GasGiant: typeName = "Gas Giant"; break;
+            case ObjectType::RockyPlanet: typeName = "Rocky Planet"; break;
+            case ObjectType::BlackHole: typeName = "Black Hole"; break;
+        }
+        ImGui::Text("Current Type: %s", typeName);
 
-            if (ImGui::Button("Delete This Object")) {
-                ImGui::OpenPopup("Confirm Deletion");
+        if (sceneObj.Type == ObjectType::GasGiant || sceneObj.Type == ObjectType::RockyPlanet) {
+            if (ImGui::Checkbox("Has Rings", &sceneObj.hasRings)) {
+                sceneObj.SetupAs(sceneObj.Type);
             }
-            if (ImGui::BeginPopupModal("Confirm Deletion", NULL, ImGuiWindowFlags_AlwaysAutoResize)) {
-                ImGui::Text("Are you sure you want to delete %s %d?", sceneObj.Name.c_str(), i);
-                if (ImGui::Button("Yes, Delete")) {
-                    delete_object(i);
-                    ImGui::CloseCurrentPopup();
-                    ImGui::EndPopup();
-                    ImGui::PopID();
-                    break; 
-                }
-                ImGui::SameLine();
-                if (ImGui::Button("Cancel")) ImGui::CloseCurrentPopup();
+        }
+
+        if (ImGui::Button("Delete This Object")) {
+            ImGui::OpenPopup("Confirm Deletion");
+        }
+        if (ImGui::BeginPopupModal("Confirm Deletion", NULL, ImGuiWindowFlags_AlwaysAutoResize)) {
+            ImGui::Text("Are you sure you want to delete %s %u?", sceneObj.Name.c_str(), handle.index);
+            if (ImGui::Button("Yes, Delete")) {
+                delete_object(handle);
+                ImGui::CloseCurrentPopup();
                 ImGui::EndPopup();
+                return true;
             }
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel")) ImGui::CloseCurrentPopup();
+            ImGui::EndPopup();
+        }
 
-            ImGui::Separator();
+        ImGui::Separator();
 
-            ImGui::Text("Transform & Physics:");
-            vec3 pos = sceneObj.GetPosition();
-            if (ImGui::DragFloat3("Position", &pos.x, 0.1f)) {
-                sceneObj.SetPosition(pos);
-                frame_acc_count = 1;
-            }
+        ImGui::Text("Transform & Physics:");
+        vec3 pos = sceneObj.GetPosition();
+        if (ImGui::DragFloat3("Position", &pos.x, 0.1f)) {
+            sceneObj.SetPosition(pos);
+            physics.InvalidateAccelerations();
+            mark_prediction_edited(i);
+            frame_acc_count = 1;
+        }
 
-            float tempMass = sceneObj.Mass;
-            ImGui::InputFloat("Mass", &tempMass, 0.1f, 1.0f, "%.2f");
-            if (ImGui::IsItemDeactivatedAfterEdit()) {
-                sceneObj.Mass = tempMass;
-                frame_acc_count = 1;
-            }
-            
+        float tempMass = sceneObj.Mass;
+        ImGui::InputFloat("Mass", &tempMass, 0.1f, 1.0f, "%.2f");
+        if (ImGui::IsItemDeactivatedAfterEdit()) {
+            sceneObj.Mass = tempMass;
+            apply_type_transition(sceneObj);
+            physics.InvalidateAccelerations();
+            mark_prediction_edited(i);
+            frame_acc_count = 1;
+        }
+        
 
-            vec3 vel = sceneObj.velocity;
-            if (ImGui::DragFloat3("Velocity", &vel.x, 0.01f)) {
-                sceneObj.velocity = vel;
-            }
+        vec3 vel = sceneObj.velocity;
+        if (ImGui::DragFloat3("Velocity", &vel.x, 0.01f)) {
+            sceneObj.velocity = vel;
+            physics.InvalidateAccelerations();
+            mark_prediction_edited(i);
+            frame_acc_count = 1;
+        }
 
-            vec3 eulerAngles = quat_to_euler(sceneObj.Orientation);
-            
-            if (ImGui::DragFloat3("Orientation (Roll, Pitch, Yaw)", &eulerAngles.x, 0.5f, -180.0f, 180.0f)) {
-                sceneObj.Orientation = euler_to_quat(eulerAngles);
-                frame_acc_count = 1; 
-            }
+        vec3 eulerAngles = quat_to_euler(sceneObj.Orientation);
+        
+        if (ImGui::DragFloat3("Orientation (Roll, Pitch, Yaw)", &eulerAngles.x, 0.5f, -180.0f, 180.0f)) {
+            sceneObj.Orientation = euler_to_quat(eulerAngles);
+            frame_acc_count = 1; 
+        }
 
-            ImGui::DragFloat3("Angular Velocity", &sceneObj.AngularVelocity.x, 0.01f);
-            if (ImGui::Button("Reset Rotation")) {
-                sceneObj.ResetRotation();
-            }
+        ImGui::DragFloat3("Angular Velocity", &sceneObj.AngularVelocity.x, 0.01f);
+        if (ImGui::Button("Reset Rotation")) {
+            sceneObj.ResetRotation();
+        }
 
-            ImGui::Separator();
-
-            for (size_t j = 0; j < sceneObj.GetGpuObjectCount(); ++j) {
-                ImGui::PushID(j);
-                GPUobject& gpuObj = sceneObj.GetGpuObject(j);
-                
-                std::string gpu_label = (gpuObj.type == 0) ? "Sphere Data" : "Ring Data";
-                if(ImGui::TreeNode(gpu_label.c_str())) {
-                     ImGui::DragFloat("Radius 1", &gpuObj.r1, 0.05f, 0.0f);
-                     if (gpuObj.type == 1) { 
-                         ImGui::DragFloat("Radius 2 (Inner)", &gpuObj.r2, 0.05f, 0.0f);
-                     }
-                     ImGui::Separator();
-                     ImGui::Text("Material:");
-                     ImGui::ColorEdit3("Albedo", &gpuObj.m.albedo.x);
-                     ImGui::InputInt("Texture ID", &gpuObj.m.textureID, 1, 10);
-                     ImGui::SliderFloat("Metallic", &gpuObj.m.metallic, 0.0f, 1.0f);
-                     ImGui::SliderFloat("Roughness", &gpuObj.m.roughness, 0.0f, 1.0f);
-                     ImGui::DragFloat("Emission", &gpuObj.m.emission, 10.0f, 0.0f, 50000.0f);
-                     ImGui::TreePop();
-                }
-                ImGui::PopID();
+        ImGui::Separator();
+
+        for (size_t j = 0; j < sceneObj.GetGpuObjectCount(); ++j) {
+            ImGui::PushID(j);
+            GPUobject& gpuObj = sceneObj.GetGpuObject(j);
+            
+            std::string gpu_label = (gpuObj.type == 0) ? "Sphere Data" : "Ring Data";
+            if(ImGui::TreeNode(gpu_label.c_str())) {
+                 ImGui::DragFloat("Radius 1", &gpuObj.r1, 0.05f, 0.0f);
+                 if (gpuObj.type == 1) { 
+                     ImGui::DragFloat("Radius 2 (Inner)", &gpuObj.r2, 0.05f, 0.0f);
+                 }
+                 ImGui::Separator();
+                 ImGui::Text("Material:");
+                 ImGui::ColorEdit3("Albedo", &gpuObj.m.albedo.x);
+                 ImGui::InputInt("Texture ID", &gpuObj.m.textureID, 1, 10);
+                 ImGui::SliderFloat("Metallic", &gpuObj.m.metallic, 0.0f, 1.0f);
+                 ImGui::SliderFloat("Roughness", &gpuObj.m.roughness, 0.0f, 1.0f);
+                 ImGui::DragFloat("Emission", &gpuObj.m.emission, 10.0f, 0.0f, 50000.0f);
+                 ImGui::TreePop();
             }
+            ImGui::PopID();
         }
-        ImGui::PopID();
     }
-    ImGui::End();
+    return false;
 }
 
 void Application::save_scene_to_file(const std::string& filename) {
+    if (sceneSaver.IsRunning()) {
+        std::cerr << "Error: Could not save scene to " << filename << ": a save is already in progress" << std::endl;
+        return;
+    }
+
+    // Capturing is a flat copy; formatting and disk I/O happen on the saver thread.
+    SceneSnapshot snapshot;
+    capture_scene_snapshot(sceneObjects.Dense(), snapshot);
+    sceneSaver.Start(filename, std::move(snapshot));
+    saveStatus = "Saving " + filename + "...";
+    saveFailed = false;
+}
+
+void Application::poll_scene_save() {
+    std::string path, error;
+    if (sceneSaver.PollFinished(path, error)) {
+        if (error.empty()) {
+            std::cout << "Scene saved to " << path << std::endl;
+            saveStatus = "Saved " + path;
+            saveFailed = false;
+            scan_for_save_files();
+        }
+        else {
+            std::cerr << "Error: Could not save scene: " << error << std::endl;
+            saveStatus = error;
+            saveFailed = true;
+        }
+    }
+
+    double now = glfwGetTime();
+    if (!autosaveEnabled) {
+        lastAutosaveTime = now;
+    }
+    else if (now - lastAutosaveTime >= autosaveIntervalMinutes * 60.0 && !sceneSaver.IsRunning()) {
+        save_scene_to_file("./saves/autosave.sceneb");
+        lastAutosaveTime = now;
+    }
+}
+
+void Application::export_scene_as_text(const std::string& filename) {
     std::ofstream outfile(filename);
     if (!outfile.is_open()) {
         std::cerr << "Error: Could not open file for writing: " << filename << std::endl;
@@ -1178,17 +1640,31 @@ void Application::save_scene_to_file(const std::string& filename) {
         outfile << "---" << std::endl;
     }
     outfile.close();
-    std::cout << "Scene saved to " << filename << std::endl;
+    std::cout << "Scene exported to " << filename << std::endl;
 }
 
 void Application::load_scene_from_file(const std::string& filename) {
+    if (is_binary_scene_file(filename)) {
+        std::string error;
+        std::vector<std::unique_ptr<SceneObject>> loaded;
+        if (!load_binary_scene(filename, loaded, error)) {
+            std::cerr << "Error: Could not load scene " << filename << ": " << error << std::endl;
+            return;
+        }
+        finish_scene_load(filename, std::move(loaded));
+        return;
+    }
+    import_scene_from_text(filename);
+}
+
+void Application::import_scene_from_text(const std::string& filename) {
     std::ifstream infile(filename);
     if (!infile.is_open()) {
         std::cerr << "Error: Could not open file for reading: " << filename << std::endl;
         return;
     }
 
-    sceneObjects.clear(); 
+    std::vector<std::unique_ptr<SceneObject>> loaded;
 
     size_t object_count;
     infile >> object_count;
@@ -1238,12 +1714,41 @@ void Application::load_scene_from_file(const std::string& filename) {
         std::string separator;
         infile >> separator; 
 
-        sceneObjects.push_back(std::move(new_scene_object));
+        loaded.push_back(std::move(new_scene_object));
     }
 
     infile.close();
+    finish_scene_load(filename, std::move(loaded));
+}
+
+void Application::apply_type_transition(SceneObject& obj) {
+    TypeTransitionEvent event;
+    if (!obj.CheckForTypeTransition(event)) return;
+    obj.ApplyTypeTransition(event);
+    log_type_transition(event);
+}
+
+void Application::log_type_transition(const TypeTransitionEvent& event) {
+    transitionLog.push_back(describe_type_transition(event));
+    if (transitionLog.size() > TRANSITION_LOG_LENGTH) transitionLog.erase(transitionLog.begin());
+    transitionCount++;
+}
+
+void Application::finish_scene_load(const std::string& filename, std::vector<std::unique_ptr<SceneObject>>&& loaded) {
+    // Every handle into the old scene goes stale, trails included.
+    cleanup_trails();
+    sceneObjects.Clear();
+    sceneObjects.Reserve(loaded.size());
+    for (auto& obj_ptr : loaded) {
+        // Types follow mass; a hand-written scene may disagree.
+        apply_type_transition(*obj_ptr);
+        insert_object(std::move(obj_ptr));
+    }
+    selectedObject = sceneObjects.empty() ? ObjectHandle() : sceneObjects.HandleAt(0);
+
+    physics.InvalidateAccelerations();
     frame_acc_count = 1;
-    init_trails();
+    mark_prediction_reseed();
     std::cout << "Scene loaded from " << filename << ". Total objects: " << sceneObjects.size() << std::endl;
 }
 
@@ -1259,13 +1764,75 @@ void Application::scan_for_save_files() {
     }
     
     for (const auto& entry : std::filesystem::directory_iterator(path)) {
-        if (entry.is_regular_file() && entry.path().extension() == ".scene") {
+        if (entry.is_regular_file() && (entry.path().extension() == ".scene" || entry.path().extension() == ".sceneb")) {
             saveFiles.push_back(entry.path().filename().string());
         }
     }
     std::cout << "Found " << saveFiles.size() << " save files." << std::endl;
 }
 
+void Application::start_catalog_import(const std::string& filename) {
+    SceneObject* parent = selected_object();
+    if (!parent) {
+        for (const auto& obj : sceneObjects) {
+            if (!parent || obj->Mass > parent->Mass) parent = obj.get();
+        }
+    }
+
+    if (!parent) {
+        std::cerr << "Error: Catalog import needs a parent body in the scene." << std::endl;
+        return;
+    }
+
+    catalogParentHandle = parent->Handle;
+    catalogParentPosition = parent->GetPosition();
+    catalogParentVelocity = parent->velocity;
+
+    catalogSettings.parentMass = parent->Mass;
+    catalogSettings.gravitationalConstant = physics.Settings.gravitationalConstant;
+    catalogSettings.threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    if (catalogImporter.Start(filename, catalogSettings)) {
+        catalogActive = true;
+        std::cout << "Importing catalog " << filename << " around " << parent->Name << std::endl;
+    }
+}
+
+void Application::poll_catalog_import() {
+    if (!catalogActive) return;
+
+    catalogBatch.clear();
+    catalogImporter.TakeBodies(catalogBatch, catalogBodiesPerFrame);
+
+    if (!catalogBatch.empty()) {
+        // Bodies are relative to the parent; follow it if it still exists.
+        if (const auto* parent = sceneObjects.Get(catalogParentHandle)) {
+            catalogParentPosition = (*parent)->GetPosition();
+            catalogParentVelocity = (*parent)->velocity;
+        }
+
+        sceneObjects.Reserve(sceneObjects.size() + catalogBatch.size());
+        for (ImportedBody& body : catalogBatch) {
+            auto new_obj = std::make_unique<SceneObject>(ObjectType::RockyPlanet, catalogParentPosition + body.position, 0.0f);
+            new_obj->Mass = catalogSettings.bodyMass;
+            new_obj->velocity = catalogParentVelocity + body.velocity;
+            new_obj->GetGpuObject(0).r1 = catalogBodyRadius;
+            new_obj->TrailEnabled = catalogTrails;
+            if (!body.name.empty()) new_obj->Name = std::move(body.name);
+            insert_object(std::move(new_obj));
+        }
+
+        physics.InvalidateAccelerations();
+        mark_prediction_reseed();
+        frame_acc_count = 1;
+    }
+
+    if (!catalogImporter.IsRunning() && !catalogImporter.HasPendingBodies()) {
+        std::cout << "Catalog import finished. Total objects: " << sceneObjects.size() << std::endl;
+        catalogActive = false;
+    }
+}
+
 vec3 Application::calculate_orbital_velocity(float parentMass, float newObjectMass, vec3 directionToNew, float distance, float eccentricity, float inclination) const {
 
     float totalMass = parentMass;
@@ -1274,7 +1841,7 @@ vec3 Application::calculate_orbital_velocity(float parentMass, float newObjectMa
 
     float semiMajorAxis = distance / (1.0f - eccentricity + 1e-6f);
     totalMass += newObjectMass;
-    float speedSq = gravitationalConstant * totalMass * ((2.0f / distance) - (1.0f / semiMajorAxis));
+    float speedSq = physics.Settings.gravitationalConstant * totalMass * ((2.0f / distance) - (1.0f / semiMajorAxis));
     
     if (speedSq < 0) {
         std::cerr << "Warning: Requested orbit is unstable (hyperbolic). Setting initial velocity to 0." << std::endl;
@@ -1300,12 +1867,8 @@ void Application::add_object(ObjectType type, float mass, float distance, float
     vec3 parentPosition = vec3(0.0f);
     SceneObject* parentObject = nullptr;
 
-    if (sceneObjects.empty()) {
-        selectedObjectIndex = -1; 
-    }
-
-    if (selectedObjectIndex >= 0 && selectedObjectIndex < sceneObjects.size()) {
-        parentObject = sceneObjects[selectedObjectIndex].get();
+    parentObject = selected_object();
+    if (parentObject) {
         parentMass = parentObject->Mass;
         parentVelocity = parentObject->velocity;
         parentPosition = parentObject->GetPosition();
@@ -1321,44 +1884,69 @@ void Application::add_object(ObjectType type, float mass, float distance, float
     
     auto new_obj = std::make_unique<SceneObject>(type, initialPosition, mass);
     new_obj->velocity = initialVelocity;
+    apply_type_transition(*new_obj);
     
-    sceneObjects.push_back(std::move(new_obj));
+    insert_object(std::move(new_obj));
+    physics.InvalidateAccelerations();
     frame_acc_count = 1;
-    init_trails();
+    mark_prediction_reseed();
 }
 
-void Application::delete_object(int obj_index) {
-    if (obj_index < 0 || obj_index >= sceneObjects.size()) {
-        std::cerr << "Error: Invalid index for object deletion." << std::endl;
+void Application::delete_object(ObjectHandle handle) {
+    if (!sceneObjects.Contains(handle)) {
+        std::cerr << "Error: Invalid handle for object deletion." << std::endl;
         return;
     }
-    sceneObjects.erase(sceneObjects.begin() + obj_index);
+    release_object_resources(handle);
+    sceneObjects.Remove(handle);
+    physics.InvalidateAccelerations();
 
     frame_acc_count = 1;
-    init_trails();
+    mark_prediction_reseed();
 
     std::cout << "Deleted object. Total scene objects: " << sceneObjects.size() << std::endl;
 }
 
-void Application::init_trails() {
-    cleanup_trails();
-    trailRenderers.resize(sceneObjects.size());
+ObjectHandle Application::insert_object(std::unique_ptr<SceneObject> obj) {
+    SceneObject* raw = obj.get();
+    ObjectHandle handle = sceneObjects.Insert(std::move(obj));
+    raw->Handle = handle;
 
-    for (int i = 0; i < sceneObjects.size(); ++i) {
-        glGenVertexArrays(1, &trailRenderers[i].vao);
-        glGenBuffers(1, &trailRenderers[i].vbo);
+    if (trailRenderers.size() < sceneObjects.SlotCount()) trailRenderers.resize(sceneObjects.SlotCount());
+    if (raw->TrailEnabled) init_trail_renderer(trailRenderers[handle.index]);
+    return handle;
+}
 
-        glBindVertexArray(trailRenderers[i].vao);
-        glBindBuffer(GL_ARRAY_BUFFER, trailRenderers[i].vbo);
-        
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3) + sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+// Frees what belongs to one body; everything else keeps its buffers.
+void Application::release_object_resources(ObjectHandle handle) {
+    if (handle == selectedObject) selectedObject = ObjectHandle();
+    if (handle.index >= trailRenderers.size()) return;
 
-        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(vec3) + sizeof(float), (void*)sizeof(vec3));
-        glEnableVertexAttribArray(1);
+    TrailRenderer& trail = trailRenderers[handle.index];
+    if (trail.vbo) glDeleteBuffers(1, &trail.vbo);
+    if (trail.vao) glDeleteVertexArrays(1, &trail.vao);
+    trail = TrailRenderer();
+}
 
-        glBindVertexArray(0);
-    }
+SceneObject* Application::selected_object() {
+    std::unique_ptr<SceneObject>* obj = sceneObjects.Get(selectedObject);
+    return obj ? obj->get() : nullptr;
+}
+
+void Application::init_trail_renderer(TrailRenderer& trail) {
+    glGenVertexArrays(1, &trail.vao);
+    glGenBuffers(1, &trail.vbo);
+
+    glBindVertexArray(trail.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, trail.vbo);
+    
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3) + sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(vec3) + sizeof(float), (void*)sizeof(vec3));
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
 }
 
 void Application::cleanup_trails() {
@@ -1367,30 +1955,237 @@ void Application::cleanup_trails() {
         if(trail.vao) glDeleteVertexArrays(1, &trail.vao);
     }
     trailRenderers.clear();
+
+    for (auto& trail : predictionRenderers) {
+        if (trail.vbo) glDeleteBuffers(1, &trail.vbo);
+        if (trail.vao) glDeleteVertexArrays(1, &trail.vao);
+    }
+    predictionRenderers.clear();
 }
 
-void Application::update_trails(const vec3& centerOfMass) {
-    if (sceneObjects.size() != trailRenderers.size()) 
-        init_trails();
-    
+void Application::mark_prediction_edited(int obj_index) {
+    predictionEdits.push_back(obj_index);
+}
+
+// Indices changed or the dynamics did: old paths no longer match any body.
+void Application::mark_prediction_reseed() {
+    predictionReseed = true;
+    predictionGeneration++;
+    predictionEdits.clear();
+    predictedPaths.reset();
+}
+
+void Application::update_predictions(const vec3& centerOfMass) {
+    orbitPredictor.SetTime(simulationTime);
+
+    if (predictionReseed || !predictionEdits.empty() || orbitPredictor.WantsSnapshot()) {
+        // Massless bodies without trails neither pull on anything nor get drawn.
+        std::vector<PredictionBody> bodies;
+        for (size_t i = 0; i < sceneObjects.size(); ++i) {
+            const SceneObject& obj = *sceneObjects[i];
+            if (obj.Mass == 0.0f && !obj.TrailEnabled) continue;
+            bodies.push_back({ static_cast<int>(i), obj.Type, obj.Mass, obj.GetGpuObject(0).r1,
+                               obj.GetPosition(), obj.velocity, obj.TrailEnabled });
+        }
+
+        PredictionSettings settings;
+        settings.physics = physics.Settings;
+        settings.physics.threadCount = 1;
+        settings.horizon = predictionHorizon;
+        settings.stepDt = dt * (timeScale > 0.0f ? timeScale : 1.0f) / physicsSubsteps;
+
+        std::sort(predictionEdits.begin(), predictionEdits.end());
+        predictionEdits.erase(std::unique(predictionEdits.begin(), predictionEdits.end()), predictionEdits.end());
+        orbitPredictor.Submit(std::move(bodies), settings, simulationTime, std::move(predictionEdits), predictionGeneration);
+        predictionEdits.clear();
+        predictionReseed = false;
+    }
+
+    std::shared_ptr<const PredictedPaths> paths;
+    if (orbitPredictor.TakePaths(paths) && paths && paths->generation == predictionGeneration) {
+        predictedPaths = paths;
+    }
+
     struct TrailVertex {
         vec3 pos;
         float age;
     };
 
-    float totalMass = 0.0f;
-    vec3 weightedVelocitySum(0.0f, 0.0f, 0.0f);
+    size_t pathCount = predictedPaths ? predictedPaths->points.size() : 0;
+    for (size_t p = pathCount; p < predictionRenderers.size(); ++p) predictionRenderers[p].pointCount = 0;
+    if (predictionRenderers.size() < pathCount) predictionRenderers.resize(pathCount);
+
+    std::vector<TrailVertex> vertices;
+    for (size_t p = 0; p < pathCount; ++p) {
+        TrailRenderer& trail = predictionRenderers[p];
+        trail.pointCount = 0;
+
+        int obj_index = predictedPaths->sceneIndices[p];
+        if (obj_index < 0 || obj_index >= static_cast<int>(sceneObjects.size())) continue;
+        if (trail.vbo == 0) init_trail_renderer(trail);
+
+        // The path starts at the body and runs through every sample still ahead
+        // of the present; age is the fraction of the horizon, as for trails.
+        const std::vector<vec3>& points = predictedPaths->points[p];
+        vertices.clear();
+        vertices.push_back({ sceneObjects[obj_index]->GetPosition(), 0.0f });
+        for (size_t k = 0; k < points.size(); ++k) {
+            double t = predictedPaths->startTime + k * static_cast<double>(predictedPaths->sampleInterval);
+            if (t <= simulationTime) continue;
+            float age = static_cast<float>((t - simulationTime) / predictedPaths->horizon);
+            if (age > 1.0f) break;
+            vertices.push_back({ points[k] + centerOfMass, age });
+        }
+        trail.pointCount = vertices.size();
 
-    for (const auto& obj_ptr : sceneObjects) {
-        weightedVelocitySum += obj_ptr->velocity * obj_ptr->Mass;
-        totalMass += obj_ptr->Mass;
+        glBindBuffer(GL_ARRAY_BUFFER, trail.vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TrailVertex), vertices.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+void Application::update_conservation_monitor() {
+    const ConservationStats& stats = physics.GetConservationStats();
+    bool wasWarning = conservationWarning;
+    conservationWarning = false;
+
+    // A new baseline (edits, merges, settings) starts a new plot.
+    if (!stats.hasBaseline || stats.energySamples == 0) energyDriftHistory.clear();
+    if (!stats.hasBaseline) return;
+
+    if (stats.energyValid) {
+        energyDriftHistory.push_back(static_cast<float>(std::log10(std::max(stats.energyDrift, 1e-12))));
+        if (energyDriftHistory.size() > DRIFT_HISTORY_LENGTH) energyDriftHistory.erase(energyDriftHistory.begin());
     }
 
+    bool energyExceeded = stats.energyDrift > energyDriftLimit;
+    bool momentumExceeded = stats.momentumDrift > momentumDriftLimit || stats.angularMomentumDrift > momentumDriftLimit;
+    if (!energyExceeded && !momentumExceeded) return;
+
+    // Halving the step is the remedy for integration error; merges and edits
+    // re-take the baseline themselves, so whatever is left here is drift.
+    if (autoReduceTimeStep && energyExceeded && physicsSubsteps < MAX_PHYSICS_SUBSTEPS) {
+        physicsSubsteps = std::min(physicsSubsteps * 2, MAX_PHYSICS_SUBSTEPS);
+        std::cout << "Energy drift " << stats.energyDrift << " exceeded " << energyDriftLimit
+                  << "; physics step reduced to 1/" << physicsSubsteps << " of a frame." << std::endl;
+        physics.ResetConservationBaseline();
+        energyDriftHistory.clear();
+        return;
+    }
+
+    conservationWarning = true;
+    if (!wasWarning) {
+        std::cerr << "Warning: conserved quantities drifted (energy " << stats.energyDrift << ", momentum "
+                  << stats.momentumDrift << ", angular momentum " << stats.angularMomentumDrift << ")." << std::endl;
+    }
+}
+
+void Application::render_conservation_monitor() {
+    const ConservationStats& stats = physics.GetConservationStats();
+    const ConservedQuantities& q = stats.current;
+
+    if (!stats.hasBaseline) {
+        ImGui::Text("Waiting for a full force pass...");
+    }
+    else {
+        ImGui::Text("Energy: %.6g (K %.4g, U %.4g)%s", q.Energy(), q.kinetic, q.potential, stats.energyValid ? "" : " *");
+        ImGui::Text("Energy drift: %.3e", stats.energyDrift);
+        ImGui::Text("Momentum drift: %.3e", stats.momentumDrift);
+        ImGui::Text("Angular momentum drift: %.3e", stats.angularMomentumDrift);
+        if (!energyDriftHistory.empty()) {
+            ImGui::PlotLines("log10 dE/E", energyDriftHistory.data(), static_cast<int>(energyDriftHistory.size()),
+                             0, nullptr, -12.0f, 0.0f, ImVec2(0, 80));
+        }
+        if (conservationWarning) {
+            ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "Drift above limits: reduce dt or switch integrator.");
+        }
+    }
+
+    ImGui::DragFloat("Energy Drift Limit", &energyDriftLimit, 1e-5f, 1e-8f, 1.0f, "%.1e", ImGuiSliderFlags_Logarithmic);
+    ImGui::DragFloat("Momentum Drift Limit", &momentumDriftLimit, 1e-6f, 1e-9f, 1.0f, "%.1e", ImGuiSliderFlags_Logarithmic);
+    ImGui::Checkbox("Reduce Time Step Automatically", &autoReduceTimeStep);
+    if (ImGui::Button("Reset Baseline")) {
+        physics.ResetConservationBaseline();
+        energyDriftHistory.clear();
+        conservationWarning = false;
+    }
+}
+
+void Application::render_transition_log() {
+    ImGui::Text("%zu transitions, latest %zu shown", transitionCount, transitionLog.size());
+    ImGui::BeginChild("Transition Log", ImVec2(0.0f, 120.0f), true);
+    for (auto it = transitionLog.rbegin(); it != transitionLog.rend(); ++it) ImGui::TextUnformatted(it->c_str());
+    ImGui::EndChild();
+    if (ImGui::Button("Clear Log")) {
+        transitionLog.clear();
+        transitionCount = 0;
+    }
+}
+
+void Application::read_path_tracer_timer(int timer) {
+    GLuint available = 0;
+    glGetQueryObjectuiv(pathTracerTimers[timer], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return; // the GPU is far behind; drop the sample rather than wait
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(pathTracerTimers[timer], GL_QUERY_RESULT, &elapsed);
+    int objects = pathTracerTimerObjects[timer];
+    size_t pixels = pathTracerTimerPixels[timer];
+    if (objects <= 0 || pixels == 0) return;
+
+    size_t bucket = 0;
+    while ((2 << bucket) <= objects) bucket++;
+    if (throughputCurve.size() <= bucket) throughputCurve.resize(bucket + 1);
+    ThroughputBucket& entry = throughputCurve[bucket];
+    entry.milliseconds += elapsed * 1e-6;
+    entry.nanosecondsPerPixel += static_cast<double>(elapsed) / pixels;
+    entry.samples++;
+}
 
-    for (int i = 0; i < sceneObjects.size(); ++i) {
-        SceneObject& obj = *sceneObjects[i];
+void Application::render_throughput_monitor() {
+    ImGui::Text("GPU objects: %d (buffers %zu + %zu KiB per frame)", gpuObjectsActive,
+                objectBuffer.GetRegionSize() / 1024, materialBuffer.GetRegionSize() / 1024);
+    ImGui::Text("Uploaded this frame: %zu bytes transforms, %zu bytes materials, %zu bytes BVH",
+                objectBuffer.GetBytesWritten(), materialBuffer.GetBytesWritten(),
+                bvhBuffer.GetBytesWritten() + bvhPrimitiveBuffer.GetBytesWritten());
+    ImGui::Text("Lights: %zu, total power %.3g", lightTable.GetEntries().size(), lightTable.GetTotalPower());
+    ImGui::Text("BVH: %zu nodes, cost %.1f (%.1f at build), %d builds", objectBvh.GetNodes().size(),
+                objectBvh.GetCost(), objectBvh.GetBuildCost(), objectBvh.GetBuildCount());
+
+    std::vector<float> curve(throughputCurve.size(), 0.0f);
+    for (size_t b = 0; b < throughputCurve.size(); ++b) {
+        const ThroughputBucket& entry = throughputCurve[b];
+        if (entry.samples == 0) continue;
+        curve[b] = static_cast<float>(entry.nanosecondsPerPixel / entry.samples);
+        ImGui::Text("%6d-%-6d objects: %7.2f ms, %8.2f ns/pixel", 1 << b, (2 << b) - 1,
+                    entry.milliseconds / entry.samples, entry.nanosecondsPerPixel / entry.samples);
+    }
+    if (!curve.empty()) {
+        ImGui::PlotHistogram("ns/pixel by log2 objects", curve.data(), static_cast<int>(curve.size()),
+                             0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 80));
+    }
+    if (ImGui::Button("Reset Throughput")) throughputCurve.clear();
+}
+
+void Application::update_trails(const vec3& centerOfMass, const vec3& centerOfMassVelocity) {
+    
+    struct TrailVertex {
+        vec3 pos;
+        float age;
+    };
 
-        float speed = length(obj.velocity - weightedVelocitySum / totalMass);
+    for (auto& obj_ptr : sceneObjects) {
+        SceneObject& obj = *obj_ptr;
+        TrailRenderer& trail = trailRenderers[obj.Handle.index];
+
+        if (!obj.TrailEnabled) {
+            obj.TrailPoints.clear();
+            trail.pointCount = 0;
+            continue;
+        }
+        if (trail.vbo == 0) init_trail_renderer(trail); // trail switched on in the editor
+
+        float speed = length(obj.velocity - centerOfMassVelocity);
 
         obj.MaxTrailPoints = static_cast<size_t>(30000 / (timeScale * (std::pow(speed, 2) + 1)));
         obj.TrailPoints.push_front(obj.GetPosition() - centerOfMass);
@@ -1405,10 +2200,10 @@ void Application::update_trails(const vec3& centerOfMass) {
             float age = (obj.MaxTrailPoints > 0) ? static_cast<float>(j) / static_cast<float>(obj.MaxTrailPoints) : 0.0f;
             vertices.push_back({ obj.TrailPoints[j] + centerOfMass, age });
         }
-        trailRenderers[i].pointCount = vertices.size();
+        trail.pointCount = vertices.size();
 
-        if (trailRenderers[i].pointCount > 0) {
-            glBindBuffer(GL_ARRAY_BUFFER, trailRenderers[i].vbo);
+        if (trail.pointCount > 0) {
+            glBindBuffer(GL_ARRAY_BUFFER, trail.vbo);
             glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TrailVertex), vertices.data(), GL_DYNAMIC_DRAW);
             glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
@@ -1432,12 +2227,13 @@ void Application::render_trails() {
     mat4 mvp = projection * view;
     
     glUniformMatrix4fv(glGetUniformLocation(trailShader, "mvp"), 1, GL_TRUE, mvp);
+    glUniform1f(glGetUniformLocation(trailShader, "dashCount"), 0.0f);
     
-    for (int i = 0; i < trailRenderers.size(); ++i) {
-
-        if (i >= sceneObjects.size() || i >= trailRenderers.size()) continue;
+    for (const auto& obj_ptr : sceneObjects) {
+        const SceneObject& sceneObj = *obj_ptr;
+        const TrailRenderer& trail = trailRenderers[sceneObj.Handle.index];
+        if (trail.pointCount < 2) continue;
 
-        const SceneObject& sceneObj = *sceneObjects[i];
         vec3 color = sceneObj.GetGpuObject(0).m.albedo;
         glUniform3fv(glGetUniformLocation(trailShader, "trailColor"), 1, pow((color + vec3(0.1f)) / 1.1f, 0.25));
 
@@ -1446,9 +2242,21 @@ void Application::render_trails() {
         glLineWidth(thickness);
 
 
-        if (trailRenderers[i].pointCount > 1) {
-            glBindVertexArray(trailRenderers[i].vao);
-            glDrawArrays(GL_LINE_STRIP, 0, trailRenderers[i].pointCount);
+        glBindVertexArray(trail.vao);
+        glDrawArrays(GL_LINE_STRIP, 0, trail.pointCount);
+    }
+
+    if (showPredictions && predictedPaths) {
+        glUniform1f(glGetUniformLocation(trailShader, "dashCount"), 48.0f);
+        glLineWidth(1.5f);
+        for (size_t p = 0; p < predictionRenderers.size() && p < predictedPaths->sceneIndices.size(); ++p) {
+            int obj_index = predictedPaths->sceneIndices[p];
+            if (predictionRenderers[p].pointCount < 2 || obj_index < 0 || obj_index >= static_cast<int>(sceneObjects.size())) continue;
+
+            vec3 color = sceneObjects[obj_index]->GetGpuObject(0).m.albedo;
+            glUniform3fv(glGetUniformLocation(trailShader, "trailColor"), 1, pow((color + vec3(0.1f)) / 1.1f, 0.25));
+            glBindVertexArray(predictionRenderers[p].vao);
+            glDrawArrays(GL_LINE_STRIP, 0, predictionRenderers[p].pointCount);
         }
     }
 
@@ -1497,16 +2305,21 @@ void Application::M_KeyCallback(int key, int scancode, int action, int mods) {
                 frame_acc_count = 1;
                 break;
             case GLFW_KEY_LEFT:
-                selectedObjectIndex = (selectedObjectIndex - 1) % sceneObjects.size();
-                frame_acc_count = 1;
-                break;
             case GLFW_KEY_RIGHT:
-                selectedObjectIndex = (selectedObjectIndex + 1) % sceneObjects.size();
+                if (!sceneObjects.empty()) {
+                    // Steps through the dense order; from no selection, starts at either end.
+                    size_t count = sceneObjects.size();
+                    size_t current = sceneObjects.DenseIndex(selectedObject);
+                    size_t next;
+                    if (current == SlotMap<std::unique_ptr<SceneObject>>::NOT_FOUND) next = (key == GLFW_KEY_LEFT) ? count - 1 : 0;
+                    else next = (key == GLFW_KEY_LEFT) ? (current + count - 1) % count : (current + 1) % count;
+                    selectedObject = sceneObjects.HandleAt(next);
+                }
                 frame_acc_count = 1;
                 break;
             case GLFW_KEY_UP:
             case GLFW_KEY_DOWN:
-                selectedObjectIndex = -1;
+                selectedObject = ObjectHandle();
                 frame_acc_count = 1;
                 break;
             case GLFW_KEY_ESCAPE:
@@ -1547,14 +2360,18 @@ void Application::M_ScrollCallback(double xoffset, double yoffset) {
     frame_acc_count = 1;
 }
 void Application::M_FramebufferSizeCallback(int width, int height) {
+    // A minimized window reports 0x0; the targets keep their size until it
+    // comes back, since immutable storage cannot be allocated empty.
+    if (width <= 0 || height <= 0) return;
 
     fbWidth = width;
     fbHeight = height;
 
-    renderWidth = static_cast<int>(static_cast<float>(fbWidth) * resScale);
-    renderHeight = static_cast<int>(static_cast<float>(fbHeight) * resScale);
+    renderWidth = std::max(1, static_cast<int>(static_cast<float>(fbWidth) * resScale));
+    renderHeight = std::max(1, static_cast<int>(static_cast<float>(fbHeight) * resScale));
 
     glDeleteTextures(10, accTex);
+    glDeleteTextures(2, sampleStatsTex);
     glDeleteFramebuffers(2, accFBO);
     
     for (const auto& mip : bloomMipChain) {
@@ -4,6 +4,20 @@
 #include "Camera.h"
 #include "UBOstructs.h"
 #include "SceneObject.h"
+#include "Physics.h"
+#include "CatalogImporter.h"
+#include "SceneFile.h"
+#include "OrbitPredictor.h"
+#include "GpuRingBuffer.h"
+#include "Bvh.h"
+#include "LightTable.h"
+#include "BlueNoise.h"
+#include "ShaderLoader.h"
+#include "ShaderVariantCache.h"
+#include "PathTracerVariant.h"
+#include "WavefrontPathTracer.h"
+#include "TileCuller.h"
+#include "VisibilityPrepass.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -15,6 +29,7 @@
 #include <sstream>
 #include <filesystem> 
 #include <algorithm>
+#include <thread>
 
 vec3 quat_to_euler(const vec4& q);
 vec4 euler_to_quat(const vec3& eulerDegrees);
@@ -38,41 +53,82 @@ private:
     void update();
     void render();
 
-    void init_uniform_buffer_object();
-    void update_uniform_buffer_object();
+    void init_object_buffer();
+    void update_object_buffer();
+    void read_path_tracer_timer(int timer);
+    void render_throughput_monitor();
 
     void init_framebuffers();
+    void set_path_tracer_uniforms(GLuint program, unsigned int frameIndex);
+    GLuint path_tracer_program(const PathTracerVariant& variant, const char* pixelClass = nullptr);
+    void select_path_tracer_variant();
 
     void init_textures();
     void init_sphere_texture_array(const std::vector<std::string>& paths);
     void init_sky_dome_texture(const char* filePath);
+    void init_blue_noise_texture();
 
     void init_ImGui();
     void render_ImGui();
+    bool render_object_editor(ObjectHandle handle);
     void shutdown_ImGui();
 
+    // Binary .sceneb is the native format; the text .scene format stays for import/export.
     void save_scene_to_file(const std::string& filename);
     void load_scene_from_file(const std::string& filename);
+    void export_scene_as_text(const std::string& filename);
+    void import_scene_from_text(const std::string& filename);
+    void finish_scene_load(const std::string& filename, std::vector<std::unique_ptr<SceneObject>>&& loaded);
+    void poll_scene_save();
     void scan_for_save_files();
 
+    void start_catalog_import(const std::string& filename);
+    void poll_catalog_import();
+
     vec3 calculate_orbital_velocity(float parentMass, float newObjectMass, vec3 directionToNew, float distance, float eccentricity, float inclination) const;
 
     void add_object(ObjectType type, float mass, float distance, float eccentricity, float inclination);
-    void delete_object(int obj_index);
+    void apply_type_transition(SceneObject& obj); // after editing its mass
+    void log_type_transition(const TypeTransitionEvent& event);
+    void delete_object(ObjectHandle handle);
 
-    void init_trails();
-    void update_trails(const vec3& centerOfMass);
+    // Bodies are addressed by handle; the trail renderer and ImGui IDs of a
+    // body live in its slot, so removing one body touches nothing else.
+    ObjectHandle insert_object(std::unique_ptr<SceneObject> obj);
+    void release_object_resources(ObjectHandle handle);
+    SceneObject* selected_object();
+    void update_trails(const vec3& centerOfMass, const vec3& centerOfMassVelocity);
     void render_trails();
     void cleanup_trails();
 
+    void mark_prediction_edited(int obj_index);
+    void mark_prediction_reseed();
+    void update_predictions(const vec3& centerOfMass);
+
+    void update_conservation_monitor();
+    void render_conservation_monitor();
+    void render_transition_log();
+
     struct TrailRenderer {
         GLuint vao = 0;
         GLuint vbo = 0;
         size_t pointCount = 0;
     };
-    std::vector<TrailRenderer> trailRenderers;
+    void init_trail_renderer(TrailRenderer& trail);
+    std::vector<TrailRenderer> trailRenderers; // indexed by slot
     GLuint trailShader = 0;
 
+    // Future paths from the background predictor, drawn dashed.
+    OrbitPredictor orbitPredictor;
+    std::shared_ptr<const PredictedPaths> predictedPaths;
+    std::vector<TrailRenderer> predictionRenderers;
+    bool showPredictions = false;
+    float predictionHorizon = 20.0f;
+    double simulationTime = 0.0;
+    unsigned int predictionGeneration = 1;
+    bool predictionReseed = true;
+    std::vector<int> predictionEdits;
+
     bool show_menu = true;
 
     GLFWwindow* window;
@@ -97,6 +153,10 @@ private:
     GLuint bloomCompositeShader;
 
     GLuint accFBO[2];
+    // Per-pixel sample statistics written next to the accumulated colour
+    // (luminance second moment, sample count, relative error), mipmapped so
+    // the next frame can read the mean error from the top level.
+    GLuint sampleStatsTex[2];
     GLuint accTex[10];
     int curr_acc_index; // 0 or 1
     int frame_acc_count;
@@ -117,22 +177,110 @@ private:
     GLuint atrousShader;    
    
     GLuint vao, vbo;
-    GLuint uboObjects;
+    // Triple-buffered, persistently mapped std430 storage grown with the scene:
+    // an ObjectBufferHeader followed by one GPUpackedObject per primitive, and
+    // the material table indexed the same way.
+    static const size_t INITIAL_GPU_OBJECT_CAPACITY = 64;
+    GpuRingBuffer objectBuffer;
+    GpuRingBuffer materialBuffer;
     GLuint objectBufBindingPoint = 0;
+    GLuint materialBufBindingPoint = 1;
+
+    // BVH over the primitives in objectBuffer, refitted every frame.
+    Bvh objectBvh;
+    std::vector<BvhBounds> gpuObjectBounds;
+    GpuRingBuffer bvhBuffer;
+    GpuRingBuffer bvhPrimitiveBuffer;
+    GLuint bvhBufBindingPoint = 2;
+    GLuint bvhPrimitiveBufBindingPoint = 3;
+
+    // Emitters, rebuilt into a power-weighted alias table every frame.
+    LightTable lightTable;
+    std::vector<float> lightPowers;
+    std::vector<uint32_t> lightObjects;
+    GpuRingBuffer lightBuffer;
+    GLuint lightBufBindingPoint = 4;
+    int gpuObjectsActive = 0;
+
+    // GPU time of the path tracing pass, read back a few frames late so the
+    // queries never stall, and averaged per power-of-two object count.
+    static const int PATH_TRACER_TIMER_COUNT = 4;
+    GLuint pathTracerTimers[PATH_TRACER_TIMER_COUNT] = {};
+    int pathTracerTimerObjects[PATH_TRACER_TIMER_COUNT] = {};
+    size_t pathTracerTimerPixels[PATH_TRACER_TIMER_COUNT] = {};
+    long long pathTracerTimerFrame = 0;
+    struct ThroughputBucket {
+        double milliseconds = 0.0;
+        double nanosecondsPerPixel = 0.0;
+        int samples = 0;
+    };
+    std::vector<ThroughputBucket> throughputCurve; // bucket b holds [2^b, 2^(b+1)) GPU objects
     
-    std::vector<std::unique_ptr<SceneObject>> sceneObjects;
+    SlotMap<std::unique_ptr<SceneObject>> sceneObjects;
 
     std::unique_ptr<Camera> camera;
     
     GLuint sky_dome_texture_id = 0;
     GLuint sphere_texture_array_id = 0;
+
+    // Path tracer sampling: which sequence the shader draws from (matches the
+    // SAMPLER_* constants in path_tracer_common.glsl), and a frame counter that
+    // never resets so accumulated frames keep walking the sequence.
+    enum SamplerMode { SAMPLER_SOBOL = 0, SAMPLER_BLUE_NOISE = 1 };
+    static const int BLUE_NOISE_SIZE = 64;
+    int samplerMode = SAMPLER_SOBOL;
+    unsigned int samplerFrameIndex = 0;
+    bool adaptiveSampling = true;
+    // Path tracer shader variants, built on demand. The one in use has the
+    // features some object needs (sceneFeatures, gathered by
+    // update_object_buffer) and the settings below.
+    static const int MAX_PATH_TRACER_BOUNCES = 16;
+    ShaderVariantCache shaderVariants;
+    PathTracerVariant pathTracerVariant;
+    uint32_t sceneFeatures = PathTracerVariant::ALL_FEATURES;
+    std::vector<bool> textureLayerTranslucent; // sphere texture array layers with alpha below 0.99
+    bool nextEventEstimation = true;
+    int maxBounces = PathTracerVariant::DEFAULT_MAX_BOUNCES;
+    int samplesPerFrame = PathTracerVariant::DEFAULT_SAMPLES_PER_FRAME;
+    // Compute-shader path tracer in place of the fragment pass, when the
+    // kernels built.
+    WavefrontPathTracer wavefrontPathTracer;
+    bool useWavefrontPathTracer = false;
+    // Per-tile object and light lists for camera rays, built before either
+    // path tracer runs.
+    TileCuller tileCuller;
+    bool tileCulling = true;
+    // Rasterized first hits for the fragment pass, which then runs once per
+    // pixel class with pathTracerPixelShaders (of pathTracerVariant).
+    VisibilityPrepass visibilityPrepass;
+    bool useVisibilityPrepass = true;
+    GLuint pathTracerPixelShaders[VisibilityPrepass::PIXEL_CLASS_COUNT] = {};
+    GLuint blue_noise_texture_id = 0;
    
     int fps = 60;
     float dt = 1.0f/fps;
     float timeScale = 1.0f;
     float last_timeScale = 1.0f;
-    bool gravityEnabled = true;
-    float gravitationalConstant = 0.5f;
+    PhysicsSystem physics;
+    size_t analyticBodyCount = 0;
+    size_t regularizedPairCount = 0;
+
+    // Each frame runs physicsSubsteps steps of dt * timeScale / physicsSubsteps.
+    // The conservation monitor raises it when the energy drifts past the limit.
+    static const int MAX_PHYSICS_SUBSTEPS = 64;
+    static const size_t DRIFT_HISTORY_LENGTH = 240;
+    int physicsSubsteps = 1;
+    float energyDriftLimit = 1e-3f;
+    float momentumDriftLimit = 1e-3f;
+    bool autoReduceTimeStep = false;
+    bool conservationWarning = false;
+    std::vector<float> energyDriftHistory; // log10 of the relative drift, oldest first
+
+    // Star/planet/black hole transitions, shown in the panel rather than
+    // printed from the step loop; only the latest are kept.
+    static const size_t TRANSITION_LOG_LENGTH = 64;
+    std::vector<std::string> transitionLog; // oldest first
+    size_t transitionCount = 0;
 
     bool showAddObjectPopup = false;
     float newObjectMass = 1.0f;
@@ -140,14 +288,34 @@ private:
     float newObjectEccentricity = 0.0f; // 0 = perfect circle
     float newObjectInclination = 0.0f;  // degrees
 
-    int selectedObjectIndex = 0;
-    int lastSelectedObjectIndex = 0;
+    ObjectHandle selectedObject;
+    ObjectHandle lastSelectedObject;
     float lastX, lastY;
     bool isOrbiting = false;
 
     std::vector<std::string> saveFiles;
     int selectedSaveFile = 0;
 
+    SceneSaver sceneSaver;
+    std::string saveStatus;
+    bool saveFailed = false;
+    bool autosaveEnabled = false;
+    float autosaveIntervalMinutes = 5.0f;
+    double lastAutosaveTime = 0.0;
+
+    static const size_t MAX_LISTED_OBJECTS = 256;
+
+    CatalogImporter catalogImporter;
+    CatalogImportSettings catalogSettings;
+    ObjectHandle catalogParentHandle;
+    bool catalogActive = false;
+    vec3 catalogParentPosition;
+    vec3 catalogParentVelocity;
+    float catalogBodyRadius = 0.1f;
+    bool catalogTrails = false;
+    size_t catalogBodiesPerFrame = 50000;
+    std::vector<ImportedBody> catalogBatch;
+
     // Member versions of callbacks
     void M_KeyCallback(int key, int scancode, int action, int mods);
     void M_MouseButtonCallback(int button, int action, int mods);
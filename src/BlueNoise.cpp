@@ -0,0 +1,136 @@
+#include "BlueNoise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+namespace {
+
+const float BLUE_NOISE_SIGMA = 1.5f;
+// The kernel is cut off beyond this many sigmas, where it has fallen below
+// 4e-4 of its peak.
+const float KERNEL_SIGMAS = 4.0f;
+const float INITIAL_DENSITY = 0.1f;
+
+// Binary pattern with toroidal Gaussian splatting of its "1" pixels; the
+// energy of a pixel is how crowded its neighbourhood is. Each row keeps its
+// tightest cluster and largest void, so a change only rescans the rows its
+// kernel window touches and Find only looks at one candidate per row.
+class EnergyField {
+public:
+    explicit EnergyField(int size)
+        : size(size), pattern(size * size, 0), energy(size * size, 0.0f), rowCluster(size, -1), rowVoid(size, -1) {
+        // At most half the tile either way, so no pixel is covered twice.
+        radius = std::min(static_cast<int>(std::ceil(KERNEL_SIGMAS * BLUE_NOISE_SIGMA)), (size - 1) / 2);
+        int width = 2 * radius + 1;
+        kernel.resize(width * width);
+        for (int dy = -radius; dy <= radius; ++dy) {
+            for (int dx = -radius; dx <= radius; ++dx) {
+                kernel[(dy + radius) * width + dx + radius] =
+                    std::exp(-(dx * dx + dy * dy) / (2.0f * BLUE_NOISE_SIGMA * BLUE_NOISE_SIGMA));
+            }
+        }
+        for (int y = 0; y < size; ++y) UpdateRow(y);
+    }
+
+    bool IsSet(int pixel) const { return pattern[pixel] != 0; }
+
+    void Set(int pixel, bool value) {
+        if (IsSet(pixel) == value) return;
+        pattern[pixel] = value ? 1 : 0;
+        float sign = value ? 1.0f : -1.0f;
+        int px = pixel % size;
+        int py = pixel / size;
+        int width = 2 * radius + 1;
+        for (int dy = -radius; dy <= radius; ++dy) {
+            int y = (py + dy + size) % size;
+            const float* row = &kernel[(dy + radius) * width + radius];
+            float* out = &energy[y * size];
+            for (int dx = -radius; dx <= radius; ++dx) out[(px + dx + size) % size] += sign * row[dx];
+            UpdateRow(y);
+        }
+    }
+
+    // Most crowded "1" (tightest cluster) or emptiest "0" (largest void);
+    // ties go to the lowest pixel index.
+    int Find(bool tightestCluster) const {
+        const std::vector<int>& rowBest = tightestCluster ? rowCluster : rowVoid;
+        int best = -1;
+        for (int candidate : rowBest) {
+            if (candidate < 0) continue;
+            if (best < 0 || (tightestCluster ? energy[candidate] > energy[best] : energy[candidate] < energy[best]))
+                best = candidate;
+        }
+        return best;
+    }
+
+private:
+    void UpdateRow(int y) {
+        int cluster = -1;
+        int voidPixel = -1;
+        for (int i = y * size; i < (y + 1) * size; ++i) {
+            if (pattern[i]) {
+                if (cluster < 0 || energy[i] > energy[cluster]) cluster = i;
+            } else {
+                if (voidPixel < 0 || energy[i] < energy[voidPixel]) voidPixel = i;
+            }
+        }
+        rowCluster[y] = cluster;
+        rowVoid[y] = voidPixel;
+    }
+
+    int size;
+    int radius;
+    std::vector<uint8_t> pattern;
+    std::vector<float> energy;
+    std::vector<float> kernel;
+    std::vector<int> rowCluster;
+    std::vector<int> rowVoid;
+};
+
+} // namespace
+
+std::vector<float> generate_blue_noise(int size, unsigned int seed) {
+    const int count = size * size;
+    std::vector<float> result(count, 0.0f);
+    if (count == 0) return result;
+
+    // Initial binary pattern: random points, relaxed by moving the tightest
+    // cluster into the largest void until that no longer changes anything.
+    std::mt19937 rng(seed);
+    EnergyField initial(size);
+    int ones = std::max(1, static_cast<int>(count * INITIAL_DENSITY));
+    for (int placed = 0; placed < ones;) {
+        int pixel = static_cast<int>(rng() % count);
+        if (initial.IsSet(pixel)) continue;
+        initial.Set(pixel, true);
+        placed++;
+    }
+    for (;;) {
+        int cluster = initial.Find(true);
+        initial.Set(cluster, false);
+        int voidPixel = initial.Find(false);
+        initial.Set(voidPixel, true);
+        if (voidPixel == cluster) break;
+    }
+
+    // Phase 1: rank the initial points by removing tightest clusters.
+    EnergyField field = initial;
+    for (int rank = ones - 1; rank >= 0; --rank) {
+        int cluster = field.Find(true);
+        field.Set(cluster, false);
+        result[cluster] = static_cast<float>(rank);
+    }
+
+    // Phases 2 and 3: from the initial pattern, fill the largest voids.
+    field = initial;
+    for (int rank = ones; rank < count; ++rank) {
+        int voidPixel = field.Find(false);
+        field.Set(voidPixel, true);
+        result[voidPixel] = static_cast<float>(rank);
+    }
+
+    for (float& value : result) value /= static_cast<float>(count);
+    return result;
+}
@@ -0,0 +1,200 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
+
+namespace {
+
+BvhBounds empty_bounds() {
+    return { vec3(FLT_MAX), vec3(-FLT_MAX) };
+}
+
+void grow(BvhBounds& bounds, const vec3& point) {
+    for (int axis = 0; axis < 3; ++axis) {
+        bounds.min[axis] = std::min(bounds.min[axis], point[axis]);
+        bounds.max[axis] = std::max(bounds.max[axis], point[axis]);
+    }
+}
+
+void grow(BvhBounds& bounds, const BvhBounds& other) {
+    grow(bounds, other.min);
+    grow(bounds, other.max);
+}
+
+float surface_area(const vec3& min, const vec3& max) {
+    vec3 d = max - min;
+    if (d.x < 0.0f || d.y < 0.0f || d.z < 0.0f) return 0.0f;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool is_leaf(const GPUbvhNode& node) {
+    return (node.prims & GPU_BVH_COUNT_MASK) != 0;
+}
+
+} // namespace
+
+bool Bvh::Update(const std::vector<BvhBounds>& bounds) {
+    if (bounds.size() != primitives.size()) {
+        Build(bounds);
+        return true;
+    }
+
+    Refit(bounds);
+    cost = ComputeCost();
+    if (cost > buildCost * REBUILD_COST_RATIO) {
+        Build(bounds);
+        return true;
+    }
+    return false;
+}
+
+void Bvh::Build(const std::vector<BvhBounds>& bounds) {
+    uint32_t count = static_cast<uint32_t>(bounds.size());
+    nodes.clear();
+    rightChild.clear();
+    primitives.resize(count);
+    std::iota(primitives.begin(), primitives.end(), 0u);
+    centroids.resize(count);
+    for (uint32_t i = 0; i < count; ++i) centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+
+    if (count > 0) {
+        nodes.reserve(2 * count);
+        rightChild.reserve(2 * count);
+        BuildRange(bounds, 0, count);
+        LinkMissIndices(0, -1);
+    }
+    cost = buildCost = ComputeCost();
+    buildCount++;
+}
+
+int Bvh::BuildRange(const std::vector<BvhBounds>& bounds, uint32_t begin, uint32_t end) {
+    int index = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    rightChild.push_back(-1);
+
+    BvhBounds box = empty_bounds();
+    BvhBounds centroidBox = empty_bounds();
+    for (uint32_t i = begin; i < end; ++i) {
+        grow(box, bounds[primitives[i]]);
+        grow(centroidBox, centroids[primitives[i]]);
+    }
+    nodes[index].bmin = box.min;
+    nodes[index].bmax = box.max;
+
+    // Binned SAH: costs are in primitive tests, relative to hitting this node.
+    uint32_t count = end - begin;
+    float parentArea = surface_area(box.min, box.max);
+    float invParentArea = parentArea > 0.0f ? 1.0f / parentArea : 0.0f;
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = FLT_MAX;
+
+    auto bin_of = [&](uint32_t primitive, int axis) {
+        float lo = centroidBox.min[axis];
+        float extent = centroidBox.max[axis] - lo;
+        int bin = static_cast<int>((centroids[primitive][axis] - lo) / extent * SAH_BINS);
+        return std::min(std::max(bin, 0), SAH_BINS - 1);
+    };
+
+    for (int axis = 0; count > 1 && axis < 3; ++axis) {
+        if (!(centroidBox.max[axis] > centroidBox.min[axis])) continue;
+
+        Bin bins[SAH_BINS];
+        for (Bin& bin : bins) bin.bounds = empty_bounds();
+        for (uint32_t i = begin; i < end; ++i) {
+            Bin& bin = bins[bin_of(primitives[i], axis)];
+            bin.count++;
+            grow(bin.bounds, bounds[primitives[i]]);
+        }
+
+        // Split k puts bins [0, k] on the left.
+        float rightCost[SAH_BINS];
+        BvhBounds right = empty_bounds();
+        int rightCount = 0;
+        for (int k = SAH_BINS - 1; k > 0; --k) {
+            grow(right, bins[k].bounds);
+            rightCount += bins[k].count;
+            rightCost[k - 1] = rightCount * surface_area(right.min, right.max);
+        }
+        BvhBounds left = empty_bounds();
+        int leftCount = 0;
+        for (int k = 0; k < SAH_BINS - 1; ++k) {
+            grow(left, bins[k].bounds);
+            leftCount += bins[k].count;
+            if (leftCount == 0 || leftCount == static_cast<int>(count)) continue;
+            float splitCost = TRAVERSAL_COST + (leftCount * surface_area(left.min, left.max) + rightCost[k]) * invParentArea;
+            if (splitCost < bestCost) {
+                bestCost = splitCost;
+                bestAxis = axis;
+                bestSplit = k;
+            }
+        }
+    }
+
+    if (count == 1 || (count <= MAX_LEAF_SIZE && (bestAxis < 0 || static_cast<float>(count) <= bestCost))) {
+        nodes[index].prims = (begin << GPU_BVH_FIRST_SHIFT) | count;
+        return index;
+    }
+
+    uint32_t mid = begin;
+    if (bestAxis >= 0) {
+        mid = static_cast<uint32_t>(std::partition(primitives.begin() + begin, primitives.begin() + end,
+                                                   [&](uint32_t p) { return bin_of(p, bestAxis) <= bestSplit; }) - primitives.begin());
+    }
+    if (mid == begin || mid == end) {
+        // Coincident centroids: no bin separates them, so halve the range.
+        vec3 extent = centroidBox.max - centroidBox.min;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        mid = begin + count / 2;
+        std::nth_element(primitives.begin() + begin, primitives.begin() + mid, primitives.begin() + end,
+                         [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+    }
+
+    BuildRange(bounds, begin, mid);
+    rightChild[index] = BuildRange(bounds, mid, end);
+    return index;
+}
+
+void Bvh::LinkMissIndices(int node, int escape) {
+    nodes[node].miss = escape;
+    if (is_leaf(nodes[node])) return;
+    LinkMissIndices(node + 1, rightChild[node]);
+    LinkMissIndices(rightChild[node], escape);
+}
+
+// Children follow their parent in the array, so one backwards pass sees every
+// child before its parent. An inner node's right child is where its left
+// child's walk escapes to.
+void Bvh::Refit(const std::vector<BvhBounds>& bounds) {
+    for (size_t i = nodes.size(); i-- > 0;) {
+        GPUbvhNode& node = nodes[i];
+        BvhBounds box = empty_bounds();
+        if (is_leaf(node)) {
+            uint32_t first = node.prims >> GPU_BVH_FIRST_SHIFT;
+            uint32_t count = node.prims & GPU_BVH_COUNT_MASK;
+            for (uint32_t k = first; k < first + count; ++k) grow(box, bounds[primitives[k]]);
+        }
+        else {
+            const GPUbvhNode& left = nodes[i + 1];
+            const GPUbvhNode& right = nodes[left.miss];
+            grow(box, BvhBounds{ left.bmin, left.bmax });
+            grow(box, BvhBounds{ right.bmin, right.bmax });
+        }
+        node.bmin = box.min;
+        node.bmax = box.max;
+    }
+}
+
+float Bvh::ComputeCost() const {
+    if (nodes.empty()) return 0.0f;
+    float rootArea = surface_area(nodes[0].bmin, nodes[0].bmax);
+    if (!(rootArea > 0.0f)) return static_cast<float>(primitives.size());
+
+    float total = 0.0f;
+    for (const GPUbvhNode& node : nodes) {
+        float relativeArea = surface_area(node.bmin, node.bmax) / rootArea;
+        total += relativeArea * (is_leaf(node) ? static_cast<float>(node.prims & GPU_BVH_COUNT_MASK) : TRAVERSAL_COST);
+    }
+    return total;
+}
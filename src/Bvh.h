@@ -0,0 +1,58 @@
+#pragma once
+
+#include "UBOstructs.h"
+
+#include <cstdint>
+#include <vector>
+
+struct BvhBounds {
+    vec3 min;
+    vec3 max;
+};
+
+// Bounding volume hierarchy over the path tracer's primitives, kept as the
+// flat GPUbvhNode array the shader walks. It is built top-down with a binned
+// surface area heuristic. Later frames only refit the boxes to the moved
+// primitives, and the tree is rebuilt once the refitted SAH cost exceeds the
+// cost right after the last build by REBUILD_COST_RATIO, or the number of
+// primitives changes.
+class Bvh {
+public:
+    static constexpr int MAX_LEAF_SIZE = 4;           // must fit GPU_BVH_COUNT_MASK
+    static constexpr int SAH_BINS = 16;
+    static constexpr float TRAVERSAL_COST = 1.0f;     // relative to one primitive test
+    static constexpr float REBUILD_COST_RATIO = 1.5f;
+
+    // Refits or rebuilds for this frame's primitive bounds. Returns true if it
+    // rebuilt, i.e. the primitive index order changed too.
+    bool Update(const std::vector<BvhBounds>& bounds);
+    void Build(const std::vector<BvhBounds>& bounds);
+
+    const std::vector<GPUbvhNode>& GetNodes() const { return nodes; }
+    // Leaves refer to ranges of this array, which holds primitive indices.
+    const std::vector<uint32_t>& GetPrimitiveIndices() const { return primitives; }
+
+    // Expected cost of a ray, in primitive tests, for rays that hit the root.
+    float GetCost() const { return cost; }
+    float GetBuildCost() const { return buildCost; }
+    int GetBuildCount() const { return buildCount; }
+
+private:
+    struct Bin {
+        BvhBounds bounds;
+        int count = 0;
+    };
+
+    int BuildRange(const std::vector<BvhBounds>& bounds, uint32_t begin, uint32_t end);
+    void Refit(const std::vector<BvhBounds>& bounds);
+    void LinkMissIndices(int node, int escape);
+    float ComputeCost() const;
+
+    std::vector<GPUbvhNode> nodes;
+    std::vector<uint32_t> primitives;
+    std::vector<int> rightChild;  // build-time only, indexed by node
+    std::vector<vec3> centroids;  // build-time only, indexed by primitive
+    float cost = 0.0f;
+    float buildCost = 0.0f;
+    int buildCount = 0;
+};
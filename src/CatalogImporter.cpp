@@ -0,0 +1,407 @@
+#include "CatalogImporter.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const float TWO_PI_F = 6.28318530717958f;
+
+// Orbital elements of one parse range, stored SoA so the Kepler solve and the
+// state-vector conversion run as flat loops over a whole batch.
+struct ElementBatch {
+    std::vector<float> a;           // AU
+    std::vector<float> e;
+    std::vector<float> inclination; // radians
+    std::vector<float> node;        // radians
+    std::vector<float> peri;        // radians
+    std::vector<float> meanAnomaly; // radians in [-pi, pi]
+    std::vector<float> eccentricAnomaly;
+    std::vector<std::string> names;
+
+    void clear() {
+        a.clear(); e.clear(); inclination.clear(); node.clear();
+        peri.clear(); meanAnomaly.clear(); eccentricAnomaly.clear(); names.clear();
+    }
+    size_t size() const { return a.size(); }
+};
+
+struct CsvLayout {
+    int a = -1, e = -1, inclination = -1, node = -1, peri = -1, meanAnomaly = -1, name = -1;
+    bool valid() const { return a >= 0 && e >= 0 && inclination >= 0 && node >= 0 && peri >= 0 && meanAnomaly >= 0; }
+};
+
+struct Field {
+    const char* begin;
+    const char* end;
+};
+
+const int MAX_CSV_FIELDS = 64;
+
+void trim(const char*& begin, const char*& end) {
+    while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '"' || *begin == '+')) ++begin;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '"' || end[-1] == '\r' || end[-1] == '\n')) --end;
+}
+
+bool parse_float(const char* begin, const char* end, float& out) {
+    trim(begin, end);
+    if (begin == end) return false;
+    auto result = std::from_chars(begin, end, out);
+    return result.ec == std::errc();
+}
+
+std::string trimmed_string(const char* begin, const char* end) {
+    trim(begin, end);
+    return std::string(begin, end);
+}
+
+int split_csv(const char* begin, const char* end, Field* fields) {
+    int count = 0;
+    const char* field_begin = begin;
+    bool in_quotes = false;
+    for (const char* p = begin; p < end; ++p) {
+        if (*p == '"') in_quotes = !in_quotes;
+        else if (*p == ',' && !in_quotes) {
+            if (count < MAX_CSV_FIELDS) fields[count++] = { field_begin, p };
+            field_begin = p + 1;
+        }
+    }
+    if (count < MAX_CSV_FIELDS) fields[count++] = { field_begin, end };
+    return count;
+}
+
+CsvLayout parse_csv_header(const char* begin, const char* end) {
+    Field fields[MAX_CSV_FIELDS];
+    int count = split_csv(begin, end, fields);
+
+    CsvLayout layout;
+    for (int k = 0; k < count; ++k) {
+        std::string name = trimmed_string(fields[k].begin, fields[k].end);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        if (name == "a" || name == "semi_major_axis") layout.a = k;
+        else if (name == "e" || name == "ecc" || name == "eccentricity") layout.e = k;
+        else if (name == "i" || name == "inc" || name == "incl" || name == "inclination") layout.inclination = k;
+        else if (name == "om" || name == "node" || name == "raan") layout.node = k;
+        else if (name == "w" || name == "peri" || name == "arg_peri") layout.peri = k;
+        else if (name == "ma" || name == "m" || name == "mean_anomaly") layout.meanAnomaly = k;
+        else if (name == "full_name" || name == "name" || name == "designation" || name == "pdes") {
+            if (layout.name < 0) layout.name = k;
+        }
+    }
+    return layout;
+}
+
+float wrap_angle(float radians) {
+    radians = std::fmod(radians, TWO_PI_F);
+    if (radians > M_PI) radians -= TWO_PI_F;
+    else if (radians < -M_PI) radians += TWO_PI_F;
+    return radians;
+}
+
+bool push_elements(ElementBatch& batch, float a, float e, float inc, float node, float peri, float ma, std::string name) {
+    if (!(a > 0.0f) || !(e >= 0.0f) || !(e < 1.0f)) return false;
+
+    const float deg = static_cast<float>(DegreesToRadians);
+    batch.a.push_back(a);
+    batch.e.push_back(e);
+    batch.inclination.push_back(inc * deg);
+    batch.node.push_back(node * deg);
+    batch.peri.push_back(peri * deg);
+    batch.meanAnomaly.push_back(wrap_angle(ma * deg));
+    batch.names.push_back(std::move(name));
+    return true;
+}
+
+bool parse_csv_row(const char* begin, const char* end, const CsvLayout& layout, ElementBatch& batch) {
+    Field fields[MAX_CSV_FIELDS];
+    int count = split_csv(begin, end, fields);
+
+    int needed = std::max({ layout.a, layout.e, layout.inclination, layout.node, layout.peri, layout.meanAnomaly, layout.name });
+    if (count <= needed) return false;
+
+    float a, e, inc, node, peri, ma;
+    if (!parse_float(fields[layout.a].begin, fields[layout.a].end, a) ||
+        !parse_float(fields[layout.e].begin, fields[layout.e].end, e) ||
+        !parse_float(fields[layout.inclination].begin, fields[layout.inclination].end, inc) ||
+        !parse_float(fields[layout.node].begin, fields[layout.node].end, node) ||
+        !parse_float(fields[layout.peri].begin, fields[layout.peri].end, peri) ||
+        !parse_float(fields[layout.meanAnomaly].begin, fields[layout.meanAnomaly].end, ma)) {
+        return false;
+    }
+
+    std::string name = (layout.name >= 0) ? trimmed_string(fields[layout.name].begin, fields[layout.name].end) : std::string();
+    return push_elements(batch, a, e, inc, node, peri, ma, std::move(name));
+}
+
+// MPCORB.DAT columns (0-based, end exclusive).
+bool parse_mpc_row(const char* begin, const char* end, ElementBatch& batch) {
+    size_t length = static_cast<size_t>(end - begin);
+    if (length < 103) return false;
+
+    float a, e, inc, node, peri, ma;
+    if (!parse_float(begin + 26, begin + 35, ma) ||
+        !parse_float(begin + 37, begin + 46, peri) ||
+        !parse_float(begin + 48, begin + 57, node) ||
+        !parse_float(begin + 59, begin + 68, inc) ||
+        !parse_float(begin + 70, begin + 79, e) ||
+        !parse_float(begin + 92, begin + 103, a)) {
+        return false;
+    }
+
+    std::string name = (length >= 194) ? trimmed_string(begin + 166, begin + 194) : trimmed_string(begin, begin + 7);
+    return push_elements(batch, a, e, inc, node, peri, ma, std::move(name));
+}
+
+// Fixed iteration count so the loop has no data-dependent exit and vectorizes.
+void solve_kepler_batch(const float* M, const float* e, float* E, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+        float m = M[k];
+        float ecc = e[k];
+        float x = (ecc > 0.8f) ? std::copysign(static_cast<float>(M_PI), m) : m;
+        for (int iter = 0; iter < 8; ++iter) {
+            float f = x - ecc * std::sin(x) - m;
+            float fp = 1.0f - ecc * std::cos(x);
+            x -= f / fp;
+        }
+        E[k] = x;
+    }
+}
+
+// Converts elements to state vectors around the parent. Ecliptic z maps to
+// scene +Y so the ecliptic plane lies in the scene's XZ orbital plane.
+void elements_to_states(const ElementBatch& batch, float mu, float unitsPerAU, std::vector<ImportedBody>& out) {
+    size_t n = batch.size();
+    size_t base = out.size();
+    out.resize(base + n);
+
+    for (size_t k = 0; k < n; ++k) {
+        float a = batch.a[k] * unitsPerAU;
+        float e = batch.e[k];
+        float E = batch.eccentricAnomaly[k];
+
+        float cosE = std::cos(E), sinE = std::sin(E);
+        float b_over_a = std::sqrt(1.0f - e * e);
+        float r = a * (1.0f - e * cosE);
+
+        float x_pf = a * (cosE - e);
+        float y_pf = a * b_over_a * sinE;
+        float v_scale = std::sqrt(mu * a) / r;
+        float vx_pf = -v_scale * sinE;
+        float vy_pf = v_scale * b_over_a * cosE;
+
+        float cO = std::cos(batch.node[k]), sO = std::sin(batch.node[k]);
+        float cw = std::cos(batch.peri[k]), sw = std::sin(batch.peri[k]);
+        float ci = std::cos(batch.inclination[k]), si = std::sin(batch.inclination[k]);
+
+        vec3 P(cO * cw - sO * sw * ci, sO * cw + cO * sw * ci, sw * si);
+        vec3 Q(-cO * sw - sO * cw * ci, -sO * sw + cO * cw * ci, cw * si);
+
+        vec3 p_ecl = P * x_pf + Q * y_pf;
+        vec3 v_ecl = P * vx_pf + Q * vy_pf;
+
+        ImportedBody& body = out[base + k];
+        body.name = batch.names[k];
+        body.position = vec3(p_ecl.x, p_ecl.z, -p_ecl.y);
+        body.velocity = vec3(v_ecl.x, v_ecl.z, -v_ecl.y);
+    }
+}
+
+size_t next_line_start(const char* data, size_t size, size_t offset) {
+    if (offset >= size) return size;
+    const void* newline = std::memchr(data + offset, '\n', size - offset);
+    return newline ? static_cast<size_t>(static_cast<const char*>(newline) - data) + 1 : size;
+}
+
+} // namespace
+
+CatalogImporter::~CatalogImporter() {
+    Cancel();
+}
+
+bool CatalogImporter::Start(const std::string& path, const CatalogImportSettings& settings) {
+    if (running) return false;
+    if (worker.joinable()) worker.join();
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        readyBodies.clear();
+        readyOffset = 0;
+        error.clear();
+    }
+    cancelRequested = false;
+    bytesTotal = 0;
+    bytesDone = 0;
+    parsedCount = 0;
+    rejectedCount = 0;
+
+    running = true;
+    worker = std::thread(&CatalogImporter::Run, this, path, settings);
+    return true;
+}
+
+void CatalogImporter::Cancel() {
+    cancelRequested = true;
+    if (worker.joinable()) worker.join();
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    readyBodies.clear();
+    readyOffset = 0;
+}
+
+size_t CatalogImporter::TakeBodies(std::vector<ImportedBody>& out, size_t maxCount) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    size_t available = readyBodies.size() - readyOffset;
+    size_t count = std::min(available, maxCount);
+
+    out.insert(out.end(),
+        std::make_move_iterator(readyBodies.begin() + readyOffset),
+        std::make_move_iterator(readyBodies.begin() + readyOffset + count));
+    readyOffset += count;
+
+    if (readyOffset == readyBodies.size()) {
+        readyBodies.clear();
+        readyOffset = 0;
+    }
+    else if (readyOffset > 65536 && readyOffset * 2 > readyBodies.size()) {
+        readyBodies.erase(readyBodies.begin(), readyBodies.begin() + readyOffset);
+        readyOffset = 0;
+    }
+    return count;
+}
+
+bool CatalogImporter::HasPendingBodies() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return readyOffset < readyBodies.size();
+}
+
+float CatalogImporter::GetProgress() const {
+    size_t total = bytesTotal;
+    return total > 0 ? static_cast<float>(bytesDone) / static_cast<float>(total) : 0.0f;
+}
+
+std::string CatalogImporter::GetError() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return error;
+}
+
+void CatalogImporter::SetError(const std::string& message) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    error = message;
+}
+
+void CatalogImporter::Run(std::string path, CatalogImportSettings settings) {
+    MappedFile file;
+    std::string open_error;
+    if (!file.Open(path, open_error)) {
+        SetError(open_error);
+        running = false;
+        return;
+    }
+
+    const char* data = file.Data();
+    const size_t size = file.Size();
+    bytesTotal = size;
+
+    // --- Detect the format and skip the header ---
+    size_t data_start = 0;
+    CatalogFormat format = settings.format;
+    CsvLayout layout;
+
+    size_t first_line_end = next_line_start(data, size, 0);
+    if (format == CatalogFormat::Auto) {
+        bool has_comma = std::memchr(data, ',', first_line_end) != nullptr;
+        format = has_comma ? CatalogFormat::Csv : CatalogFormat::MpcFixedWidth;
+    }
+
+    if (format == CatalogFormat::Csv) {
+        layout = parse_csv_header(data, data + first_line_end);
+        if (!layout.valid()) {
+            SetError("CSV header must name the columns a, e, i, om, w and ma.");
+            running = false;
+            return;
+        }
+        data_start = first_line_end;
+    }
+    else {
+        // MPCORB.DAT starts with a free-form preamble terminated by a line of dashes.
+        size_t search_end = std::min(size, static_cast<size_t>(1 << 20));
+        for (size_t line = 0; line < search_end; line = next_line_start(data, size, line)) {
+            if (size - line >= 5 && std::strncmp(data + line, "-----", 5) == 0) {
+                data_start = next_line_start(data, size, line);
+                break;
+            }
+        }
+    }
+
+    // --- Parse in batches of whole lines, one sub-range per worker ---
+    ThreadPool pool(settings.threadCount);
+    const int workerCount = pool.GetThreadCount();
+    const float mu = settings.gravitationalConstant * (settings.parentMass + settings.bodyMass);
+
+    std::vector<ElementBatch> elements(workerCount);
+    std::vector<std::vector<ImportedBody>> bodies(workerCount);
+    std::vector<size_t> rejected(workerCount);
+    std::vector<size_t> bounds(workerCount + 1);
+
+    size_t pos = data_start;
+    bytesDone = pos;
+
+    while (pos < size && !cancelRequested) {
+        size_t batch_end = next_line_start(data, size, std::min(size, pos + std::max<size_t>(settings.batchBytes, 1)) - 1);
+
+        bounds[0] = pos;
+        for (int w = 1; w < workerCount; ++w) {
+            size_t split = pos + (batch_end - pos) * w / workerCount;
+            bounds[w] = std::max(bounds[w - 1], std::min(batch_end, next_line_start(data, size, split)));
+        }
+        bounds[workerCount] = batch_end;
+
+        pool.ParallelFor(workerCount, [&](size_t begin, size_t end, int) {
+            for (size_t w = begin; w < end; ++w) {
+                ElementBatch& batch = elements[w];
+                batch.clear();
+                bodies[w].clear();
+                rejected[w] = 0;
+
+                size_t line = bounds[w];
+                while (line < bounds[w + 1]) {
+                    size_t line_next = next_line_start(data, size, line);
+                    const char* line_begin = data + line;
+                    const char* line_end = data + std::min(line_next, bounds[w + 1]);
+                    while (line_end > line_begin && (line_end[-1] == '\n' || line_end[-1] == '\r')) --line_end;
+                    line = line_next;
+
+                    if (line_end == line_begin) continue;
+
+                    bool ok = (format == CatalogFormat::Csv)
+                        ? parse_csv_row(line_begin, line_end, layout, batch)
+                        : parse_mpc_row(line_begin, line_end, batch);
+                    if (!ok) rejected[w]++;
+                }
+
+                batch.eccentricAnomaly.resize(batch.size());
+                solve_kepler_batch(batch.meanAnomaly.data(), batch.e.data(), batch.eccentricAnomaly.data(), batch.size());
+                elements_to_states(batch, mu, settings.unitsPerAU, bodies[w]);
+            }
+        });
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for (int w = 0; w < workerCount; ++w) {
+                parsedCount += bodies[w].size();
+                rejectedCount += rejected[w];
+                readyBodies.insert(readyBodies.end(), std::make_move_iterator(bodies[w].begin()), std::make_move_iterator(bodies[w].end()));
+            }
+        }
+
+        pos = batch_end;
+        bytesDone = pos;
+    }
+
+    running = false;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Angel.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class CatalogFormat {
+    Auto,
+    Csv,          // header row naming a, e, i, om, w, ma (JPL SBDB style), angles in degrees
+    MpcFixedWidth // MPCORB.DAT style fixed-width rows
+};
+
+struct CatalogImportSettings {
+    CatalogFormat format = CatalogFormat::Auto;
+    float unitsPerAU = 100.0f;         // scene units per astronomical unit
+    float parentMass = 800.0f;
+    float gravitationalConstant = 0.5f;
+    float bodyMass = 0.0f;             // 0 imports massless test particles
+    int threadCount = 1;
+    size_t batchBytes = 4 << 20;       // bytes of catalog parsed per batch
+};
+
+// Position and velocity relative to the parent body, in scene units.
+struct ImportedBody {
+    std::string name;
+    vec3 position;
+    vec3 velocity;
+};
+
+// Streams an orbital-element catalog on a background thread. The file is
+// mapped, split into batches on line boundaries, parsed with std::from_chars on
+// a worker pool and converted to state vectors with a batched Kepler solver.
+// Finished bodies are queued for the main thread to pick up with TakeBodies()
+// while the rest of the file is still being parsed.
+class CatalogImporter {
+public:
+    CatalogImporter() = default;
+    ~CatalogImporter();
+
+    bool Start(const std::string& path, const CatalogImportSettings& settings);
+    void Cancel();
+
+    // Moves up to maxCount ready bodies into out (appending) and returns how many were moved.
+    size_t TakeBodies(std::vector<ImportedBody>& out, size_t maxCount);
+
+    bool IsRunning() const { return running; }
+    bool HasPendingBodies();
+    float GetProgress() const;
+    size_t GetParsedCount() const { return parsedCount; }
+    size_t GetRejectedCount() const { return rejectedCount; }
+    std::string GetError();
+
+private:
+    void Run(std::string path, CatalogImportSettings settings);
+    void SetError(const std::string& message);
+
+    std::thread worker;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> cancelRequested{ false };
+    std::atomic<size_t> bytesTotal{ 0 };
+    std::atomic<size_t> bytesDone{ 0 };
+    std::atomic<size_t> parsedCount{ 0 };
+    std::atomic<size_t> rejectedCount{ 0 };
+
+    std::mutex queueMutex;
+    std::vector<ImportedBody> readyBodies;
+    size_t readyOffset = 0;
+    std::string error;
+};
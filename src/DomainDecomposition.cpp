@@ -0,0 +1,495 @@
+#include "DomainDecomposition.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+
+#if defined(__linux__)
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <signal.h>
+    #include <sys/mman.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+    #define DOMAIN_USE_SHM 1
+#endif
+
+#ifdef DOMAIN_USE_SHM
+
+namespace {
+
+const int DOMAIN_SAMPLES = 64; // coordinate quantiles each rank shares for re-balancing
+const size_t DOMAIN_ALIGNMENT = 64;
+
+// Everything needed to rebuild a body in another process.
+struct DomainBody {
+    uint32_t id;          // index in the caller's vector
+    int32_t destination;  // receiving rank, -1 for the final gather
+    int32_t type;
+    uint32_t hasRings;
+    float mass;
+    float radius;
+    float position[3];
+    float velocity[3];
+    float orientation[4];
+    float angularVelocity[3];
+};
+
+struct GhostRecord {
+    float position[3];
+    float mass;
+};
+
+struct RankSlot {
+    uint32_t ghostCount[2]; // ghost buffers alternate between exchanges
+    uint32_t outboxCount;
+    uint32_t localCount;
+    uint32_t sampleCount;
+    uint32_t padding;
+    uint64_t pairInteractions;
+    uint64_t migratedBodies;
+    int64_t mergeCount;
+    float samples[DOMAIN_SAMPLES];
+};
+
+struct SharedHeader {
+    uint32_t rankCount;
+    uint32_t capacity;
+    int32_t axis;
+    uint32_t stepCount;
+    float cuts[MAX_DOMAIN_RANKS]; // initial slab boundaries, rankCount - 1 used
+    pthread_barrier_t barrier;
+};
+
+size_t align_up(size_t value) {
+    return (value + DOMAIN_ALIGNMENT - 1) & ~(DOMAIN_ALIGNMENT - 1);
+}
+
+// One shared segment holding the header, a slot, two ghost buffers and an
+// outbox per rank, and rank 0's step timings. The name is unlinked as soon as
+// it is mapped; forked ranks inherit the mapping.
+class SharedDomain {
+public:
+    ~SharedDomain() {
+        if (base) {
+            if (barrierReady) pthread_barrier_destroy(&Header().barrier);
+            munmap(base, size);
+        }
+    }
+
+    bool Create(int ranks, size_t capacity, int steps, std::string& error) {
+        rankCount = static_cast<size_t>(ranks);
+        this->capacity = capacity;
+
+        slotOffset = align_up(sizeof(SharedHeader));
+        ghostOffset = slotOffset + align_up(rankCount * sizeof(RankSlot));
+        outboxOffset = ghostOffset + align_up(rankCount * 2 * capacity * sizeof(GhostRecord));
+        timingOffset = outboxOffset + align_up(rankCount * capacity * sizeof(DomainBody));
+        size = timingOffset + align_up(static_cast<size_t>(std::max(steps, 1)) * sizeof(double));
+
+        std::string name = "/nbody-domain-" + std::to_string(getpid());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            error = "Could not create shared memory segment " + name;
+            return false;
+        }
+        shm_unlink(name.c_str());
+
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            error = "Could not size shared memory segment to " + std::to_string(size) + " bytes";
+            return false;
+        }
+        void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) {
+            error = "Could not map shared memory segment";
+            return false;
+        }
+        base = static_cast<char*>(addr);
+
+        pthread_barrierattr_t attr;
+        pthread_barrierattr_init(&attr);
+        pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        int result = pthread_barrier_init(&Header().barrier, &attr, static_cast<unsigned>(ranks));
+        pthread_barrierattr_destroy(&attr);
+        if (result != 0) {
+            error = "Could not create process-shared barrier";
+            return false;
+        }
+        barrierReady = true;
+        return true;
+    }
+
+    void Wait() { pthread_barrier_wait(&Header().barrier); }
+
+    SharedHeader& Header() { return *reinterpret_cast<SharedHeader*>(base); }
+    RankSlot& Slot(int rank) { return reinterpret_cast<RankSlot*>(base + slotOffset)[rank]; }
+    GhostRecord* Ghosts(int rank, int buffer) {
+        return reinterpret_cast<GhostRecord*>(base + ghostOffset) + (static_cast<size_t>(rank) * 2 + buffer) * capacity;
+    }
+    DomainBody* Outbox(int rank) { return reinterpret_cast<DomainBody*>(base + outboxOffset) + static_cast<size_t>(rank) * capacity; }
+    double* StepSeconds() { return reinterpret_cast<double*>(base + timingOffset); }
+
+private:
+    char* base = nullptr;
+    size_t size = 0;
+    size_t rankCount = 0;
+    size_t capacity = 0;
+    size_t slotOffset = 0, ghostOffset = 0, outboxOffset = 0, timingOffset = 0;
+    bool barrierReady = false;
+};
+
+float axis_coordinate(const vec3& p, int axis) {
+    return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+}
+
+int owner_of(float coordinate, const std::vector<float>& cuts) {
+    return static_cast<int>(std::upper_bound(cuts.begin(), cuts.end(), coordinate) - cuts.begin());
+}
+
+DomainBody pack_body(const SceneObject& obj, uint32_t id, int destination) {
+    DomainBody body;
+    body.id = id;
+    body.destination = destination;
+    body.type = static_cast<int32_t>(obj.Type);
+    body.hasRings = obj.hasRings ? 1 : 0;
+    body.mass = obj.Mass;
+    body.radius = obj.GetGpuObject(0).r1;
+    vec3 p = obj.GetPosition();
+    body.position[0] = p.x; body.position[1] = p.y; body.position[2] = p.z;
+    body.velocity[0] = obj.velocity.x; body.velocity[1] = obj.velocity.y; body.velocity[2] = obj.velocity.z;
+    body.orientation[0] = obj.Orientation.x; body.orientation[1] = obj.Orientation.y;
+    body.orientation[2] = obj.Orientation.z; body.orientation[3] = obj.Orientation.w;
+    body.angularVelocity[0] = obj.AngularVelocity.x; body.angularVelocity[1] = obj.AngularVelocity.y;
+    body.angularVelocity[2] = obj.AngularVelocity.z;
+    return body;
+}
+
+// Copies the dynamic state of body into obj, re-running the type setup first
+// if the body changed type in its rank.
+void apply_body(const DomainBody& body, SceneObject& obj) {
+    ObjectType type = static_cast<ObjectType>(body.type);
+    if (obj.Type != type || obj.hasRings != (body.hasRings != 0)) {
+        obj.hasRings = body.hasRings != 0;
+        obj.SetupAs(type);
+    }
+    obj.Mass = body.mass;
+    obj.GetGpuObject(0).r1 = body.radius;
+    obj.SetPosition(vec3(body.position[0], body.position[1], body.position[2]));
+    obj.velocity = vec3(body.velocity[0], body.velocity[1], body.velocity[2]);
+    obj.Orientation = vec4(body.orientation[0], body.orientation[1], body.orientation[2], body.orientation[3]);
+    obj.AngularVelocity = vec3(body.angularVelocity[0], body.angularVelocity[1], body.angularVelocity[2]);
+    for (auto& gpu_obj : obj.gpuObjects) gpu_obj.rot_quat = obj.Orientation;
+}
+
+std::unique_ptr<SceneObject> unpack_body(const DomainBody& body) {
+    auto obj = std::make_unique<SceneObject>(static_cast<ObjectType>(body.type), vec3(0.0f), 0.0f);
+    obj->TrailEnabled = false;
+    apply_body(body, *obj);
+    return obj;
+}
+
+// Slab boundaries that split the weighted samples of all ranks into equal
+// counts. Every rank runs this on the same shared data, so all agree.
+std::vector<float> balance_cuts(SharedDomain& shared, int ranks) {
+    std::vector<std::pair<float, double>> weighted;
+    double total = 0.0;
+    for (int r = 0; r < ranks; ++r) {
+        const RankSlot& slot = shared.Slot(r);
+        if (slot.sampleCount == 0) continue;
+        double weight = static_cast<double>(slot.localCount) / slot.sampleCount;
+        for (uint32_t k = 0; k < slot.sampleCount; ++k) weighted.emplace_back(slot.samples[k], weight);
+        total += slot.localCount;
+    }
+    std::sort(weighted.begin(), weighted.end());
+
+    std::vector<float> cuts(ranks - 1, 0.0f);
+    double accumulated = 0.0;
+    size_t k = 0;
+    for (int c = 1; c < ranks; ++c) {
+        double target = total * c / ranks;
+        while (k < weighted.size() && accumulated + weighted[k].second <= target) accumulated += weighted[k++].second;
+        if (!weighted.empty()) cuts[c - 1] = weighted[std::min(k, weighted.size() - 1)].first;
+    }
+    return cuts;
+}
+
+class DomainRank {
+public:
+    DomainRank(SharedDomain& shared, int rank, const PhysicsSettings& settings)
+        : shared(shared), rank(rank), rankCount(static_cast<int>(shared.Header().rankCount)), axis(shared.Header().axis) {
+        physics.Settings = settings;
+        physics.SetGhostExchange([this](const std::vector<std::unique_ptr<SceneObject>>& objects, GhostAttractors& ghosts) {
+            ExchangeGhosts(objects, ghosts);
+        });
+        cuts.assign(shared.Header().cuts, shared.Header().cuts + rankCount - 1);
+    }
+
+    void TakeInitialBodies(const std::vector<std::unique_ptr<SceneObject>>& objects) {
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (owner_of(axis_coordinate(objects[i]->GetPosition(), axis), cuts) != rank) continue;
+            AddBody(unpack_body(pack_body(*objects[i], static_cast<uint32_t>(i), rank)), static_cast<uint32_t>(i));
+        }
+    }
+
+    void Run(int steps, float dt, int migrationInterval) {
+        RankSlot& slot = shared.Slot(rank);
+        const bool leapfrog = physics.Settings.integrator == IntegratorType::Leapfrog;
+        bool primed = false;
+
+        for (int step = 0; step < steps; ++step) {
+            auto start = std::chrono::steady_clock::now();
+
+            if (local.empty()) {
+                // Keep the exchange count in step with ranks that have bodies,
+                // including the leapfrog priming pass after an invalidation.
+                GhostAttractors unused;
+                int passes = (leapfrog && !primed) ? 2 : 1;
+                for (int p = 0; p < passes; ++p) ExchangeGhosts(local, unused);
+            }
+            else {
+                PhysicsStepStats stats = physics.Step(local, dt);
+                slot.pairInteractions += stats.pairInteractions;
+                slot.mergeCount += stats.mergeCount;
+            }
+            primed = true;
+
+            if (migrationInterval > 0 && (step + 1) % migrationInterval == 0 && step + 1 < steps) {
+                size_t moved = Migrate();
+                slot.migratedBodies += moved;
+                if (moved > 0) {
+                    physics.InvalidateAccelerations();
+                    primed = false;
+                }
+            }
+
+            if (rank == 0) {
+                shared.StepSeconds()[step] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+
+        // Final gather: the parent reads every outbox once all ranks have exited.
+        DomainBody* outbox = shared.Outbox(rank);
+        for (size_t i = 0; i < local.size(); ++i) outbox[i] = pack_body(*local[i], IdOf(*local[i]), -1);
+        slot.outboxCount = static_cast<uint32_t>(local.size());
+    }
+
+private:
+    void AddBody(std::unique_ptr<SceneObject> obj, uint32_t id) {
+        ids[obj.get()] = id;
+        local.push_back(std::move(obj));
+    }
+
+    uint32_t IdOf(const SceneObject& obj) const { return ids.at(&obj); }
+
+    void ExchangeGhosts(const std::vector<std::unique_ptr<SceneObject>>& objects, GhostAttractors& ghosts) {
+        const int buffer = exchangeCount++ & 1;
+
+        GhostRecord* mine = shared.Ghosts(rank, buffer);
+        uint32_t count = 0;
+        for (const auto& obj : objects) {
+            if (obj->Mass == 0.0f) continue;
+            vec3 p = obj->GetPosition();
+            mine[count++] = { { p.x, p.y, p.z }, obj->Mass };
+        }
+        shared.Slot(rank).ghostCount[buffer] = count;
+
+        // The other buffer is not written again until everyone has passed the
+        // next barrier, so one barrier per exchange is enough.
+        shared.Wait();
+
+        ghosts.positions.clear();
+        ghosts.masses.clear();
+        for (int r = 0; r < rankCount; ++r) {
+            if (r == rank) continue;
+            const GhostRecord* theirs = shared.Ghosts(r, buffer);
+            uint32_t theirCount = shared.Slot(r).ghostCount[buffer];
+            for (uint32_t k = 0; k < theirCount; ++k) {
+                ghosts.positions.emplace_back(theirs[k].position[0], theirs[k].position[1], theirs[k].position[2]);
+                ghosts.masses.push_back(theirs[k].mass);
+            }
+        }
+    }
+
+    // Re-balances the slabs and hands bodies to their new owners. Returns the
+    // number of bodies that changed rank anywhere, which every rank agrees on.
+    size_t Migrate() {
+        RankSlot& slot = shared.Slot(rank);
+
+        std::vector<float> coordinates;
+        coordinates.reserve(local.size());
+        for (const auto& obj : local) coordinates.push_back(axis_coordinate(obj->GetPosition(), axis));
+        std::sort(coordinates.begin(), coordinates.end());
+
+        size_t n = coordinates.size();
+        size_t samples = std::min<size_t>(DOMAIN_SAMPLES, n);
+        for (size_t k = 0; k < samples; ++k) slot.samples[k] = coordinates[(2 * k + 1) * n / (2 * samples)];
+        slot.sampleCount = static_cast<uint32_t>(samples);
+        slot.localCount = static_cast<uint32_t>(n);
+        shared.Wait();
+
+        cuts = balance_cuts(shared, rankCount);
+
+        DomainBody* outbox = shared.Outbox(rank);
+        uint32_t outgoing = 0;
+        size_t write = 0;
+        for (size_t read = 0; read < local.size(); ++read) {
+            int owner = owner_of(axis_coordinate(local[read]->GetPosition(), axis), cuts);
+            if (owner != rank) {
+                outbox[outgoing++] = pack_body(*local[read], IdOf(*local[read]), owner);
+                ids.erase(local[read].get());
+            }
+            else {
+                local[write++] = std::move(local[read]);
+            }
+        }
+        local.resize(write);
+        slot.outboxCount = outgoing;
+        shared.Wait();
+
+        size_t moved = 0;
+        for (int r = 0; r < rankCount; ++r) {
+            const DomainBody* theirs = shared.Outbox(r);
+            uint32_t theirCount = shared.Slot(r).outboxCount;
+            moved += theirCount;
+            if (r == rank) continue;
+            for (uint32_t k = 0; k < theirCount; ++k) {
+                if (theirs[k].destination == rank) AddBody(unpack_body(theirs[k]), theirs[k].id);
+            }
+        }
+        return moved;
+    }
+
+    SharedDomain& shared;
+    const int rank;
+    const int rankCount;
+    const int axis;
+
+    PhysicsSystem physics;
+    std::vector<std::unique_ptr<SceneObject>> local;
+    std::unordered_map<const SceneObject*, uint32_t> ids;
+    std::vector<float> cuts;
+    int exchangeCount = 0;
+};
+
+} // namespace
+
+bool run_domain_decomposed(std::vector<std::unique_ptr<SceneObject>>& objects, const PhysicsSettings& settings,
+                           const DomainSettings& domain, int steps, float dt, DomainRunReport& report, std::string& error) {
+    const int ranks = domain.rankCount;
+    if (ranks < 1 || ranks > MAX_DOMAIN_RANKS) {
+        error = "Rank count must be between 1 and " + std::to_string(MAX_DOMAIN_RANKS);
+        return false;
+    }
+    const size_t n = objects.size();
+    steps = std::max(steps, 0);
+
+    // Slabs along the longest axis, initially split at exact count quantiles.
+    vec3 lo(0.0f), hi(0.0f);
+    for (size_t i = 0; i < n; ++i) {
+        vec3 p = objects[i]->GetPosition();
+        if (i == 0) { lo = p; hi = p; continue; }
+        lo = vec3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+        hi = vec3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+    }
+    vec3 extent = hi - lo;
+    int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+    std::vector<float> coordinates;
+    coordinates.reserve(n);
+    for (const auto& obj : objects) coordinates.push_back(axis_coordinate(obj->GetPosition(), axis));
+    std::sort(coordinates.begin(), coordinates.end());
+
+    SharedDomain shared;
+    if (!shared.Create(ranks, std::max<size_t>(n, 1), steps, error)) return false;
+
+    SharedHeader& header = shared.Header();
+    header.rankCount = static_cast<uint32_t>(ranks);
+    header.capacity = static_cast<uint32_t>(std::max<size_t>(n, 1));
+    header.axis = axis;
+    header.stepCount = static_cast<uint32_t>(steps);
+    for (int c = 1; c < ranks; ++c) header.cuts[c - 1] = n > 0 ? coordinates[static_cast<size_t>(c) * n / ranks] : 0.0f;
+
+    std::fflush(stdout);
+    std::fflush(stderr);
+
+    std::vector<pid_t> children;
+    for (int rank = 0; rank < ranks; ++rank) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            {
+                DomainRank worker(shared, rank, settings);
+                worker.TakeInitialBodies(objects);
+                worker.Run(steps, dt, domain.migrationInterval);
+            }
+            _exit(0);
+        }
+        if (pid < 0) {
+            error = "Could not fork rank " + std::to_string(rank);
+            for (pid_t child : children) kill(child, SIGKILL);
+            for (pid_t child : children) waitpid(child, nullptr, 0);
+            return false;
+        }
+        children.push_back(pid);
+    }
+
+    // A rank that dies leaves the others waiting at the barrier forever, so
+    // the first failure takes the whole run down.
+    size_t running = children.size();
+    int failedRank = -1;
+    while (running > 0) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) break;
+        auto it = std::find(children.begin(), children.end(), pid);
+        if (it == children.end()) continue;
+        running--;
+        bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (!ok && failedRank < 0) {
+            failedRank = static_cast<int>(it - children.begin());
+            for (pid_t child : children) {
+                if (child != pid) kill(child, SIGKILL);
+            }
+        }
+    }
+    if (failedRank >= 0) {
+        error = "Rank " + std::to_string(failedRank) + " terminated abnormally";
+        return false;
+    }
+
+    std::vector<const DomainBody*> finalState(n, nullptr);
+    report = DomainRunReport();
+    for (int r = 0; r < ranks; ++r) {
+        const RankSlot& slot = shared.Slot(r);
+        const DomainBody* outbox = shared.Outbox(r);
+        for (uint32_t k = 0; k < slot.outboxCount; ++k) {
+            if (outbox[k].id < n) finalState[outbox[k].id] = &outbox[k];
+        }
+        report.pairInteractions += slot.pairInteractions;
+        report.mergeCount += static_cast<int>(slot.mergeCount);
+    }
+    report.migratedBodies = shared.Slot(0).migratedBodies;
+    report.stepSeconds.assign(shared.StepSeconds(), shared.StepSeconds() + steps);
+
+    size_t write = 0;
+    for (size_t read = 0; read < n; ++read) {
+        if (!finalState[read]) continue; // merged into another body
+        apply_body(*finalState[read], *objects[read]);
+        objects[write++] = std::move(objects[read]);
+    }
+    objects.resize(write);
+    return true;
+}
+
+#else
+
+bool run_domain_decomposed(std::vector<std::unique_ptr<SceneObject>>&, const PhysicsSettings&,
+                           const DomainSettings&, int, float, DomainRunReport&, std::string& error) {
+    error = "Domain decomposition needs POSIX shared memory and fork(), which this platform does not provide";
+    return false;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Physics.h"
+
+#include <string>
+#include <vector>
+
+// Multi-process runs of the headless core. Bodies are split into slabs along
+// the longest axis of the scene, one per rank, and every rank is a forked
+// process with its own PhysicsSystem (and thread pool). Ranks talk through one
+// POSIX shared memory segment:
+//   - before every force pass each rank publishes its attractors and reads
+//     everyone else's as ghosts (direct summation needs all of them, so no
+//     far-field summaries are sent and forces match the single-process solver);
+//   - every migrationInterval steps the slab boundaries are re-balanced from
+//     per-rank coordinate samples and bodies that left their slab move to
+//     their new owner.
+// Bodies only merge with bodies of the same rank, and migration returns every
+// analytic or regularized body of the affected run to plain integration.
+
+const int MAX_DOMAIN_RANKS = 64;
+
+struct DomainSettings {
+    int rankCount = 2;
+    int migrationInterval = 10; // steps between re-balancing and body migration
+};
+
+struct DomainRunReport {
+    std::vector<double> stepSeconds; // wall time of every step on rank 0; ranks run in lockstep
+    size_t pairInteractions = 0;
+    int mergeCount = 0;
+    size_t migratedBodies = 0;
+};
+
+// Runs steps steps of dt over objects split across domain.rankCount processes
+// and replaces objects with the final state, in the original order with merged
+// bodies removed. Returns false and leaves objects untouched on failure.
+bool run_domain_decomposed(std::vector<std::unique_ptr<SceneObject>>& objects, const PhysicsSettings& settings,
+                           const DomainSettings& domain, int steps, float dt, DomainRunReport& report, std::string& error);
@@ -0,0 +1,127 @@
+#include "GpuRingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const GLuint64 FENCE_WAIT_NANOSECONDS = 1000000; // re-check interval while the GPU still reads a region
+
+size_t align_up(size_t value, size_t alignment) {
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+} // namespace
+
+GpuRingBuffer::~GpuRingBuffer() {
+    Release();
+}
+
+bool GpuRingBuffer::Init(GLenum bufferTarget, size_t size, int count) {
+    Release();
+    if (size == 0 || count < 1) return false;
+
+    GLint alignment = 1;
+    glGetIntegerv(bufferTarget == GL_SHADER_STORAGE_BUFFER ? GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+                                                           : GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    target = bufferTarget;
+    regionSize = size;
+    regionStride = align_up(size, static_cast<size_t>(alignment));
+    regionCount = count;
+    current = count - 1; // the first BeginFrame moves to region 0
+    fences.assign(count, 0);
+    shadow.assign(count, std::vector<unsigned char>(size, 0));
+
+    // Zero-initialised so the shadows start out matching the buffer.
+    std::vector<unsigned char> zeros(regionStride * count, 0);
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    glBufferStorage(target, zeros.size(), zeros.data(), flags | GL_DYNAMIC_STORAGE_BIT);
+    mapped = static_cast<unsigned char*>(glMapBufferRange(target, 0, zeros.size(), flags));
+    glBindBuffer(target, 0);
+
+    if (!mapped) {
+        std::cerr << "Warning: Persistent buffer mapping failed, streaming with glBufferSubData." << std::endl;
+    }
+    return true;
+}
+
+void GpuRingBuffer::Release() {
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = 0;
+    }
+    if (buffer != 0) {
+        if (mapped) {
+            glBindBuffer(target, buffer);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+        }
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = nullptr;
+    fences.clear();
+    shadow.clear();
+    regionSize = regionStride = 0;
+    regionCount = 0;
+}
+
+bool GpuRingBuffer::Grow(size_t minRegionSize) {
+    if (minRegionSize <= regionSize) return true;
+    GLenum bufferTarget = target;
+    int count = regionCount > 0 ? regionCount : DEFAULT_REGION_COUNT;
+    return Init(bufferTarget, std::max(minRegionSize, regionSize * 2), count);
+}
+
+void GpuRingBuffer::BeginFrame() {
+    if (regionCount == 0) return;
+    current = (current + 1) % regionCount;
+    bytesWritten = 0;
+
+    GLsync& fence = fences[current];
+    if (!fence) return;
+    GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (;;) {
+        GLenum status = glClientWaitSync(fence, waitFlags, FENCE_WAIT_NANOSECONDS);
+        if (status != GL_TIMEOUT_EXPIRED) break; // signaled, or failed and nothing left to wait for
+        waitFlags = 0;
+    }
+    glDeleteSync(fence);
+    fence = 0;
+}
+
+bool GpuRingBuffer::Write(size_t offset, const void* data, size_t size) {
+    if (regionCount == 0 || offset + size > regionSize) return false;
+
+    unsigned char* known = shadow[current].data() + offset;
+    if (std::memcmp(known, data, size) == 0) return false;
+    std::memcpy(known, data, size);
+
+    size_t bufferOffset = static_cast<size_t>(current) * regionStride + offset;
+    if (mapped) {
+        std::memcpy(mapped + bufferOffset, data, size);
+    }
+    else {
+        glBindBuffer(target, buffer);
+        glBufferSubData(target, bufferOffset, size, data);
+        glBindBuffer(target, 0);
+    }
+    bytesWritten += size;
+    return true;
+}
+
+void GpuRingBuffer::BindRange(GLuint bindingPoint) const {
+    if (regionCount == 0) return;
+    glBindBufferRange(target, bindingPoint, buffer, static_cast<size_t>(current) * regionStride, regionSize);
+}
+
+void GpuRingBuffer::EndFrame() {
+    if (regionCount == 0) return;
+    GLsync& fence = fences[current];
+    if (fence) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Angel.h"
+
+#include <cstddef>
+#include <vector>
+
+// Buffer streamed from the CPU every frame without stalling on the GPU. The
+// storage is split into regionCount regions and mapped once, persistently and
+// coherently. Each frame writes one region and binds it; a fence placed after
+// the last draw that reads the region keeps the CPU from touching it again
+// until the GPU is done, so a frame never waits on the one just submitted.
+//
+// Every region remembers what was last written to it, and Write skips ranges
+// whose bytes are unchanged, so per-frame traffic follows what changed rather
+// than the size of the data. A change reaches all regions within regionCount
+// frames.
+class GpuRingBuffer {
+public:
+    static const int DEFAULT_REGION_COUNT = 3;
+
+    GpuRingBuffer() = default;
+    ~GpuRingBuffer();
+
+    GpuRingBuffer(const GpuRingBuffer&) = delete;
+    GpuRingBuffer& operator=(const GpuRingBuffer&) = delete;
+
+    // target is GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER; regions are
+    // padded to that target's offset alignment. Needs a current GL context.
+    bool Init(GLenum target, size_t regionSize, int regionCount = DEFAULT_REGION_COUNT);
+    void Release();
+
+    // Makes regions at least minRegionSize bytes, at least doubling them when
+    // they grow so a growing scene reallocates O(log n) times. Contents are
+    // lost (reset to zero); the next frame rewrites everything. Returns false
+    // if reallocation failed.
+    bool Grow(size_t minRegionSize);
+
+    // Moves to the next region, waiting for its fence if the GPU still reads it.
+    void BeginFrame();
+
+    // Copies size bytes to offset in the current region if they differ from
+    // what the region holds. Returns true if anything was written.
+    bool Write(size_t offset, const void* data, size_t size);
+
+    // Binds the current region to an indexed binding point of the target.
+    void BindRange(GLuint bindingPoint) const;
+
+    // Call after the last draw that reads the current region.
+    void EndFrame();
+
+    GLuint GetBuffer() const { return buffer; }
+    size_t GetRegionSize() const { return regionSize; }
+    size_t GetBytesWritten() const { return bytesWritten; } // in the current frame
+
+private:
+    GLenum target = 0;
+    GLuint buffer = 0;
+    unsigned char* mapped = nullptr;  // null when persistent mapping is unavailable
+    size_t regionSize = 0;
+    size_t regionStride = 0;
+    int regionCount = 0;
+    int current = 0;
+    size_t bytesWritten = 0;
+    std::vector<GLsync> fences;                     // one per region, 0 when free
+    std::vector<std::vector<unsigned char>> shadow; // last bytes written to each region
+};
@@ -0,0 +1,52 @@
+#include "LightTable.h"
+
+#include <algorithm>
+#include <cmath>
+
+void LightTable::Build(const std::vector<float>& power, const std::vector<uint32_t>& objects) {
+    entries.clear();
+    totalPower = 0.0;
+    for (size_t i = 0; i < power.size(); ++i) {
+        if (!(power[i] > 0.0f)) continue;
+        entries.push_back({ objects[i], 1.0f, static_cast<uint32_t>(entries.size()), power[i] });
+        totalPower += power[i];
+    }
+    if (entries.empty()) return;
+
+    // Vose's method: scale powers so the mean is 1, then pair every entry below
+    // the mean with one above it that tops it up.
+    size_t count = entries.size();
+    scaled.resize(count);
+    small.clear();
+    large.clear();
+    for (size_t i = 0; i < count; ++i) {
+        entries[i].pdf = static_cast<float>(entries[i].pdf / totalPower);
+        scaled[i] = entries[i].pdf * count;
+        (scaled[i] < 1.0f ? small : large).push_back(static_cast<uint32_t>(i));
+    }
+    while (!small.empty() && !large.empty()) {
+        uint32_t lo = small.back();
+        small.pop_back();
+        uint32_t hi = large.back();
+        entries[lo].threshold = scaled[lo];
+        entries[lo].alias = hi;
+        scaled[hi] -= 1.0f - scaled[lo];
+        if (scaled[hi] < 1.0f) {
+            large.pop_back();
+            small.push_back(hi);
+        }
+    }
+    // Whatever is left is 1 up to rounding.
+    for (uint32_t i : small) entries[i].threshold = 1.0f;
+    for (uint32_t i : large) entries[i].threshold = 1.0f;
+}
+
+float emitted_power(const GPUobject& obj) {
+    if (obj.m.emission < LIGHT_EMISSION_THRESHOLD) return 0.0f;
+    float area;
+    if (obj.type == 0) area = 4.0f * static_cast<float>(M_PI) * obj.r1 * obj.r1;
+    else if (obj.type == 1) area = static_cast<float>(M_PI) * (obj.r1 * obj.r1 - obj.r2 * obj.r2);
+    else return 0.0f;
+    float luminance = 0.2126f * obj.m.albedo.x + 0.7152f * obj.m.albedo.y + 0.0722f * obj.m.albedo.z;
+    return std::max(0.0f, luminance * obj.m.emission * area);
+}
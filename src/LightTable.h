@@ -0,0 +1,28 @@
+#pragma once
+
+#include "UBOstructs.h"
+
+#include <cstdint>
+#include <vector>
+
+// Alias table over the scene's emitters, weighted by emitted power, so the
+// path tracer picks one light per sample in O(1) however many there are.
+class LightTable {
+public:
+    // power[i] is the emitted power of GPU object objects[i]; entries with no
+    // power are left out.
+    void Build(const std::vector<float>& power, const std::vector<uint32_t>& objects);
+
+    const std::vector<GPUlight>& GetEntries() const { return entries; }
+    double GetTotalPower() const { return totalPower; }
+
+private:
+    std::vector<GPUlight> entries;
+    std::vector<float> scaled;          // build-time only
+    std::vector<uint32_t> small, large; // build-time only
+    double totalPower = 0.0;
+};
+
+// Power emitted by a GPU object: luminance of its emission times its area,
+// matching the light areas used by the path tracer.
+float emitted_power(const GPUobject& obj);
@@ -0,0 +1,76 @@
+#include "MappedFile.h"
+
+#include <fstream>
+
+#if defined(__linux__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define MAPPED_FILE_USE_MMAP 1
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path, std::string& error) {
+    Close();
+
+#ifdef MAPPED_FILE_USE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Could not open file for reading: " + path;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        error = "Could not stat file: " + path;
+        return false;
+    }
+
+    size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        size = 0;
+        error = "Could not map file: " + path;
+        return false;
+    }
+    madvise(addr, size, MADV_SEQUENTIAL);
+
+    data = static_cast<const char*>(addr);
+    mapped = true;
+    return true;
+#else
+    std::ifstream infile(path, std::ios::binary | std::ios::ate);
+    if (!infile.is_open()) {
+        error = "Could not open file for reading: " + path;
+        return false;
+    }
+    buffer.resize(static_cast<size_t>(infile.tellg()));
+    infile.seekg(0);
+    infile.read(buffer.data(), buffer.size());
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+#endif
+}
+
+void MappedFile::Close() {
+#ifdef MAPPED_FILE_USE_MMAP
+    if (mapped && data) munmap(const_cast<char*>(data), size);
+#endif
+    buffer.clear();
+    buffer.shrink_to_fit();
+    data = nullptr;
+    size = 0;
+    mapped = false;
+}
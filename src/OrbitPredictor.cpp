@@ -0,0 +1,318 @@
+#include "OrbitPredictor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <unordered_set>
+
+namespace {
+
+const int PREDICTION_CHUNK_STEPS = 64;    // steps between checks for new requests
+const double PREDICTION_PUBLISH_SECONDS = 0.05;
+
+std::unique_ptr<SceneObject> make_prediction_body(const PredictionBody& body) {
+    auto obj = std::make_unique<SceneObject>(body.type, body.position, 0.0f);
+    obj->Mass = body.mass;
+    obj->GetGpuObject(0).r1 = body.radius;
+    obj->velocity = body.velocity;
+    obj->TrailEnabled = false;
+    return obj;
+}
+
+// Settings under which an existing prediction stays valid.
+bool same_dynamics(const PredictionSettings& a, const PredictionSettings& b) {
+    return a.stepDt == b.stepDt &&
+           a.stepsPerSample == b.stepsPerSample &&
+           a.physics.gravityEnabled == b.physics.gravityEnabled &&
+           a.physics.gravitationalConstant == b.physics.gravitationalConstant &&
+           a.physics.minDistanceSq == b.physics.minDistanceSq &&
+           a.physics.integrator == b.physics.integrator &&
+           a.physics.keplerPropagation == b.physics.keplerPropagation &&
+           a.physics.regularizeEncounters == b.physics.regularizeEncounters;
+}
+
+} // namespace
+
+OrbitPredictor::~OrbitPredictor() {
+    Stop();
+}
+
+void OrbitPredictor::Submit(std::vector<PredictionBody>&& bodies, const PredictionSettings& settings, double simulationTime,
+                            std::vector<int>&& editedBodies, unsigned int generation) {
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        pending.bodies = std::move(bodies);
+        pending.settings = settings;
+        pending.time = simulationTime;
+        pending.editedBodies = std::move(editedBodies);
+        pending.generation = generation;
+        hasRequest = true;
+    }
+    wantsSnapshot = false;
+    now = simulationTime;
+
+    if (!worker.joinable()) {
+        stopRequested = false;
+        worker = std::thread(&OrbitPredictor::Run, this);
+    }
+    requestReady.notify_one();
+}
+
+bool OrbitPredictor::TakePaths(std::shared_ptr<const PredictedPaths>& out) {
+    std::unique_lock<std::mutex> lock(resultMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !hasNewResult) return false;
+    out = latest;
+    hasNewResult = false;
+    return true;
+}
+
+void OrbitPredictor::Stop() {
+    stopRequested = true;
+    requestReady.notify_all();
+    if (worker.joinable()) worker.join();
+
+    Clear();
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        hasRequest = false;
+        pending = Request();
+    }
+    std::lock_guard<std::mutex> lock(resultMutex);
+    latest.reset();
+    hasNewResult = false;
+    wantsSnapshot = true;
+}
+
+void OrbitPredictor::Clear() {
+    bodies.clear();
+    sceneIndexOf.clear();
+    pathOf.clear();
+    snapshotMass.clear();
+    pathSceneIndex.clear();
+    paths.clear();
+    centers.clear();
+    firstSampleStep = 0;
+    endStep = 0;
+    refreshing = false;
+}
+
+long long OrbitPredictor::StepAt(double time) const {
+    return static_cast<long long>(std::floor((time - originTime) / active.stepDt));
+}
+
+void OrbitPredictor::Run() {
+    auto lastPublish = std::chrono::steady_clock::now();
+    bool unpublished = false;
+
+    while (!stopRequested) {
+        Request request;
+        bool gotRequest = false;
+        {
+            std::unique_lock<std::mutex> lock(requestMutex);
+            bool idle = bodies.empty() || endStep >= StepAt(now + active.horizon);
+            if (idle) {
+                requestReady.wait_for(lock, std::chrono::milliseconds(10), [this] { return hasRequest || stopRequested; });
+            }
+            if (hasRequest) {
+                request = std::move(pending);
+                hasRequest = false;
+                gotRequest = true;
+            }
+        }
+        if (stopRequested) break;
+
+        if (gotRequest) {
+            if (!ReintegrateEdited(request)) Reseed(request);
+            unpublished = true;
+        }
+        if (bodies.empty()) continue;
+
+        Trim();
+        long long target = StepAt(now + active.horizon);
+        if (endStep < target) {
+            Extend(static_cast<int>(std::min<long long>(target - endStep, PREDICTION_CHUNK_STEPS)));
+            unpublished = true;
+        }
+
+        // Extending an old seed slowly drifts away from the live simulation, so
+        // ask for a fresh snapshot once the seed is a whole horizon old.
+        if (StepAt(now) * active.stepDt > active.horizon) wantsSnapshot = true;
+
+        bool caughtUp = endStep >= target;
+        if (caughtUp) refreshing = false;
+        double sincePublish = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastPublish).count();
+        if (unpublished && (caughtUp || (!refreshing && sincePublish > PREDICTION_PUBLISH_SECONDS))) {
+            Publish();
+            unpublished = false;
+            lastPublish = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+void OrbitPredictor::Reseed(Request& request) {
+    // A refresh of an unchanged scene keeps the old paths on screen until the
+    // new prediction has caught up with the horizon.
+    refreshing = !bodies.empty() && request.editedBodies.empty() && request.generation == generation;
+
+    Clear();
+    active = request.settings;
+    generation = request.generation;
+    originTime = request.time;
+    if (!(active.stepDt > 0.0f)) active.stepDt = 1.0f / 60.0f;
+    active.stepsPerSample = std::max(1, active.stepsPerSample);
+
+    simulation.Settings = active.physics;
+    simulation.InvalidateAccelerations();
+
+    bodies.reserve(request.bodies.size());
+    for (const PredictionBody& body : request.bodies) {
+        bodies.push_back(make_prediction_body(body));
+        sceneIndexOf[bodies.back().get()] = body.sceneIndex;
+        snapshotMass[body.sceneIndex] = body.mass;
+        if (body.drawn) {
+            pathOf[body.sceneIndex] = static_cast<int>(paths.size());
+            pathSceneIndex.push_back(body.sceneIndex);
+            paths.emplace_back();
+        }
+    }
+    RecordSample();
+}
+
+// Massless bodies do not move anything else, so when only they were edited
+// the rest of the prediction still holds: integrate the edited bodies from the
+// snapshot against fresh copies of the attractors up to the current end of the
+// prediction and splice them in. Returns false when a full reseed is needed.
+bool OrbitPredictor::ReintegrateEdited(Request& request) {
+    if (bodies.empty() || request.editedBodies.empty()) return false;
+    if (request.generation != generation || !same_dynamics(request.settings, active)) return false;
+    active.horizon = request.settings.horizon;
+
+    std::unordered_set<int> edited(request.editedBodies.begin(), request.editedBodies.end());
+    std::unordered_set<int> present;
+    for (const PredictionBody& body : request.bodies) present.insert(body.sceneIndex);
+    for (int sceneIndex : request.editedBodies) {
+        if (snapshotMass.count(sceneIndex) && !present.count(sceneIndex)) return false;
+    }
+    for (const PredictionBody& body : request.bodies) {
+        if (!edited.count(body.sceneIndex)) continue;
+        auto old_mass = snapshotMass.find(body.sceneIndex);
+        if (old_mass == snapshotMass.end() || old_mass->second != 0.0f || body.mass != 0.0f) return false;
+        if (body.drawn != (pathOf.count(body.sceneIndex) > 0)) return false;
+    }
+
+    std::vector<std::unique_ptr<SceneObject>> local;
+    std::unordered_map<const SceneObject*, int> localIndexOf;
+    for (const PredictionBody& body : request.bodies) {
+        if (body.mass == 0.0f && !edited.count(body.sceneIndex)) continue;
+        local.push_back(make_prediction_body(body));
+        localIndexOf[local.back().get()] = body.sceneIndex;
+    }
+
+    const long long stride = active.stepsPerSample;
+    long long step = std::max(StepAt(request.time), firstSampleStep);
+    step = firstSampleStep + ((step - firstSampleStep + stride - 1) / stride) * stride; // next sample boundary
+    if (step > endStep) return false;
+
+    // Edited paths keep the samples before the splice point.
+    size_t keep = static_cast<size_t>((step - firstSampleStep) / stride);
+    for (int sceneIndex : request.editedBodies) {
+        auto path = pathOf.find(sceneIndex);
+        if (path != pathOf.end()) paths[path->second].resize(std::min(keep, paths[path->second].size()));
+    }
+
+    PhysicsSystem local_simulation;
+    local_simulation.Settings = active.physics;
+    local_simulation.Settings.regularizeEncounters = false; // partners may differ from the full run
+    for (;;) {
+        if ((step - firstSampleStep) % stride == 0) {
+            for (const auto& obj : local) {
+                int sceneIndex = localIndexOf[obj.get()];
+                auto path = pathOf.find(sceneIndex);
+                if (!edited.count(sceneIndex) || path == pathOf.end()) continue;
+                std::vector<vec3>& points = paths[path->second];
+                if (points.size() == static_cast<size_t>((step - firstSampleStep) / stride)) points.push_back(obj->GetPosition());
+            }
+        }
+        if (step >= endStep) break;
+        local_simulation.Step(local, active.stepDt);
+        step++;
+    }
+
+    // Carry the new end states into the running simulation so extending picks
+    // up from them.
+    std::unordered_map<int, const SceneObject*> result;
+    for (const auto& obj : local) result[localIndexOf[obj.get()]] = obj.get();
+    for (const auto& obj : bodies) {
+        int sceneIndex = sceneIndexOf[obj.get()];
+        if (!edited.count(sceneIndex)) continue;
+        auto it = result.find(sceneIndex);
+        if (it == result.end()) continue;
+        obj->SetPosition(it->second->GetPosition());
+        obj->velocity = it->second->velocity;
+    }
+    simulation.InvalidateAccelerations();
+    return true;
+}
+
+void OrbitPredictor::Trim() {
+    // Keep one sample behind the present so the drawn path starts at the body.
+    const long long stride = active.stepsPerSample;
+    long long behind = StepAt(now) - firstSampleStep;
+    long long drop = behind / stride - 1;
+    if (drop <= 0) return;
+    drop = std::min<long long>(drop, static_cast<long long>(centers.size()) - 1);
+    if (drop <= 0) return;
+
+    centers.erase(centers.begin(), centers.begin() + drop);
+    for (auto& points : paths) {
+        size_t count = std::min(static_cast<size_t>(drop), points.size());
+        points.erase(points.begin(), points.begin() + count);
+    }
+    firstSampleStep += drop * stride;
+}
+
+void OrbitPredictor::Extend(int maxSteps) {
+    for (int i = 0; i < maxSteps && !stopRequested; ++i) {
+        simulation.Step(bodies, active.stepDt);
+        endStep++;
+        if ((endStep - firstSampleStep) % active.stepsPerSample == 0) RecordSample();
+    }
+}
+
+void OrbitPredictor::RecordSample() {
+    vec3 weighted(0.0f);
+    float totalMass = 0.0f;
+    for (const auto& obj : bodies) {
+        weighted += obj->GetPosition() * obj->Mass;
+        totalMass += obj->Mass;
+    }
+    centers.push_back(totalMass > 0.0f ? weighted / totalMass : vec3(0.0f));
+
+    // Bodies merged away stop being sampled; their paths simply end.
+    for (const auto& obj : bodies) {
+        auto path = pathOf.find(sceneIndexOf[obj.get()]);
+        if (path == pathOf.end()) continue;
+        std::vector<vec3>& points = paths[path->second];
+        if (points.size() + 1 == centers.size()) points.push_back(obj->GetPosition());
+    }
+}
+
+void OrbitPredictor::Publish() {
+    auto result = std::make_shared<PredictedPaths>();
+    result->generation = generation;
+    result->startTime = originTime + static_cast<double>(firstSampleStep) * active.stepDt;
+    result->sampleInterval = active.stepDt * active.stepsPerSample;
+    result->horizon = active.horizon;
+    result->sceneIndices = pathSceneIndex;
+    result->points.resize(paths.size());
+    for (size_t p = 0; p < paths.size(); ++p) {
+        const std::vector<vec3>& points = paths[p];
+        std::vector<vec3>& relative = result->points[p];
+        relative.reserve(points.size());
+        for (size_t k = 0; k < points.size(); ++k) relative.push_back(points[k] - centers[k]);
+    }
+
+    std::lock_guard<std::mutex> lock(resultMutex);
+    latest = std::move(result);
+    hasNewResult = true;
+}
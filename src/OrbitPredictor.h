@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Physics.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct PredictionSettings {
+    PhysicsSettings physics;
+    float horizon = 20.0f;    // simulated seconds ahead of the present
+    float stepDt = 1.0f / 60.0f;
+    int stepsPerSample = 4;   // integration steps between stored path points
+};
+
+// State of one scene body handed to the predictor.
+struct PredictionBody {
+    int sceneIndex;
+    ObjectType type;
+    float mass;
+    float radius;
+    vec3 position;
+    vec3 velocity;
+    bool drawn;               // a path is kept for it (massive bodies are always simulated)
+};
+
+// Future positions relative to the predicted centre of mass, one path per
+// drawn body, sampled every sampleInterval seconds from startTime.
+struct PredictedPaths {
+    unsigned int generation = 0;
+    double startTime = 0.0;
+    float sampleInterval = 0.0f;
+    float horizon = 0.0f;
+    std::vector<int> sceneIndices;
+    std::vector<std::vector<vec3>> points;
+};
+
+// Forward-integrates a copy of the scene on a background thread. Each frame the
+// main thread reports the simulation time; the predictor drops the part of the
+// prediction that is now in the past and extends the far end, so an unedited
+// scene costs only the newly predicted steps. A snapshot with edited massless
+// bodies re-integrates just those bodies against the massive ones; any other
+// edit restarts the prediction. Nothing here blocks the caller.
+class OrbitPredictor {
+public:
+    OrbitPredictor() = default;
+    ~OrbitPredictor();
+
+    OrbitPredictor(const OrbitPredictor&) = delete;
+    OrbitPredictor& operator=(const OrbitPredictor&) = delete;
+
+    void SetTime(double simulationTime) { now = simulationTime; }
+
+    // True when the predictor wants a fresh snapshot, e.g. after a full horizon
+    // of extending an old one.
+    bool WantsSnapshot() const { return wantsSnapshot; }
+
+    // editedBodies lists scene indices changed since the previous snapshot.
+    // generation must increase whenever scene indices change (reseed).
+    void Submit(std::vector<PredictionBody>&& bodies, const PredictionSettings& settings, double simulationTime,
+                std::vector<int>&& editedBodies, unsigned int generation);
+
+    // Replaces out with the newest published paths. Returns false without
+    // waiting if there is nothing new or the worker is publishing.
+    bool TakePaths(std::shared_ptr<const PredictedPaths>& out);
+
+    void Stop();
+
+private:
+    struct Request {
+        std::vector<PredictionBody> bodies;
+        PredictionSettings settings;
+        double time = 0.0;
+        std::vector<int> editedBodies;
+        unsigned int generation = 0;
+    };
+
+    void Run();
+    void Reseed(Request& request);
+    bool ReintegrateEdited(Request& request);
+    void Trim();
+    void Extend(int maxSteps);
+    void RecordSample();
+    void Publish();
+    void Clear();
+
+    long long StepAt(double time) const;
+
+    std::thread worker;
+    std::atomic<bool> stopRequested{ false };
+    std::atomic<bool> wantsSnapshot{ true };
+    std::atomic<double> now{ 0.0 };
+
+    std::mutex requestMutex;
+    std::condition_variable requestReady;
+    bool hasRequest = false;
+    Request pending;
+
+    std::mutex resultMutex;
+    std::shared_ptr<const PredictedPaths> latest;
+    bool hasNewResult = false;
+
+    // Worker-only state. Time is counted in whole steps from originTime so
+    // samples from different passes line up exactly.
+    PredictionSettings active;
+    PhysicsSystem simulation;
+    std::vector<std::unique_ptr<SceneObject>> bodies;
+    std::unordered_map<const SceneObject*, int> sceneIndexOf;
+    std::unordered_map<int, int> pathOf;          // scene index -> path, drawn bodies only
+    std::unordered_map<int, float> snapshotMass;  // scene index -> mass in the current seed
+    std::vector<int> pathSceneIndex;
+    std::vector<std::vector<vec3>> paths;         // absolute positions, one per sample
+    std::vector<vec3> centers;                    // centre of mass per sample
+    unsigned int generation = 0;
+    double originTime = 0.0;
+    long long firstSampleStep = 0;
+    long long endStep = 0;
+    bool refreshing = false;                      // rebuilding an unedited scene; keep showing the old paths
+};
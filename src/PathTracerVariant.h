@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Compile-time settings of the path tracer shaders. Each feature keeps a
+// part of path_tracer_common.glsl that some scenes do without, so the
+// renderer builds the smallest variant the current scene needs and the
+// branches for everything else are not in its loops at all. Bounce and
+// sample counts become constants the compiler can unroll against.
+struct PathTracerVariant {
+    enum Feature : uint32_t {
+        RINGS = 1u << 0,                 // ring intersection, uvs, light sampling and rim lighting
+        TEXTURES = 1u << 1,              // albedo texture lookups
+        ALPHA = 1u << 2,                 // translucent texels: pass-through and shadow transmission
+        NEXT_EVENT_ESTIMATION = 1u << 3, // a light sample and shadow ray at every vertex
+        ALL_FEATURES = RINGS | TEXTURES | ALPHA | NEXT_EVENT_ESTIMATION
+    };
+
+    // What path_tracer_common.glsl falls back to without the defines.
+    static const int DEFAULT_MAX_BOUNCES = 5;
+    static const int DEFAULT_SAMPLES_PER_FRAME = 9;
+
+    uint32_t features = ALL_FEATURES;
+    int maxBounces = DEFAULT_MAX_BOUNCES;
+    int samplesPerFrame = DEFAULT_SAMPLES_PER_FRAME;
+
+    bool Has(Feature feature) const { return (features & feature) != 0; }
+
+    // The #defines that select this variant, to follow the #version line.
+    std::string ToDefines() const {
+        return "#define MAX_BOUNCES " + std::to_string(maxBounces) + "\n" +
+               "#define SAMPLES_PER_FRAME " + std::to_string(samplesPerFrame) + "\n" +
+               "#define HAS_RINGS " + (Has(RINGS) ? "1" : "0") + "\n" +
+               "#define HAS_TEXTURES " + (Has(TEXTURES) ? "1" : "0") + "\n" +
+               "#define HAS_ALPHA " + (Has(ALPHA) ? "1" : "0") + "\n" +
+               "#define NEXT_EVENT_ESTIMATION " + (Has(NEXT_EVENT_ESTIMATION) ? "1" : "0") + "\n";
+    }
+
+    bool operator==(const PathTracerVariant& other) const {
+        return features == other.features && maxBounces == other.maxBounces && samplesPerFrame == other.samplesPerFrame;
+    }
+    bool operator!=(const PathTracerVariant& other) const { return !(*this == other); }
+};
@@ -0,0 +1,833 @@
+#include "Physics.h"
+#include "Regularization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const double KEPLER_MAX_ECCENTRICITY = 0.95;
+// Relative mismatch between an analytic body's velocity and the one its orbit
+// last gave it beyond which the velocity counts as changed from outside; well
+// above the float rounding of parent velocity + relative velocity.
+const float KEPLER_VELOCITY_TOLERANCE = 1e-4f;
+
+} // namespace
+
+PhysicsStepStats PhysicsSystem::Step(std::vector<std::unique_ptr<SceneObject>>& objects, float dt) {
+    PhysicsStepStats stats;
+    pool.Resize(Settings.threadCount);
+    transitions.clear();
+
+    if (objects.empty() || dt <= 0.0f) return stats;
+
+    const bool kepler = Settings.keplerPropagation && Settings.gravityEnabled;
+    if (orbits.size() != objects.size() || (!kepler && analyticCount > 0)) {
+        ResetKeplerOrbits(objects.size());
+    }
+    if (analyticCount > 0) DropEditedKeplerOrbits(objects);
+    const bool regularize = Settings.regularizeEncounters && Settings.gravityEnabled;
+    if (encounterPartner.size() != objects.size() || (!regularize && !encounters.empty())) {
+        ResetEncounters(objects.size());
+    }
+
+    // Analytic bodies are skipped by the force pass except on periodic full
+    // passes, which also re-check whether they are still isolated enough.
+    bool fullPass = !kepler || !accelerationsValid || ++stepsSinceCheck >= std::max(1, Settings.keplerCheckInterval);
+    if (fullPass) stepsSinceCheck = 0;
+
+    if (Settings.integrator == IntegratorType::Leapfrog) {
+        if (!accelerationsValid || accelerations.size() != objects.size()) {
+            EvaluateForces(objects, stats, true);
+        }
+        CaptureEncounters(objects);
+
+        float half_dt = 0.5f * dt;
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (!IsAnalytic(i)) objects[i]->velocity += accelerations[i] * half_dt;
+            objects[i]->Update(dt);
+        }
+        PropagateKeplerBodies(objects, dt);
+        AdvanceEncounters(objects, dt);
+
+        EvaluateForces(objects, stats, fullPass);
+
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (!IsAnalytic(i)) objects[i]->velocity += accelerations[i] * half_dt;
+        }
+        SyncKeplerVelocities(objects);
+
+        if (stats.mergeCount > 0) ResetConservationBaseline();
+        UpdateConservation(objects);
+
+        if (fullPass && kepler) ClassifyKeplerBodies(objects);
+    }
+    else {
+        EvaluateForces(objects, stats, fullPass);
+        if (fullPass && kepler) ClassifyKeplerBodies(objects);
+        CaptureEncounters(objects);
+
+        // Positions and velocities only agree before the kick.
+        if (stats.mergeCount > 0) ResetConservationBaseline();
+        UpdateConservation(objects);
+        pairPotentialFresh = false;
+
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (!IsAnalytic(i)) objects[i]->velocity += accelerations[i] * dt;
+            objects[i]->Update(dt);
+        }
+        PropagateKeplerBodies(objects, dt);
+        AdvanceEncounters(objects, dt);
+    }
+
+    if (regularize) DetectEncounters(objects, dt);
+
+    // Merged bodies change type only now, all at once, so the passes above saw
+    // consistent radii for the whole step.
+    for (const TypeTransitionEvent& event : transitions) event.object->ApplyTypeTransition(event);
+    stats.typeTransitions = transitions.size();
+
+    accelerationsValid = true;
+    stats.analyticBodies = analyticCount;
+    stats.regularizedPairs = encounters.size();
+    return stats;
+}
+
+void PhysicsSystem::InvalidateAccelerations() {
+    accelerationsValid = false;
+    orbits.clear();
+    keplerLevels.clear();
+    analyticCount = 0;
+    encounters.clear();
+    encounterPartner.clear();
+    encounterContacts.clear();
+    pairPotentialFresh = false;
+    ResetConservationBaseline();
+}
+
+void PhysicsSystem::ResetConservationBaseline() {
+    conservation.hasBaseline = false;
+    conservation.energyDrift = 0.0;
+    conservation.momentumDrift = 0.0;
+    conservation.angularMomentumDrift = 0.0;
+    conservation.energySamples = 0;
+}
+
+void PhysicsSystem::MeasureConservedQuantities(const std::vector<std::unique_ptr<SceneObject>>& objects) {
+    UpdateConservation(objects);
+}
+
+// The O(n) half of the monitor; the potential was summed by the force pass.
+void PhysicsSystem::UpdateConservation(const std::vector<std::unique_ptr<SceneObject>>& objects) {
+    ConservedQuantities q;
+    double weightedPosition[3] = { 0.0, 0.0, 0.0 };
+
+    for (const auto& obj_ptr : objects) {
+        const double m = obj_ptr->Mass;
+        if (m == 0.0) continue;
+
+        const vec3 pos = obj_ptr->GetPosition();
+        const vec3 vel = obj_ptr->velocity;
+        const double r[3] = { pos.x, pos.y, pos.z };
+        const double p[3] = { m * vel.x, m * vel.y, m * vel.z };
+        const double l[3] = { r[1] * p[2] - r[2] * p[1], r[2] * p[0] - r[0] * p[2], r[0] * p[1] - r[1] * p[0] };
+
+        q.totalMass += m;
+        q.kinetic += 0.5 * (p[0] * vel.x + p[1] * vel.y + p[2] * vel.z);
+        for (int k = 0; k < 3; ++k) {
+            weightedPosition[k] += m * r[k];
+            q.momentum[k] += p[k];
+            q.angularMomentum[k] += l[k];
+        }
+        q.momentumScale += std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        q.angularMomentumScale += std::sqrt(l[0] * l[0] + l[1] * l[1] + l[2] * l[2]);
+    }
+
+    if (q.totalMass > 0.0) {
+        q.centerOfMass = vec3(static_cast<float>(weightedPosition[0] / q.totalMass),
+                              static_cast<float>(weightedPosition[1] / q.totalMass),
+                              static_cast<float>(weightedPosition[2] / q.totalMass));
+        q.centerOfMassVelocity = vec3(static_cast<float>(q.momentum[0] / q.totalMass),
+                                      static_cast<float>(q.momentum[1] / q.totalMass),
+                                      static_cast<float>(q.momentum[2] / q.totalMass));
+    }
+
+    const bool energyValid = pairPotentialFresh && positions.size() == objects.size();
+    q.potential = energyValid ? pairPotential : conservation.current.potential;
+    conservation.current = q;
+    conservation.energyValid = energyValid;
+
+    if (!conservation.hasBaseline) {
+        // The reference needs an energy, so wait for a pass that measured one.
+        if (!energyValid) return;
+        conservation.baseline = q;
+        conservation.hasBaseline = true;
+        return;
+    }
+
+    auto vector_drift = [](const double a[3], const double b[3], double scale) {
+        double d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+        return scale > 0.0 ? std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) / scale : 0.0;
+    };
+    const ConservedQuantities& base = conservation.baseline;
+    conservation.momentumDrift = vector_drift(q.momentum, base.momentum, base.momentumScale);
+    conservation.angularMomentumDrift = vector_drift(q.angularMomentum, base.angularMomentum, base.angularMomentumScale);
+    if (energyValid) {
+        double e0 = base.Energy();
+        conservation.energyDrift = e0 != 0.0 ? std::fabs((q.Energy() - e0) / e0) : std::fabs(q.Energy());
+        conservation.energySamples++;
+    }
+}
+
+size_t PhysicsSystem::EvaluateForces(std::vector<std::unique_ptr<SceneObject>>& objects, PhysicsStepStats& stats, bool fullPass) {
+    if (ghostExchange) ghostExchange(objects, ghosts);
+    GatherState(objects);
+    size_t pairs = ComputeAccelerations(fullPass);
+
+    int merges = ResolveCollisions(objects);
+    if (merges > 0) {
+        // Indices shifted; every body goes back to plain numerical integration.
+        ResetKeplerOrbits(objects.size());
+        ResetEncounters(objects.size());
+        GatherState(objects);
+        pairs += ComputeAccelerations(true);
+    }
+    ApplyEncounterAccelerations();
+
+    stats.pairInteractions += pairs;
+    stats.mergeCount += merges;
+    return pairs;
+}
+
+void PhysicsSystem::GatherState(const std::vector<std::unique_ptr<SceneObject>>& objects) {
+    size_t n = objects.size();
+    positions.resize(n);
+    accelerations.resize(n);
+    masses.resize(n);
+    radii.resize(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        positions[i] = objects[i]->GetPosition();
+        masses[i] = objects[i]->Mass;
+        radii[i] = objects[i]->GetGpuObject(0).r1;
+    }
+}
+
+size_t PhysicsSystem::ComputeAccelerations(bool fullPass) {
+    size_t n = positions.size();
+
+    contacts.resize(pool.GetThreadCount());
+    for (auto& list : contacts) list.clear();
+    potentialPartials.assign(pool.GetThreadCount(), 0.0);
+
+    // Massless bodies (e.g. imported catalogs) feel gravity but exert none, so
+    // only bodies with mass are visited in the inner loop.
+    attractors.clear();
+    for (size_t j = 0; j < n; ++j) {
+        if (masses[j] != 0.0f) attractors.push_back(static_cast<int>(j));
+    }
+    const size_t attractorCount = attractors.size();
+
+    const bool gravity = Settings.gravityEnabled;
+    const float G = Settings.gravitationalConstant;
+    const float minDistanceSq = Settings.minDistanceSq;
+
+    // Analytic bodies still act as attractors but need no accelerations of their
+    // own, except on full passes where their perturbations are re-measured.
+    const bool skipAnalytic = !fullPass && analyticCount > 0;
+    const bool trackStrongest = fullPass && gravity && Settings.keplerPropagation;
+    if (trackStrongest) strongestAttractors.assign(2 * n, -1);
+
+    // Regularized partners are skipped; their mutual force lives in the pair.
+    const bool trackNearest = gravity && Settings.regularizeEncounters;
+    if (trackNearest) nearestAttractor.assign(n, -1);
+    const bool hasPartners = encounterPartner.size() == n && !encounters.empty();
+    const size_t ghostCount = ghostExchange ? ghosts.masses.size() : 0;
+
+    // The potential is summed alongside the forces whenever every pair is
+    // visited. Each attractor pair is seen from both sides and counts half;
+    // ghost pairs are seen once per rank, so rank totals add up to the whole.
+    const bool measurePotential = gravity && !skipAnalytic;
+    const float minDistance = std::sqrt(minDistanceSq);
+    const float clampPotential = minDistance > 0.0f ? 2.0f / minDistance : 0.0f;
+
+    pool.ParallelFor(n, [&](size_t begin, size_t end, int worker) {
+        std::vector<std::pair<int, int>>& local_contacts = contacts[worker];
+
+        for (size_t i = begin; i < end; ++i) {
+            if (skipAnalytic && IsAnalytic(i)) {
+                accelerations[i] = vec3(0.0f);
+                continue;
+            }
+
+            const vec3 p_i = positions[i];
+            const float r_i = radii[i];
+            const bool i_is_attractor = masses[i] != 0.0f;
+            const size_t partner = hasPartners && encounterPartner[i] >= 0 ? static_cast<size_t>(encounterPartner[i]) : n;
+            vec3 acc(0.0f);
+            float strongest[2] = { 0.0f, 0.0f };
+            int strongestIndex[2] = { -1, -1 };
+            float nearestSq = std::numeric_limits<float>::max();
+            int nearest = -1;
+            const bool sumPotential = measurePotential && i_is_attractor;
+            float potential = 0.0f; // sum of m_j / d, clamped like the force
+
+            for (size_t k = 0; k < attractorCount; ++k) {
+                size_t j = static_cast<size_t>(attractors[k]);
+                if (i == j || j == partner) continue;
+
+                vec3 direction = positions[j] - p_i;
+                float distanceSq = dot(direction, direction);
+
+                if (trackNearest && distanceSq < nearestSq) {
+                    nearestSq = distanceSq;
+                    nearest = static_cast<int>(j);
+                }
+
+                // Attractor pairs are seen from both sides; record them once. A
+                // skipped analytic attractor never sees the pair, so take it here.
+                float contactDistance = r_i + radii[j];
+                bool owns_pair = !i_is_attractor || j > i || (skipAnalytic && IsAnalytic(j));
+                if (owns_pair && distanceSq <= contactDistance * contactDistance) {
+                    local_contacts.emplace_back(static_cast<int>(std::min(i, j)), static_cast<int>(std::max(i, j)));
+                }
+
+                if (gravity && distanceSq > 0.0f) {
+                    float clampedSq = std::max(distanceSq, minDistanceSq);
+                    float invDistance = 1.0f / std::sqrt(distanceSq);
+                    acc += direction * (G * masses[j] * invDistance / clampedSq);
+                    if (sumPotential) {
+                        potential += masses[j] * (distanceSq >= minDistanceSq ? invDistance
+                                                                                 : clampPotential - distanceSq * invDistance / minDistanceSq);
+                    }
+
+                    if (trackStrongest) {
+                        float strength = masses[j] / clampedSq;
+                        if (strength > strongest[0]) {
+                            strongest[1] = strongest[0];
+                            strongestIndex[1] = strongestIndex[0];
+                            strongest[0] = strength;
+                            strongestIndex[0] = static_cast<int>(j);
+                        }
+                        else if (strength > strongest[1]) {
+                            strongest[1] = strength;
+                            strongestIndex[1] = static_cast<int>(j);
+                        }
+                    }
+                }
+            }
+
+            // Ghosts are neither merged with nor paired with nor used as Kepler parents.
+            if (gravity) {
+                for (size_t k = 0; k < ghostCount; ++k) {
+                    vec3 direction = ghosts.positions[k] - p_i;
+                    float distanceSq = dot(direction, direction);
+                    if (distanceSq <= 0.0f) continue;
+                    float clampedSq = std::max(distanceSq, minDistanceSq);
+                    float invDistance = 1.0f / std::sqrt(distanceSq);
+                    acc += direction * (G * ghosts.masses[k] * invDistance / clampedSq);
+                    if (sumPotential) {
+                        potential += ghosts.masses[k] * (distanceSq >= minDistanceSq ? invDistance
+                                                                                     : clampPotential - distanceSq * invDistance / minDistanceSq);
+                    }
+                }
+            }
+
+            if (sumPotential) potentialPartials[worker] += static_cast<double>(masses[i]) * potential;
+            accelerations[i] = acc;
+            if (trackNearest) nearestAttractor[i] = nearest;
+            if (trackStrongest) {
+                strongestAttractors[2 * i] = strongestIndex[0];
+                strongestAttractors[2 * i + 1] = strongestIndex[1];
+            }
+        }
+    });
+
+    pairPotentialFresh = measurePotential || !gravity;
+    if (pairPotentialFresh) {
+        pairPotential = 0.0;
+        for (double partial : potentialPartials) pairPotential -= 0.5 * G * partial;
+
+        // Regularized partners skipped each other above; their potential is unclamped.
+        for (const Encounter& e : encounters) {
+            if (!hasPartners) break;
+            vec3 r = positions[e.second] - positions[e.first];
+            double distance = length(r);
+            if (distance > 0.0) pairPotential -= static_cast<double>(G) * masses[e.first] * masses[e.second] / distance;
+        }
+    }
+
+    size_t evaluated = n;
+    size_t evaluatedAttractors = attractorCount;
+    if (skipAnalytic) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!IsAnalytic(i)) continue;
+            evaluated--;
+            if (masses[i] != 0.0f) evaluatedAttractors--;
+        }
+    }
+    size_t skippedPartners = 0;
+    for (const Encounter& e : encounters) {
+        if (masses[e.first] != 0.0f) skippedPartners++;
+        if (masses[e.second] != 0.0f) skippedPartners++;
+    }
+    return evaluated * (attractorCount + ghostCount) - evaluatedAttractors - skippedPartners;
+}
+
+int PhysicsSystem::ResolveCollisions(std::vector<std::unique_ptr<SceneObject>>& objects) {
+    std::vector<std::pair<int, int>> all_contacts;
+    for (const auto& list : contacts) {
+        all_contacts.insert(all_contacts.end(), list.begin(), list.end());
+    }
+    all_contacts.insert(all_contacts.end(), encounterContacts.begin(), encounterContacts.end());
+    encounterContacts.clear();
+    if (all_contacts.empty()) return 0;
+
+    // Resolve in index order so the outcome does not depend on the thread count.
+    std::sort(all_contacts.begin(), all_contacts.end());
+
+    std::vector<char> removed(objects.size(), 0);
+    std::vector<char> grew(objects.size(), 0);
+    int merges = 0;
+
+    for (const auto& [i, j] : all_contacts) {
+        if (removed[i] || removed[j]) continue;
+
+        SceneObject& obj_i = *objects[i];
+        SceneObject& obj_j = *objects[j];
+
+        SceneObject* larger_obj = (obj_i.Mass > obj_j.Mass) ? &obj_i : &obj_j;
+        SceneObject* smaller_obj = (obj_i.Mass > obj_j.Mass) ? &obj_j : &obj_i;
+        int smaller_obj_index = (obj_i.Mass > obj_j.Mass) ? j : i;
+
+        vec3 new_velocity = (larger_obj->velocity * larger_obj->Mass + smaller_obj->velocity * smaller_obj->Mass) / (larger_obj->Mass + smaller_obj->Mass);
+
+        float r1_cubed = std::pow(larger_obj->GetGpuObject(0).r1, 3);
+        float r2_cubed = std::pow(smaller_obj->GetGpuObject(0).r1, 3);
+        float new_radius = std::cbrt(r1_cubed + r2_cubed);
+
+        larger_obj->Mass += smaller_obj->Mass;
+        larger_obj->velocity = new_velocity;
+        larger_obj->GetGpuObject(0).r1 = new_radius;
+
+        removed[smaller_obj_index] = 1;
+        grew[smaller_obj_index == i ? j : i] = 1;
+        merges++;
+    }
+
+    // A body with a pending transition may have been swallowed by a later pass.
+    if (!transitions.empty()) {
+        for (size_t k = 0; k < objects.size(); ++k) {
+            if (!removed[k]) continue;
+            const SceneObject* gone = objects[k].get();
+            transitions.erase(std::remove_if(transitions.begin(), transitions.end(),
+                                             [gone](const TypeTransitionEvent& e) { return e.object == gone; }),
+                              transitions.end());
+        }
+    }
+
+    size_t write = 0;
+    for (size_t read = 0; read < objects.size(); ++read) {
+        if (removed[read]) continue;
+        if (grew[read]) QueueTypeTransition(*objects[read]);
+        objects[write++] = std::move(objects[read]);
+    }
+    objects.resize(write);
+
+    return merges;
+}
+
+void PhysicsSystem::QueueTypeTransition(SceneObject& object) {
+    TypeTransitionEvent event;
+    if (!object.CheckForTypeTransition(event)) return;
+
+    // Grew again before the end of the step: keep one event with the latest target.
+    for (TypeTransitionEvent& pending : transitions) {
+        if (pending.object == &object) {
+            pending.to = event.to;
+            return;
+        }
+    }
+    transitions.push_back(event);
+}
+
+void PhysicsSystem::ResetKeplerOrbits(size_t count) {
+    orbits.assign(count, KeplerOrbit());
+    keplerLevels.clear();
+    analyticCount = 0;
+    stepsSinceCheck = 0;
+}
+
+void PhysicsSystem::ClassifyKeplerBodies(const std::vector<std::unique_ptr<SceneObject>>& objects) {
+    const size_t n = objects.size();
+    if (strongestAttractors.size() != 2 * n) return;
+
+    if (attractors.size() < static_cast<size_t>(std::max(0, Settings.keplerMinAttractors))) {
+        if (analyticCount > 0) ResetKeplerOrbits(n);
+        return;
+    }
+
+    const float G = Settings.gravitationalConstant;
+    const float threshold = Settings.keplerThreshold;
+    const float minDistanceSq = Settings.minDistanceSq;
+
+    pool.ParallelFor(n, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            KeplerOrbit& orbit = orbits[i];
+            if (encounterPartner.size() == n && encounterPartner[i] >= 0) {
+                orbit.parent = -1;
+                continue;
+            }
+
+            // Pick the candidate parent that leaves the smallest tidal residual:
+            // the pull of everything else on the body minus its pull on the parent.
+            int parent = -1;
+            float bestRatio = std::numeric_limits<float>::max();
+            for (int c = 0; c < 2; ++c) {
+                int p = strongestAttractors[2 * i + c];
+                if (p < 0 || !(masses[p] > masses[i])) continue; // heavier parents only, so chains cannot loop
+
+                vec3 rel = positions[i] - positions[p];
+                float distanceSq = dot(rel, rel);
+                if (distanceSq <= minDistanceSq) continue;
+
+                float invDistance3 = 1.0f / (distanceSq * std::sqrt(distanceSq));
+                vec3 acc_from_parent = rel * (-G * masses[p] * invDistance3);
+                vec3 acc_on_parent = rel * (G * masses[i] * invDistance3);
+                vec3 perturbation = (accelerations[i] - acc_from_parent) - (accelerations[p] - acc_on_parent);
+
+                float central = G * (masses[p] + masses[i]) / distanceSq;
+                float ratio = length(perturbation) / central;
+                if (ratio < bestRatio) {
+                    bestRatio = ratio;
+                    parent = p;
+                }
+            }
+
+            if (orbit.parent >= 0 && orbit.parent == parent && bestRatio < 2.0f * threshold) continue;
+            orbit.parent = -1;
+            if (parent < 0 || bestRatio >= threshold) continue;
+
+            const vec3 rel_p = positions[i] - positions[parent];
+            const vec3 rel_v = objects[i]->velocity - objects[parent]->velocity;
+            const double r0[3] = { rel_p.x, rel_p.y, rel_p.z };
+            const double v0[3] = { rel_v.x, rel_v.y, rel_v.z };
+            const double mu = static_cast<double>(G) * (static_cast<double>(masses[parent]) + masses[i]);
+
+            double r = std::sqrt(r0[0] * r0[0] + r0[1] * r0[1] + r0[2] * r0[2]);
+            double v2 = v0[0] * v0[0] + v0[1] * v0[1] + v0[2] * v0[2];
+            double energy = 0.5 * v2 - mu / r;
+            if (energy >= 0.0) continue;
+
+            double a = -mu / (2.0 * energy);
+            double h[3] = { r0[1] * v0[2] - r0[2] * v0[1], r0[2] * v0[0] - r0[0] * v0[2], r0[0] * v0[1] - r0[1] * v0[0] };
+            double h2 = h[0] * h[0] + h[1] * h[1] + h[2] * h[2];
+            double e = std::sqrt(std::max(0.0, 1.0 - h2 / (mu * a)));
+            double periapsis = a * (1.0 - e);
+
+            // The conic is only exact if it never enters the force clamp or touches the parent.
+            double contact = static_cast<double>(radii[i]) + radii[parent];
+            if (e > KEPLER_MAX_ECCENTRICITY || periapsis <= contact || periapsis * periapsis <= minDistanceSq) continue;
+
+            orbit.parent = parent;
+            std::copy(r0, r0 + 3, orbit.r0);
+            std::copy(v0, v0 + 3, orbit.v0);
+            std::copy(v0, v0 + 3, orbit.relativeVelocity);
+            orbit.mu = mu;
+            orbit.semiMajorAxis = a;
+            orbit.meanMotion = std::sqrt(mu / (a * a * a));
+            orbit.r0Length = r;
+            orbit.eCosE0 = 1.0 - r / a;
+            orbit.eSinE0 = (r0[0] * v0[0] + r0[1] * v0[1] + r0[2] * v0[2]) / std::sqrt(mu * a);
+            orbit.elapsed = 0.0;
+            orbit.deltaE = 0.0;
+            orbit.radius = r;
+        }
+    });
+
+    GroupKeplerLevels();
+}
+
+void PhysicsSystem::GroupKeplerLevels() {
+    // Parents must be propagated before their children; group by depth.
+    const size_t n = orbits.size();
+    keplerLevels.clear();
+    analyticCount = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!IsAnalytic(i)) continue;
+        size_t depth = 0;
+        for (int p = orbits[i].parent; IsAnalytic(p); p = orbits[p].parent) depth++;
+        if (keplerLevels.size() <= depth) keplerLevels.resize(depth + 1);
+        keplerLevels[depth].push_back(static_cast<int>(i));
+        analyticCount++;
+    }
+}
+
+void PhysicsSystem::PropagateKeplerBodies(std::vector<std::unique_ptr<SceneObject>>& objects, float dt) {
+    for (const auto& level : keplerLevels) {
+        pool.ParallelFor(level.size(), [&](size_t begin, size_t end, int) {
+            for (size_t k = begin; k < end; ++k) {
+                size_t i = static_cast<size_t>(level[k]);
+                KeplerOrbit& orbit = orbits[i];
+                double r[3];
+                AdvanceKeplerOrbit(orbit, dt, r);
+
+                const SceneObject& parent = *objects[orbit.parent];
+                SceneObject& body = *objects[i];
+                body.SetPosition(parent.GetPosition() + vec3(static_cast<float>(r[0]), static_cast<float>(r[1]), static_cast<float>(r[2])));
+                body.velocity = parent.velocity + vec3(static_cast<float>(orbit.relativeVelocity[0]),
+                                                       static_cast<float>(orbit.relativeVelocity[1]),
+                                                       static_cast<float>(orbit.relativeVelocity[2]));
+            }
+        });
+    }
+}
+
+// Advances a bound two-body state from its epoch using the f and g functions of
+// the eccentric anomaly difference dE. Always measured from the epoch so errors
+// do not accumulate; the previous dE seeds Newton so one or two iterations do.
+void PhysicsSystem::AdvanceKeplerOrbit(KeplerOrbit& orbit, double dt, double r_out[3]) {
+    const double a = orbit.semiMajorAxis;
+    const double n = orbit.meanMotion;
+    const double period = 2.0 * M_PI / n;
+
+    double guess = orbit.deltaE + n * dt * a / orbit.radius;
+    orbit.elapsed += dt;
+    if (orbit.elapsed >= period) {
+        orbit.elapsed = std::fmod(orbit.elapsed, period);
+        guess = std::fmod(guess, 2.0 * M_PI);
+    }
+    const double t = orbit.elapsed;
+
+    const double* r0 = orbit.r0;
+    const double* v0 = orbit.v0;
+    const double r0_len = orbit.r0Length;
+    const double ecosE0 = orbit.eCosE0;
+    const double esinE0 = orbit.eSinE0;
+
+    // Kepler's equation in dE: n t = dE - e cos E0 sin dE + e sin E0 (1 - cos dE)
+    const double M = n * t;
+    double dE = guess;
+    double sin_dE = std::sin(dE);
+    double cos_dE = std::cos(dE);
+    for (int iter = 0; iter < 32; ++iter) {
+        double F = dE - ecosE0 * sin_dE + esinE0 * (1.0 - cos_dE) - M;
+        double dF = 1.0 - ecosE0 * cos_dE + esinE0 * sin_dE;
+        double delta = F / dF;
+        dE -= delta;
+        sin_dE = std::sin(dE);
+        cos_dE = std::cos(dE);
+        if (std::fabs(delta) < 1e-12) break;
+    }
+
+    const double r_len = a * (1.0 - ecosE0 * cos_dE + esinE0 * sin_dE);
+    const double f = 1.0 - a / r0_len * (1.0 - cos_dE);
+    const double g = t - (dE - sin_dE) / n;
+    const double f_dot = -n * a * a * sin_dE / (r_len * r0_len);
+    const double g_dot = 1.0 - a / r_len * (1.0 - cos_dE);
+
+    for (int k = 0; k < 3; ++k) {
+        r_out[k] = f * r0[k] + g * v0[k];
+        orbit.relativeVelocity[k] = f_dot * r0[k] + g_dot * v0[k];
+    }
+    orbit.deltaE = dE;
+    orbit.radius = r_len;
+}
+
+void PhysicsSystem::SyncKeplerVelocities(std::vector<std::unique_ptr<SceneObject>>& objects) {
+    // Leapfrog kicks the parents after the analytic bodies were placed.
+    for (const auto& level : keplerLevels) {
+        for (int i : level) {
+            const KeplerOrbit& orbit = orbits[i];
+            objects[i]->velocity = objects[orbit.parent]->velocity + vec3(static_cast<float>(orbit.relativeVelocity[0]),
+                                                                          static_cast<float>(orbit.relativeVelocity[1]),
+                                                                          static_cast<float>(orbit.relativeVelocity[2]));
+        }
+    }
+}
+
+// A body whose velocity was set from outside (an edit) since the last step no
+// longer follows its orbit, and propagating it would overwrite the new velocity.
+// Such bodies go back to numerical integration, with fresh accelerations since
+// the force pass has been skipping them.
+void PhysicsSystem::DropEditedKeplerOrbits(const std::vector<std::unique_ptr<SceneObject>>& objects) {
+    bool dropped = false;
+    for (size_t i = 0; i < orbits.size(); ++i) {
+        KeplerOrbit& orbit = orbits[i];
+        if (orbit.parent < 0) continue;
+        const vec3 parentVelocity = objects[orbit.parent]->velocity;
+        const vec3 relative(static_cast<float>(orbit.relativeVelocity[0]), static_cast<float>(orbit.relativeVelocity[1]),
+                            static_cast<float>(orbit.relativeVelocity[2]));
+        const float tolerance = KEPLER_VELOCITY_TOLERANCE * (length(parentVelocity) + length(relative)) + 1e-12f;
+        if (length(objects[i]->velocity - (parentVelocity + relative)) <= tolerance) continue;
+        orbit.parent = -1;
+        dropped = true;
+    }
+    if (!dropped) return;
+    GroupKeplerLevels();
+    accelerationsValid = false;
+    ResetConservationBaseline();
+}
+
+void PhysicsSystem::ResetEncounters(size_t count) {
+    encounters.clear();
+    encounterPartner.assign(count, -1);
+    encounterContacts.clear();
+}
+
+void PhysicsSystem::ApplyEncounterAccelerations() {
+    // Both members get the centre-of-mass acceleration, so kicks move the pair
+    // as one body and leave the relative motion to the regularized integrator.
+    for (Encounter& e : encounters) {
+        float m1 = masses[e.first];
+        float m2 = masses[e.second];
+        vec3 a1 = accelerations[e.first];
+        vec3 a2 = accelerations[e.second];
+        vec3 a_cm = (a1 * m1 + a2 * m2) / (m1 + m2);
+
+        e.perturbation = a2 - a1;
+        accelerations[e.first] = a_cm;
+        accelerations[e.second] = a_cm;
+    }
+}
+
+void PhysicsSystem::CaptureEncounters(const std::vector<std::unique_ptr<SceneObject>>& objects) {
+    for (Encounter& e : encounters) {
+        vec3 r = objects[e.second]->GetPosition() - objects[e.first]->GetPosition();
+        vec3 v = objects[e.second]->velocity - objects[e.first]->velocity;
+        e.relativePosition[0] = r.x; e.relativePosition[1] = r.y; e.relativePosition[2] = r.z;
+        e.relativeVelocity[0] = v.x; e.relativeVelocity[1] = v.y; e.relativeVelocity[2] = v.z;
+    }
+}
+
+void PhysicsSystem::AdvanceEncounters(std::vector<std::unique_ptr<SceneObject>>& objects, float dt) {
+    if (encounters.empty()) return;
+
+    const double G = Settings.gravitationalConstant;
+    encounterTouched.assign(encounters.size(), 0);
+
+    pool.ParallelFor(encounters.size(), [&](size_t begin, size_t end, int) {
+        for (size_t k = begin; k < end; ++k) {
+            Encounter& e = encounters[k];
+            SceneObject& body1 = *objects[e.first];
+            SceneObject& body2 = *objects[e.second];
+            const float m1 = body1.Mass;
+            const float m2 = body2.Mass;
+            const float total = m1 + m2;
+
+            // The global step already moved the centre of mass; only the relative
+            // motion is replaced.
+            vec3 cm_position = (body1.GetPosition() * m1 + body2.GetPosition() * m2) / total;
+            vec3 cm_velocity = (body1.velocity * m1 + body2.velocity * m2) / total;
+
+            double r[3] = { e.relativePosition[0], e.relativePosition[1], e.relativePosition[2] };
+            double v[3] = { e.relativeVelocity[0], e.relativeVelocity[1], e.relativeVelocity[2] };
+            const double perturbation[3] = { e.perturbation.x, e.perturbation.y, e.perturbation.z };
+            RegularizedStepResult result = advance_regularized_pair(r, v, G * total, perturbation, dt, Settings.encounterMaxSubsteps);
+
+            vec3 rel_position(static_cast<float>(r[0]), static_cast<float>(r[1]), static_cast<float>(r[2]));
+            vec3 rel_velocity(static_cast<float>(v[0]), static_cast<float>(v[1]), static_cast<float>(v[2]));
+            body1.SetPosition(cm_position - rel_position * (m2 / total));
+            body2.SetPosition(cm_position + rel_position * (m1 / total));
+            body1.velocity = cm_velocity - rel_velocity * (m2 / total);
+            body2.velocity = cm_velocity + rel_velocity * (m1 / total);
+
+            double contact = static_cast<double>(radii[e.first]) + radii[e.second];
+            if (result.minSeparation <= contact) encounterTouched[k] = 1;
+        }
+    });
+
+    for (size_t k = 0; k < encounters.size(); ++k) {
+        if (encounterTouched[k]) encounterContacts.emplace_back(encounters[k].first, encounters[k].second);
+    }
+}
+
+void PhysicsSystem::DetectEncounters(const std::vector<std::unique_ptr<SceneObject>>& objects, float dt) {
+    const size_t n = objects.size();
+    if (nearestAttractor.size() != n || encounterPartner.size() != n) return;
+
+    const float G = Settings.gravitationalConstant;
+    const float closeDistance = Settings.encounterDistance;
+    const float fastTime = Settings.encounterDynamicalSteps * dt;
+
+    // A pair is worth regularizing when it is close, or when its dynamical time
+    // sqrt(d^3 / mu) is only a few global steps long.
+    auto is_close = [&](float distanceSq, float mu, float scale) {
+        float distance = std::sqrt(distanceSq);
+        return distance < closeDistance * scale ||
+               distanceSq * distance < (fastTime * scale) * (fastTime * scale) * mu;
+    };
+
+    // Release pairs that have drifted apart, with 2x hysteresis.
+    size_t write = 0;
+    for (size_t k = 0; k < encounters.size(); ++k) {
+        const Encounter& e = encounters[k];
+        vec3 r = objects[e.second]->GetPosition() - objects[e.first]->GetPosition();
+        float mu = G * (objects[e.first]->Mass + objects[e.second]->Mass);
+        if (is_close(dot(r, r), mu, 2.0f)) {
+            encounters[write++] = e;
+        }
+        else {
+            encounterPartner[e.first] = -1;
+            encounterPartner[e.second] = -1;
+        }
+    }
+    encounters.resize(write);
+
+    // Form new pairs from mutual nearest attractors (a massless body simply takes
+    // its nearest free attractor) that are bound or still approaching.
+    for (size_t i = 0; i < n; ++i) {
+        int j = nearestAttractor[i];
+        if (j < 0 || encounterPartner[i] >= 0 || encounterPartner[j] >= 0 || IsAnalytic(i) || IsAnalytic(j)) continue;
+        if (objects[i]->Mass != 0.0f && nearestAttractor[j] != static_cast<int>(i)) continue;
+
+        const SceneObject& body1 = *objects[i];
+        const SceneObject& body2 = *objects[j];
+        vec3 r = body2.GetPosition() - body1.GetPosition();
+        vec3 v = body2.velocity - body1.velocity;
+        float distanceSq = dot(r, r);
+        float mu = G * (body1.Mass + body2.Mass);
+        if (distanceSq <= 0.0f || mu <= 0.0f || !is_close(distanceSq, mu, 1.0f)) continue;
+
+        bool bound = 0.5f * dot(v, v) < mu / std::sqrt(distanceSq);
+        bool approaching = dot(r, v) < 0.0f;
+        if (!bound && !approaching) continue;
+
+        Encounter e = {};
+        e.first = static_cast<int>(std::min<size_t>(i, j));
+        e.second = static_cast<int>(std::max<size_t>(i, j));
+        encounters.push_back(e);
+        encounterPartner[i] = j;
+        encounterPartner[j] = static_cast<int>(i);
+    }
+}
+
+double PhysicsSystem::ComputeTotalEnergy(const std::vector<std::unique_ptr<SceneObject>>& objects) const {
+    const double G = Settings.gravitationalConstant;
+    const double minDistance = std::sqrt(static_cast<double>(Settings.minDistanceSq));
+
+    double kinetic = 0.0;
+    double potential = 0.0;
+
+    for (size_t i = 0; i < objects.size(); ++i) {
+        const SceneObject& obj_i = *objects[i];
+        kinetic += 0.5 * obj_i.Mass * dot(obj_i.velocity, obj_i.velocity);
+
+        if (!Settings.gravityEnabled) continue;
+
+        vec3 p_i = obj_i.GetPosition();
+        for (size_t j = i + 1; j < objects.size(); ++j) {
+            const SceneObject& obj_j = *objects[j];
+            double distance = length(obj_j.GetPosition() - p_i);
+            double mm = static_cast<double>(obj_i.Mass) * obj_j.Mass;
+
+            // Potential consistent with the clamped force: -Gmm/d outside the clamp
+            // radius, linear (constant force) inside it. Regularized pairs are unclamped.
+            bool paired = encounterPartner.size() == objects.size() && encounterPartner[i] == static_cast<int>(j);
+            if (distance >= minDistance || paired) potential -= G * mm / distance;
+            else potential -= G * mm * (2.0 / minDistance - distance / (minDistance * minDistance));
+        }
+    }
+    return kinetic + potential;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "SceneObject.h"
+#include "ThreadPool.h"
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+enum class IntegratorType {
+    SemiImplicitEuler,
+    Leapfrog // kick-drift-kick, reuses the accelerations of the previous step
+};
+
+struct PhysicsSettings {
+    bool gravityEnabled = true;
+    float gravitationalConstant = 0.5f;
+    float minDistanceSq = 1.0f; // forces are clamped below this separation (unregularized pairs only)
+    IntegratorType integrator = IntegratorType::SemiImplicitEuler;
+    int threadCount = 1;
+
+    // Bodies whose tidal perturbation relative to their dominant attractor stays
+    // below keplerThreshold follow their two-body conic analytically instead of
+    // being integrated. They keep acting as attractors for everything else.
+    bool keplerPropagation = true;
+    float keplerThreshold = 1e-3f;
+    int keplerCheckInterval = 30; // steps between full perturbation checks
+    int keplerMinAttractors = 16;  // below this a direct force pass is cheaper than a Kepler solve
+
+    // Close or fast pairs are integrated in Kustaanheimo-Stiefel coordinates
+    // with their own substeps and move through the global step as their centre
+    // of mass, so the clamp above no longer distorts their orbits.
+    bool regularizeEncounters = true;
+    float encounterDistance = 2.0f;         // pairs closer than this are regularized,
+    float encounterDynamicalSteps = 16.0f;  // as are pairs whose dynamical time is under this many steps
+    int encounterMaxSubsteps = 4096;
+};
+
+struct PhysicsStepStats {
+    size_t pairInteractions = 0;
+    int mergeCount = 0;
+    size_t analyticBodies = 0;
+    size_t regularizedPairs = 0;
+    size_t typeTransitions = 0;
+};
+
+// Totals over the local bodies at one instant where positions and velocities
+// agree (the start of a Euler step, the end of a leapfrog step).
+struct ConservedQuantities {
+    double kinetic = 0.0;
+    double potential = 0.0;          // same clamped potential as ComputeTotalEnergy
+    double momentum[3] = { 0.0, 0.0, 0.0 };
+    double angularMomentum[3] = { 0.0, 0.0, 0.0 }; // about the origin
+    double momentumScale = 0.0;      // sum of |m v|, to judge momentum drift against
+    double angularMomentumScale = 0.0; // sum of |r x m v|
+    double totalMass = 0.0;
+    vec3 centerOfMass = vec3(0.0f);
+    vec3 centerOfMassVelocity = vec3(0.0f);
+
+    double Energy() const { return kinetic + potential; }
+};
+
+// Drift of the conserved quantities since the baseline, which is re-taken
+// whenever something legitimately changes them (edits, merges, settings).
+// Momenta are refreshed every step. The potential falls out of the force pass,
+// so the energy is only refreshed by passes that visit every pair; with
+// Kepler propagation that is once per check interval.
+struct ConservationStats {
+    ConservedQuantities current;
+    ConservedQuantities baseline;
+    bool hasBaseline = false;
+    bool energyValid = false;        // current.potential belongs to the current positions
+    double energyDrift = 0.0;        // |E - E0| / |E0|
+    double momentumDrift = 0.0;      // |P - P0| / sum |m v|
+    double angularMomentumDrift = 0.0; // |L - L0| / sum |r x m v|
+    size_t energySamples = 0;        // energy measurements since the baseline
+};
+
+// Attractors owned by other processes in a domain-decomposed run. They pull on
+// every local body but are never integrated, merged or propagated here.
+struct GhostAttractors {
+    std::vector<vec3> positions;
+    std::vector<float> masses;
+};
+
+using GhostExchange = std::function<void(const std::vector<std::unique_ptr<SceneObject>>& objects, GhostAttractors& ghosts)>;
+
+// Headless N-body core: direct-summation gravity, merging on contact and time
+// integration. Has no GL dependencies so it can be driven by the benchmark.
+class PhysicsSystem {
+public:
+    PhysicsSettings Settings;
+
+    PhysicsStepStats Step(std::vector<std::unique_ptr<SceneObject>>& objects, float dt);
+
+    // Call after objects are added, removed or teleported outside of Step().
+    // Also returns every analytically propagated body to numerical integration.
+    void InvalidateAccelerations();
+
+    double ComputeTotalEnergy(const std::vector<std::unique_ptr<SceneObject>>& objects) const;
+
+    const ConservationStats& GetConservationStats() const { return conservation; }
+
+    // Type changes applied at the end of the last Step(). Mass thresholds are
+    // only evaluated for bodies that grew in a merge; callers that edit masses
+    // check those bodies themselves.
+    const std::vector<TypeTransitionEvent>& GetTypeTransitions() const { return transitions; }
+
+    // Drops the baseline; the next measurement becomes the new reference.
+    void ResetConservationBaseline();
+
+    // Refreshes the momenta and centre of mass outside of Step(), e.g. while
+    // paused. The energy stays invalid until the next full force pass.
+    void MeasureConservedQuantities(const std::vector<std::unique_ptr<SceneObject>>& objects);
+
+    // Called once before every force pass with the local bodies, so the caller
+    // can publish them and refresh the ghosts. The re-pass after a merge reuses
+    // the ghosts it already has.
+    void SetGhostExchange(GhostExchange exchange) { ghostExchange = std::move(exchange); }
+
+private:
+    // Two-body state of an analytically propagated body relative to its parent,
+    // captured at the moment it left numerical integration (the epoch).
+    struct KeplerOrbit {
+        int parent = -1; // -1 while the body is integrated numerically
+        double r0[3];
+        double v0[3];
+        double mu;
+        double semiMajorAxis;
+        double meanMotion;
+        double r0Length;
+        double eCosE0;              // e cos E and e sin E at the epoch
+        double eSinE0;
+        double elapsed;             // time since the epoch, wrapped to one period
+        double deltaE;              // eccentric anomaly change at the last propagation
+        double radius;              // distance to the parent at the last propagation
+        double relativeVelocity[3]; // at the last propagation, for re-syncing after kicks
+    };
+
+    // A regularized pair: the relative motion of second about first.
+    struct Encounter {
+        int first;
+        int second;
+        double relativePosition[3]; // captured at the start of the step
+        double relativeVelocity[3];
+        vec3 perturbation;          // external relative acceleration, held over the step
+    };
+
+    void GatherState(const std::vector<std::unique_ptr<SceneObject>>& objects);
+    size_t ComputeAccelerations(bool fullPass);
+    int ResolveCollisions(std::vector<std::unique_ptr<SceneObject>>& objects);
+    void QueueTypeTransition(SceneObject& object);
+    size_t EvaluateForces(std::vector<std::unique_ptr<SceneObject>>& objects, PhysicsStepStats& stats, bool fullPass);
+    void UpdateConservation(const std::vector<std::unique_ptr<SceneObject>>& objects);
+
+    void ResetKeplerOrbits(size_t count);
+    void ClassifyKeplerBodies(const std::vector<std::unique_ptr<SceneObject>>& objects);
+    void PropagateKeplerBodies(std::vector<std::unique_ptr<SceneObject>>& objects, float dt);
+    void SyncKeplerVelocities(std::vector<std::unique_ptr<SceneObject>>& objects);
+    void DropEditedKeplerOrbits(const std::vector<std::unique_ptr<SceneObject>>& objects);
+    void GroupKeplerLevels();
+    static void AdvanceKeplerOrbit(KeplerOrbit& orbit, double dt, double r_out[3]);
+    bool IsAnalytic(size_t i) const { return orbits[i].parent >= 0; }
+
+    void ResetEncounters(size_t count);
+    void ApplyEncounterAccelerations();
+    void CaptureEncounters(const std::vector<std::unique_ptr<SceneObject>>& objects);
+    void AdvanceEncounters(std::vector<std::unique_ptr<SceneObject>>& objects, float dt);
+    void DetectEncounters(const std::vector<std::unique_ptr<SceneObject>>& objects, float dt);
+
+    ThreadPool pool;
+
+    std::vector<vec3> positions;
+    std::vector<vec3> accelerations;
+    std::vector<float> masses;
+    std::vector<float> radii;
+    std::vector<int> attractors;
+    std::vector<std::vector<std::pair<int, int>>> contacts; // one list per worker
+    std::vector<double> potentialPartials;                  // one sum per worker
+    double pairPotential = 0.0;  // of the last force pass that visited every pair
+    bool pairPotentialFresh = false;
+
+    std::vector<KeplerOrbit> orbits;
+    std::vector<int> strongestAttractors;      // two per body, filled on full passes
+    std::vector<std::vector<int>> keplerLevels; // analytic bodies grouped by parent depth
+    size_t analyticCount = 0;
+    int stepsSinceCheck = 0;
+
+    std::vector<Encounter> encounters;
+    std::vector<int> encounterPartner;  // per body, -1 when not in a pair
+    std::vector<int> nearestAttractor;  // per body, filled while regularization is on
+    std::vector<char> encounterTouched; // per encounter, closest approach reached contact
+    std::vector<std::pair<int, int>> encounterContacts;
+
+    GhostExchange ghostExchange;
+    GhostAttractors ghosts;
+
+    ConservationStats conservation;
+    std::vector<TypeTransitionEvent> transitions; // of the current step, applied at its end
+
+    bool accelerationsValid = false;
+};
@@ -0,0 +1,470 @@
+// Physics scaling benchmark.
+//
+// Sweeps body count, solver, integrator, thread count and process (rank) count
+// over generated scenes and reports step-time statistics, pair throughput and
+// energy drift as JSON and CSV. Configurations are always emitted in the same order with the same keys so
+// reports from two commits can be diffed directly.
+//
+//   ./physics_bench --n 64,256,1024 --threads 1,4 --integrator euler,leapfrog --out bench_results
+//   ./physics_bench --n 4096 --ranks 1,2,4 --verify 1
+//   ./physics_bench --scene satellites --n 20000 --solver direct,kepler --integrator leapfrog
+//   ./physics_bench --self-test
+
+#include "Physics.h"
+#include "DomainDecomposition.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BenchOptions {
+    std::vector<int> bodyCounts = { 64, 256, 1024 };
+    std::vector<int> threadCounts = { 1 };
+    std::vector<int> rankCounts = { 1 };
+    int migrationInterval = 10;
+    bool verify = false;
+    bool selfTest = false;
+    std::vector<std::string> solvers = { "direct" };
+    std::vector<std::string> integrators = { "euler", "leapfrog" };
+    std::string scene = "planets";
+    int attractorCount = 100;
+    int steps = 200;
+    int warmupSteps = 10;
+    float dt = 1.0f / 60.0f;
+    unsigned int seed = 410;
+    std::string outPrefix = "bench_results";
+};
+
+struct BenchResult {
+    std::string solver;
+    std::string integrator;
+    int bodyCount = 0;
+    int threads = 0;
+    int ranks = 1;
+    double medianStepMs = 0.0;
+    double p95StepMs = 0.0;
+    double meanStepMs = 0.0;
+    double pairsPerSecond = 0.0;
+    double relativeEnergyDrift = 0.0;
+    int merges = 0;
+    int finalBodyCount = 0;
+    size_t migratedBodies = 0;
+    double maxDeviation = 0.0; // largest position difference to the single-process run, with --verify
+    double analyticBodies = 0.0; // mean over the measured steps of bodies on analytic orbits
+};
+
+static std::vector<std::string> split_list(const char* arg) {
+    std::vector<std::string> items;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+static std::vector<int> split_int_list(const char* arg) {
+    std::vector<int> values;
+    for (const auto& item : split_list(arg)) values.push_back(std::atoi(item.c_str()));
+    return values;
+}
+
+static void print_usage() {
+    std::printf(
+        "usage: physics_bench [options]\n"
+        "  --n LIST           body counts (default 64,256,1024)\n"
+        "  --threads LIST     worker thread counts per process (default 1)\n"
+        "  --ranks LIST       processes sharing the scene over POSIX shared memory (default 1)\n"
+        "  --migrate N        steps between slab re-balancing for ranks > 1 (default 10)\n"
+        "  --verify 0|1       also run single-process and report the largest position deviation (default 0)\n"
+        "  --solver LIST      direct, kepler (direct + analytic two-body propagation) (default direct)\n"
+        "  --integrator LIST  euler,leapfrog (default both)\n"
+        "  --scene NAME       planets: a star and N-1 mass-1 planets, all attractors (default)\n"
+        "                     satellites: a star, --attractors gas giants and massless test particles around them\n"
+        "  --attractors N     gas giants in the satellites scene (default 100)\n"
+        "  --steps N          measured steps per configuration (default 200)\n"
+        "  --warmup N         unmeasured steps before timing (default 10)\n"
+        "  --dt SECONDS       step size (default 1/60)\n"
+        "  --seed N           scene generator seed (default 410)\n"
+        "  --out PREFIX       writes PREFIX.json and PREFIX.csv (default bench_results)\n"
+        "  --self-test        only run the regression checks of the code the benchmark uses\n");
+}
+
+static bool parse_options(int argc, char** argv, BenchOptions& opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0) {
+            print_usage();
+            std::exit(0);
+        }
+        if (std::strcmp(arg, "--self-test") == 0) {
+            opts.selfTest = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "Error: missing value for %s\n", arg);
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (std::strcmp(arg, "--n") == 0) opts.bodyCounts = split_int_list(value);
+        else if (std::strcmp(arg, "--threads") == 0) opts.threadCounts = split_int_list(value);
+        else if (std::strcmp(arg, "--ranks") == 0) opts.rankCounts = split_int_list(value);
+        else if (std::strcmp(arg, "--migrate") == 0) opts.migrationInterval = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--verify") == 0) opts.verify = std::atoi(value) != 0;
+        else if (std::strcmp(arg, "--solver") == 0) opts.solvers = split_list(value);
+        else if (std::strcmp(arg, "--integrator") == 0) opts.integrators = split_list(value);
+        else if (std::strcmp(arg, "--scene") == 0) opts.scene = value;
+        else if (std::strcmp(arg, "--attractors") == 0) opts.attractorCount = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--steps") == 0) opts.steps = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--warmup") == 0) opts.warmupSteps = std::max(0, std::atoi(value));
+        else if (std::strcmp(arg, "--dt") == 0) opts.dt = static_cast<float>(std::atof(value));
+        else if (std::strcmp(arg, "--seed") == 0) opts.seed = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(arg, "--out") == 0) opts.outPrefix = value;
+        else {
+            std::fprintf(stderr, "Error: unknown option %s\n", arg);
+            return false;
+        }
+    }
+
+    for (int ranks : opts.rankCounts) {
+        if (ranks < 1 || ranks > MAX_DOMAIN_RANKS) {
+            std::fprintf(stderr, "Error: rank count %d out of range (1-%d)\n", ranks, MAX_DOMAIN_RANKS);
+            return false;
+        }
+    }
+    for (const auto& solver : opts.solvers) {
+        if (solver != "direct" && solver != "kepler") {
+            std::fprintf(stderr, "Error: unknown solver '%s' (available: direct, kepler)\n", solver.c_str());
+            return false;
+        }
+    }
+    for (const auto& integrator : opts.integrators) {
+        if (integrator != "euler" && integrator != "leapfrog") {
+            std::fprintf(stderr, "Error: unknown integrator '%s' (available: euler, leapfrog)\n", integrator.c_str());
+            return false;
+        }
+    }
+    if (opts.scene != "planets" && opts.scene != "satellites") {
+        std::fprintf(stderr, "Error: unknown scene '%s' (available: planets, satellites)\n", opts.scene.c_str());
+        return false;
+    }
+    return true;
+}
+
+// A star at the origin with bodyCount - 1 rocky planets on circular, slightly
+// inclined orbits. Orbits are spread out with N so merges stay rare. Every
+// planet has mass, so each one perturbs all the others.
+static std::vector<std::unique_ptr<SceneObject>> generate_planet_scene(int bodyCount, float G, unsigned int seed) {
+    std::vector<std::unique_ptr<SceneObject>> objects;
+    if (bodyCount <= 0) return objects;
+
+    std::mt19937 rng(seed + static_cast<unsigned int>(bodyCount));
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    auto star = std::make_unique<SceneObject>(ObjectType::Star, vec3(0.0f), 0.0f);
+    float starMass = star->Mass;
+    objects.push_back(std::move(star));
+
+    float innerRadius = 30.0f;
+    float outerRadius = innerRadius + 4.0f * static_cast<float>(bodyCount);
+
+    for (int i = 1; i < bodyCount; ++i) {
+        float radius = innerRadius + (outerRadius - innerRadius) * unit(rng);
+        float angle = 2.0f * static_cast<float>(M_PI) * unit(rng);
+        float height = (unit(rng) - 0.5f) * 2.0f;
+
+        vec3 position(radius * std::cos(angle), height, radius * std::sin(angle));
+        vec3 tangent(-std::sin(angle), 0.0f, std::cos(angle));
+        float speed = std::sqrt(G * starMass / radius);
+
+        auto body = std::make_unique<SceneObject>(ObjectType::RockyPlanet, position, 0.0f);
+        body->velocity = tangent * speed;
+        objects.push_back(std::move(body));
+    }
+    return objects;
+}
+
+// A star at the origin, attractorCount gas giants evenly spaced on one
+// circular orbit, and the remaining bodies as massless test particles on
+// circular orbits of 4-8 units around the giants, round robin. The ring is
+// wide enough that neither the star nor a neighbouring giant perturbs a
+// particle by more than a few 1e-4 of its giant's pull, under the default
+// keplerThreshold, so this is the scene the kepler solver is meant for: few
+// attractors, many isolated orbits.
+static std::vector<std::unique_ptr<SceneObject>> generate_satellite_scene(int bodyCount, int attractorCount, float G, unsigned int seed) {
+    std::vector<std::unique_ptr<SceneObject>> objects;
+    if (bodyCount <= 0) return objects;
+
+    std::mt19937 rng(seed + static_cast<unsigned int>(bodyCount));
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    auto star = std::make_unique<SceneObject>(ObjectType::Star, vec3(0.0f), 0.0f);
+    float starMass = star->Mass;
+    objects.push_back(std::move(star));
+
+    const int giants = std::min(attractorCount, bodyCount - 1);
+    const float giantSpacing = 150.0f;
+    const float ringRadius = std::max(300.0f, giantSpacing * static_cast<float>(giants) / (2.0f * static_cast<float>(M_PI)));
+    const float ringSpeed = std::sqrt(G * starMass / ringRadius);
+    for (int k = 0; k < giants; ++k) {
+        float angle = 2.0f * static_cast<float>(M_PI) * static_cast<float>(k) / static_cast<float>(giants);
+        vec3 position(ringRadius * std::cos(angle), 0.0f, ringRadius * std::sin(angle));
+        auto giant = std::make_unique<SceneObject>(ObjectType::GasGiant, position, 0.0f);
+        giant->velocity = vec3(-std::sin(angle), 0.0f, std::cos(angle)) * ringSpeed;
+        objects.push_back(std::move(giant));
+    }
+
+    for (int i = 1 + giants; i < bodyCount; ++i) {
+        const SceneObject& giant = *objects[1 + (i - 1 - giants) % giants];
+        float radius = 4.0f + 4.0f * unit(rng);
+        float angle = 2.0f * static_cast<float>(M_PI) * unit(rng);
+        float tilt = (unit(rng) - 0.5f) * 0.5f;
+
+        // Circular orbit in a plane tilted about the x axis.
+        vec3 offset(radius * std::cos(angle), radius * std::sin(angle) * std::sin(tilt), radius * std::sin(angle) * std::cos(tilt));
+        vec3 tangent(-std::sin(angle), std::cos(angle) * std::sin(tilt), std::cos(angle) * std::cos(tilt));
+        float speed = std::sqrt(G * giant.Mass / radius);
+
+        auto particle = std::make_unique<SceneObject>(ObjectType::RockyPlanet, giant.GetPosition() + offset, 0.0f);
+        particle->Mass = 0.0f;
+        particle->velocity = giant.velocity + tangent * speed;
+        objects.push_back(std::move(particle));
+    }
+    return objects;
+}
+
+static std::vector<std::unique_ptr<SceneObject>> generate_scene(const BenchOptions& opts, int bodyCount, float G) {
+    if (opts.scene == "satellites") return generate_satellite_scene(bodyCount, opts.attractorCount, G, opts.seed);
+    return generate_planet_scene(bodyCount, G, opts.seed);
+}
+
+static double percentile(std::vector<double> sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+    rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+    return sorted[rank - 1];
+}
+
+// Largest position difference between two runs of the same scene, or -1 when
+// they merged differently and bodies no longer correspond.
+static double max_deviation(const std::vector<std::unique_ptr<SceneObject>>& a, const std::vector<std::unique_ptr<SceneObject>>& b) {
+    if (a.size() != b.size()) return -1.0;
+    double deviation = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        deviation = std::max(deviation, static_cast<double>(length(a[i]->GetPosition() - b[i]->GetPosition())));
+    }
+    return deviation;
+}
+
+static bool run_configuration(const BenchOptions& opts, const std::string& solver, const std::string& integrator, int bodyCount, int threads, int ranks, BenchResult& result) {
+    PhysicsSystem physics;
+    physics.Settings.threadCount = threads;
+    physics.Settings.integrator = (integrator == "leapfrog") ? IntegratorType::Leapfrog : IntegratorType::SemiImplicitEuler;
+    physics.Settings.keplerPropagation = (solver == "kepler");
+
+    auto objects = generate_scene(opts, bodyCount, physics.Settings.gravitationalConstant);
+
+    for (int i = 0; i < opts.warmupSteps; ++i) physics.Step(objects, opts.dt);
+
+    double initialEnergy = physics.ComputeTotalEnergy(objects);
+
+    std::vector<std::unique_ptr<SceneObject>> reference;
+    if (opts.verify && ranks > 1) {
+        for (const auto& obj : objects) reference.push_back(std::make_unique<SceneObject>(*obj));
+    }
+
+    std::vector<double> stepMs;
+    stepMs.reserve(opts.steps);
+    size_t totalPairs = 0;
+    double totalSeconds = 0.0;
+    int merges = 0;
+    size_t migrated = 0;
+    size_t analyticSteps = 0; // analytic bodies summed over the steps
+
+    if (ranks == 1) {
+        for (int i = 0; i < opts.steps; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            PhysicsStepStats stats = physics.Step(objects, opts.dt);
+            auto end = std::chrono::steady_clock::now();
+
+            double seconds = std::chrono::duration<double>(end - start).count();
+            stepMs.push_back(seconds * 1000.0);
+            totalSeconds += seconds;
+            totalPairs += stats.pairInteractions;
+            merges += stats.mergeCount;
+            analyticSteps += stats.analyticBodies;
+        }
+    }
+    else {
+        DomainSettings domain;
+        domain.rankCount = ranks;
+        domain.migrationInterval = opts.migrationInterval;
+
+        DomainRunReport report;
+        std::string error;
+        if (!run_domain_decomposed(objects, physics.Settings, domain, opts.steps, opts.dt, report, error)) {
+            std::fprintf(stderr, "Error: %s\n", error.c_str());
+            return false;
+        }
+        for (double seconds : report.stepSeconds) {
+            stepMs.push_back(seconds * 1000.0);
+            totalSeconds += seconds;
+        }
+        totalPairs = report.pairInteractions;
+        merges = report.mergeCount;
+        migrated = report.migratedBodies;
+    }
+
+    // The ranks start from a fresh solver, so the reference does too.
+    double deviation = 0.0;
+    if (!reference.empty()) {
+        PhysicsSystem single;
+        single.Settings = physics.Settings;
+        for (int i = 0; i < opts.steps; ++i) single.Step(reference, opts.dt);
+        deviation = max_deviation(objects, reference);
+    }
+
+    double finalEnergy = physics.ComputeTotalEnergy(objects);
+
+    result = BenchResult();
+    result.solver = solver;
+    result.integrator = integrator;
+    result.bodyCount = bodyCount;
+    result.threads = threads;
+    result.ranks = ranks;
+    result.medianStepMs = percentile(stepMs, 0.5);
+    result.p95StepMs = percentile(stepMs, 0.95);
+    result.meanStepMs = totalSeconds * 1000.0 / static_cast<double>(opts.steps);
+    result.pairsPerSecond = totalSeconds > 0.0 ? static_cast<double>(totalPairs) / totalSeconds : 0.0;
+    result.relativeEnergyDrift = initialEnergy != 0.0 ? std::fabs((finalEnergy - initialEnergy) / initialEnergy) : 0.0;
+    result.merges = merges;
+    result.finalBodyCount = static_cast<int>(objects.size());
+    result.migratedBodies = migrated;
+    result.maxDeviation = deviation;
+    result.analyticBodies = static_cast<double>(analyticSteps) / static_cast<double>(opts.steps);
+    return true;
+}
+
+static bool write_json(const std::string& path, const BenchOptions& opts, const std::vector<BenchResult>& results) {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+
+    std::fprintf(f, "{\n");
+    std::fprintf(f, "  \"schema\": \"physics-bench/3\",\n");
+    std::fprintf(f, "  \"scene\": \"%s\",\n", opts.scene.c_str());
+    std::fprintf(f, "  \"attractors\": %d,\n", opts.attractorCount);
+    std::fprintf(f, "  \"steps\": %d,\n", opts.steps);
+    std::fprintf(f, "  \"warmup_steps\": %d,\n", opts.warmupSteps);
+    std::fprintf(f, "  \"dt\": %.9g,\n", opts.dt);
+    std::fprintf(f, "  \"seed\": %u,\n", opts.seed);
+    std::fprintf(f, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        std::fprintf(f,
+            "    {\"solver\": \"%s\", \"integrator\": \"%s\", \"n\": %d, \"threads\": %d, \"ranks\": %d, "
+            "\"median_step_ms\": %.6f, \"p95_step_ms\": %.6f, \"mean_step_ms\": %.6f, "
+            "\"pair_interactions_per_sec\": %.6e, \"relative_energy_drift\": %.6e, "
+            "\"merges\": %d, \"final_n\": %d, \"migrated\": %zu, \"max_deviation\": %.6e, \"analytic_bodies\": %.1f}%s\n",
+            r.solver.c_str(), r.integrator.c_str(), r.bodyCount, r.threads, r.ranks,
+            r.medianStepMs, r.p95StepMs, r.meanStepMs,
+            r.pairsPerSecond, r.relativeEnergyDrift,
+            r.merges, r.finalBodyCount, r.migratedBodies, r.maxDeviation, r.analyticBodies, (i + 1 < results.size()) ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+    std::fclose(f);
+    return true;
+}
+
+static bool write_csv(const std::string& path, const std::vector<BenchResult>& results) {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+
+    std::fprintf(f, "solver,integrator,n,threads,ranks,median_step_ms,p95_step_ms,mean_step_ms,pair_interactions_per_sec,relative_energy_drift,merges,final_n,migrated,max_deviation,analytic_bodies\n");
+    for (const BenchResult& r : results) {
+        std::fprintf(f, "%s,%s,%d,%d,%d,%.6f,%.6f,%.6f,%.6e,%.6e,%d,%d,%zu,%.6e,%.1f\n",
+            r.solver.c_str(), r.integrator.c_str(), r.bodyCount, r.threads, r.ranks,
+            r.medianStepMs, r.p95StepMs, r.meanStepMs,
+            r.pairsPerSecond, r.relativeEnergyDrift,
+            r.merges, r.finalBodyCount, r.migratedBodies, r.maxDeviation, r.analyticBodies);
+    }
+    std::fclose(f);
+    return true;
+}
+
+// Regression check (--self-test) for the pool the physics step shares: resizing between
+// jobs, as the thread count setting does, must neither rerun the last job on
+// the new workers nor lose any part of the next one.
+static bool check_thread_pool_resize() {
+    const size_t count = 1000;
+    const size_t expected = count * (count - 1) / 2;
+    ThreadPool pool(2);
+    for (int threads : { 2, 3, 1, 4, 2 }) {
+        pool.Resize(threads);
+        // Give the new workers time to start, which is when a stale job would run.
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        std::vector<size_t> sums(pool.GetThreadCount(), 0);
+        pool.ParallelFor(count, [&](size_t begin, size_t end, int worker) {
+            for (size_t i = begin; i < end; ++i) sums[worker] += i;
+        });
+        size_t total = 0;
+        for (size_t sum : sums) total += sum;
+        if (total != expected) {
+            std::fprintf(stderr, "Error: thread pool resized to %d threads summed %zu, expected %zu\n", threads, total, expected);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opts;
+    if (!parse_options(argc, argv, opts)) {
+        print_usage();
+        return 1;
+    }
+    if (opts.selfTest) {
+        if (!check_thread_pool_resize()) return 1;
+        std::printf("Self-test passed\n");
+        return 0;
+    }
+
+    std::vector<BenchResult> results;
+    for (const auto& solver : opts.solvers) {
+        for (const auto& integrator : opts.integrators) {
+            for (int bodyCount : opts.bodyCounts) {
+                for (int threads : opts.threadCounts) {
+                    for (int ranks : opts.rankCounts) {
+                        BenchResult r;
+                        if (!run_configuration(opts, solver, integrator, bodyCount, threads, ranks, r)) return 1;
+                        std::printf("%-8s %-9s n=%-7d threads=%-3d ranks=%-3d median=%9.3f ms  p95=%9.3f ms  pairs/s=%.3e  drift=%.3e",
+                            r.solver.c_str(), r.integrator.c_str(), r.bodyCount, r.threads, r.ranks,
+                            r.medianStepMs, r.p95StepMs, r.pairsPerSecond, r.relativeEnergyDrift);
+                        if (r.solver == "kepler") std::printf("  analytic=%.0f", r.analyticBodies);
+                        if (opts.verify && ranks > 1) std::printf("  deviation=%.3e", r.maxDeviation);
+                        std::printf("\n");
+                        results.push_back(r);
+                    }
+                }
+            }
+        }
+    }
+
+    std::string jsonPath = opts.outPrefix + ".json";
+    std::string csvPath = opts.outPrefix + ".csv";
+    if (!write_json(jsonPath, opts, results) || !write_csv(csvPath, results)) {
+        std::fprintf(stderr, "Error: could not write benchmark report to %s.{json,csv}\n", opts.outPrefix.c_str());
+        return 1;
+    }
+    std::printf("Wrote %s and %s\n", jsonPath.c_str(), csvPath.c_str());
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "Regularization.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double KS_STEPS_PER_ORBIT = 64.0;
+const double KS_UNBOUND_STEP = 0.1; // fraction of the local dynamical time for hyperbolic passages
+
+struct KSState {
+    double u[4];
+    double w[4]; // du/dtau
+    double h;    // specific orbital energy
+    double t;    // physical time since the start of the step
+};
+
+double dot4(const double a[4], const double b[4]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+}
+
+// L(u) x, the KS matrix applied to a 4-vector.
+void ks_apply(const double u[4], const double x[4], double out[4]) {
+    out[0] = u[0] * x[0] - u[1] * x[1] - u[2] * x[2] + u[3] * x[3];
+    out[1] = u[1] * x[0] + u[0] * x[1] - u[3] * x[2] - u[2] * x[3];
+    out[2] = u[2] * x[0] + u[3] * x[1] + u[0] * x[2] + u[1] * x[3];
+    out[3] = u[3] * x[0] - u[2] * x[1] + u[1] * x[2] - u[0] * x[3];
+}
+
+// L(u)^T x
+void ks_apply_transpose(const double u[4], const double x[4], double out[4]) {
+    out[0] = u[0] * x[0] + u[1] * x[1] + u[2] * x[2] + u[3] * x[3];
+    out[1] = -u[1] * x[0] + u[0] * x[1] + u[3] * x[2] - u[2] * x[3];
+    out[2] = -u[2] * x[0] - u[3] * x[1] + u[0] * x[2] + u[1] * x[3];
+    out[3] = u[3] * x[0] - u[2] * x[1] + u[1] * x[2] - u[0] * x[3];
+}
+
+// u'' = (h/2) u + (r/2) L^T P,  h' = 2 u'.L^T P,  t' = r
+void ks_derivative(const KSState& s, const double P[4], KSState& d) {
+    double r = dot4(s.u, s.u);
+    double LtP[4];
+    ks_apply_transpose(s.u, P, LtP);
+    for (int k = 0; k < 4; ++k) {
+        d.u[k] = s.w[k];
+        d.w[k] = 0.5 * s.h * s.u[k] + 0.5 * r * LtP[k];
+    }
+    d.h = 2.0 * dot4(s.w, LtP);
+    d.t = r;
+}
+
+void ks_axpy(const KSState& s, const KSState& d, double scale, KSState& out) {
+    for (int k = 0; k < 4; ++k) {
+        out.u[k] = s.u[k] + scale * d.u[k];
+        out.w[k] = s.w[k] + scale * d.w[k];
+    }
+    out.h = s.h + scale * d.h;
+    out.t = s.t + scale * d.t;
+}
+
+void ks_rk4(KSState& s, const double P[4], double dtau) {
+    KSState k1, k2, k3, k4, tmp;
+    ks_derivative(s, P, k1);
+    ks_axpy(s, k1, 0.5 * dtau, tmp);
+    ks_derivative(tmp, P, k2);
+    ks_axpy(s, k2, 0.5 * dtau, tmp);
+    ks_derivative(tmp, P, k3);
+    ks_axpy(s, k3, dtau, tmp);
+    ks_derivative(tmp, P, k4);
+
+    const double w = dtau / 6.0;
+    for (int k = 0; k < 4; ++k) {
+        s.u[k] += w * (k1.u[k] + 2.0 * k2.u[k] + 2.0 * k3.u[k] + k4.u[k]);
+        s.w[k] += w * (k1.w[k] + 2.0 * k2.w[k] + 2.0 * k3.w[k] + k4.w[k]);
+    }
+    s.h += w * (k1.h + 2.0 * k2.h + 2.0 * k3.h + k4.h);
+    s.t += w * (k1.t + 2.0 * k2.t + 2.0 * k3.t + k4.t);
+}
+
+} // namespace
+
+RegularizedStepResult advance_regularized_pair(double r[3], double v[3], double mu, const double perturbation[3],
+                                               double dt, int maxSubsteps) {
+    RegularizedStepResult result;
+    const double r_len = std::sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+    result.minSeparation = r_len;
+    if (r_len <= 0.0 || mu <= 0.0 || dt <= 0.0) return result;
+
+    // Position to KS coordinates, choosing the branch that avoids cancellation.
+    KSState s;
+    if (r[0] >= 0.0) {
+        s.u[0] = std::sqrt(0.5 * (r_len + r[0]));
+        s.u[1] = 0.5 * r[1] / s.u[0];
+        s.u[2] = 0.5 * r[2] / s.u[0];
+        s.u[3] = 0.0;
+    }
+    else {
+        s.u[1] = std::sqrt(0.5 * (r_len - r[0]));
+        s.u[0] = 0.5 * r[1] / s.u[1];
+        s.u[2] = 0.0;
+        s.u[3] = 0.5 * r[2] / s.u[1];
+    }
+    const double v4[4] = { v[0], v[1], v[2], 0.0 };
+    ks_apply_transpose(s.u, v4, s.w);
+    for (double& w : s.w) w *= 0.5;
+
+    s.h = 0.5 * (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]) - mu / r_len;
+    s.t = 0.0;
+
+    const double P[4] = { perturbation[0], perturbation[1], perturbation[2], 0.0 };
+
+    // Bound orbits are harmonic oscillators in u with frequency sqrt(-h/2), so a
+    // constant fictitious step resolves every phase of the orbit equally well.
+    // The last steps aim at t = dt using t' = r; they may land slightly past it
+    // and step back, which is a Newton iteration on t(tau).
+    while (result.substeps < maxSubsteps) {
+        double remaining = dt - s.t;
+        if (std::fabs(remaining) <= 1e-12 * dt) break;
+
+        double rr = dot4(s.u, s.u);
+        double dtau = (s.h < 0.0) ? (M_PI / std::sqrt(-0.5 * s.h)) / KS_STEPS_PER_ORBIT
+                                  : KS_UNBOUND_STEP * std::sqrt(rr / mu);
+        dtau = std::min(dtau, remaining / rr);
+
+        ks_rk4(s, P, dtau);
+        result.substeps++;
+        result.minSeparation = std::min(result.minSeparation, dot4(s.u, s.u));
+    }
+
+    double x[4];
+    ks_apply(s.u, s.u, x);
+    double vel[4];
+    ks_apply(s.u, s.w, vel);
+    const double rr = dot4(s.u, s.u);
+    for (int k = 0; k < 3; ++k) {
+        r[k] = x[k];
+        v[k] = 2.0 * vel[k] / rr;
+    }
+    return result;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+struct RegularizedStepResult {
+    double minSeparation = 0.0; // closest approach seen at the substep boundaries
+    int substeps = 0;
+};
+
+// Advances the relative motion r, v (second body minus first) of a pair with
+// gravitational parameter mu over dt, in Kustaanheimo-Stiefel coordinates.
+// The 1/r singularity vanishes there, so close and even head-on passages take
+// well-behaved substeps of fictitious time instead of vanishing physical ones.
+// perturbation is the external relative acceleration, held constant over dt.
+RegularizedStepResult advance_regularized_pair(double r[3], double v[3], double mu, const double perturbation[3],
+                                               double dt, int maxSubsteps);
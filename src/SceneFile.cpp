@@ -0,0 +1,439 @@
+#include "SceneFile.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+namespace {
+
+const char SCENE_FILE_MAGIC[8] = { 'S', 'C', 'E', 'N', 'E', 'B', 'I', 'N' };
+const uint32_t SCENE_FILE_ENDIAN_TAG = 0x01020304u;
+const int32_t MAX_OBJECT_TYPE = static_cast<int32_t>(ObjectType::BlackHole);
+const size_t WRITE_CHUNK_BYTES = 8 << 20;
+
+uint64_t align_up(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+struct MaterialKey {
+    uint32_t words[8];
+    bool operator==(const MaterialKey& other) const { return std::memcmp(words, other.words, sizeof(words)) == 0; }
+};
+
+struct MaterialKeyHash {
+    size_t operator()(const MaterialKey& key) const {
+        uint64_t h = 1469598103934665603ull;
+        for (uint32_t w : key.words) h = (h ^ w) * 1099511628211ull;
+        return static_cast<size_t>(h);
+    }
+};
+
+SceneFileMaterial to_file_material(const GPUmaterial& m) {
+    SceneFileMaterial out = {};
+    out.albedo[0] = m.albedo.x;
+    out.albedo[1] = m.albedo.y;
+    out.albedo[2] = m.albedo.z;
+    out.emission = m.emission;
+    out.metallic = m.metallic;
+    out.roughness = m.roughness;
+    out.textureID = m.textureID;
+    return out;
+}
+
+GPUmaterial from_file_material(const SceneFileMaterial& m) {
+    GPUmaterial out;
+    out.albedo = vec3(m.albedo[0], m.albedo[1], m.albedo[2]);
+    out.emission = m.emission;
+    out.metallic = m.metallic;
+    out.roughness = m.roughness;
+    out.textureID = m.textureID;
+    return out;
+}
+
+struct SectionSource {
+    uint32_t id;
+    uint32_t elementSize;
+    uint64_t count;
+    const void* data;
+};
+
+template <typename T>
+SectionSource section_of(uint32_t id, const std::vector<T>& values, uint32_t elementsPerItem = 1) {
+    return { id, static_cast<uint32_t>(sizeof(T) * elementsPerItem), values.size() / elementsPerItem, values.data() };
+}
+
+// Typed view of one section inside the mapped file.
+template <typename T>
+const T* find_section(const char* base, const SceneFileSection* sections, uint32_t sectionCount,
+                      uint32_t id, uint64_t expectedCount, uint32_t elementSize, std::string& error) {
+    for (uint32_t s = 0; s < sectionCount; ++s) {
+        if (sections[s].id != id) continue;
+        if (sections[s].elementSize != elementSize || sections[s].count != expectedCount) {
+            error = "section " + std::to_string(id) + " has an unexpected size";
+            return nullptr;
+        }
+        return reinterpret_cast<const T*>(base + sections[s].offset);
+    }
+    error = "missing section " + std::to_string(id);
+    return nullptr;
+}
+
+} // namespace
+
+void capture_scene_snapshot(const std::vector<std::unique_ptr<SceneObject>>& objects, SceneSnapshot& snapshot) {
+    const size_t n = objects.size();
+    snapshot = SceneSnapshot();
+    snapshot.types.reserve(n);
+    snapshot.flags.reserve(n);
+    snapshot.masses.reserve(n);
+    snapshot.positions.reserve(n * 3);
+    snapshot.velocities.reserve(n * 3);
+    snapshot.orientations.reserve(n * 4);
+    snapshot.angularVelocities.reserve(n * 3);
+    snapshot.primitiveRanges.reserve(n * 2);
+    snapshot.nameOffsets.reserve(n + 1);
+    snapshot.primitiveTypes.reserve(n);
+    snapshot.primitiveRadii.reserve(n * 2);
+    snapshot.primitiveMaterials.reserve(n);
+
+    std::unordered_map<MaterialKey, uint32_t, MaterialKeyHash> materialIndex;
+
+    for (const auto& obj_ptr : objects) {
+        const SceneObject& obj = *obj_ptr;
+        const vec3 position = obj.GetPosition();
+
+        snapshot.types.push_back(static_cast<int32_t>(obj.Type));
+        snapshot.flags.push_back((obj.hasRings ? SCENE_BODY_FLAG_RINGS : 0u) | (obj.TrailEnabled ? SCENE_BODY_FLAG_TRAIL : 0u));
+        snapshot.masses.push_back(obj.Mass);
+        snapshot.positions.insert(snapshot.positions.end(), { position.x, position.y, position.z });
+        snapshot.velocities.insert(snapshot.velocities.end(), { obj.velocity.x, obj.velocity.y, obj.velocity.z });
+        snapshot.orientations.insert(snapshot.orientations.end(), { obj.Orientation.x, obj.Orientation.y, obj.Orientation.z, obj.Orientation.w });
+        snapshot.angularVelocities.insert(snapshot.angularVelocities.end(), { obj.AngularVelocity.x, obj.AngularVelocity.y, obj.AngularVelocity.z });
+
+        snapshot.nameOffsets.push_back(static_cast<uint32_t>(snapshot.nameData.size()));
+        snapshot.nameData.insert(snapshot.nameData.end(), obj.Name.begin(), obj.Name.end());
+
+        snapshot.primitiveRanges.push_back(static_cast<uint32_t>(snapshot.primitiveTypes.size()));
+        snapshot.primitiveRanges.push_back(static_cast<uint32_t>(obj.GetGpuObjectCount()));
+
+        for (const GPUobject& gpuObj : obj.gpuObjects) {
+            snapshot.primitiveTypes.push_back(gpuObj.type);
+            snapshot.primitiveRadii.push_back(gpuObj.r1);
+            snapshot.primitiveRadii.push_back(gpuObj.r2);
+
+            SceneFileMaterial material = to_file_material(gpuObj.m);
+            MaterialKey key;
+            std::memcpy(key.words, &material, sizeof(key.words));
+
+            auto [it, inserted] = materialIndex.emplace(key, static_cast<uint32_t>(snapshot.materials.size()));
+            if (inserted) snapshot.materials.push_back(material);
+            snapshot.primitiveMaterials.push_back(it->second);
+        }
+    }
+    snapshot.nameOffsets.push_back(static_cast<uint32_t>(snapshot.nameData.size()));
+}
+
+bool write_scene_snapshot(const std::string& filename, const SceneSnapshot& snapshot, std::string& error,
+                          std::atomic<float>* progress) {
+    const SectionSource sources[] = {
+        section_of(SECTION_BODY_TYPE, snapshot.types),
+        section_of(SECTION_BODY_FLAGS, snapshot.flags),
+        section_of(SECTION_BODY_MASS, snapshot.masses),
+        section_of(SECTION_BODY_POSITION, snapshot.positions, 3),
+        section_of(SECTION_BODY_VELOCITY, snapshot.velocities, 3),
+        section_of(SECTION_BODY_ORIENTATION, snapshot.orientations, 4),
+        section_of(SECTION_BODY_ANGULAR_VELOCITY, snapshot.angularVelocities, 3),
+        section_of(SECTION_BODY_PRIMITIVES, snapshot.primitiveRanges, 2),
+        section_of(SECTION_BODY_NAME_OFFSETS, snapshot.nameOffsets),
+        section_of(SECTION_NAME_DATA, snapshot.nameData),
+        section_of(SECTION_PRIMITIVE_TYPE, snapshot.primitiveTypes),
+        section_of(SECTION_PRIMITIVE_RADII, snapshot.primitiveRadii, 2),
+        section_of(SECTION_PRIMITIVE_MATERIAL, snapshot.primitiveMaterials),
+        section_of(SECTION_MATERIALS, snapshot.materials),
+    };
+    const uint32_t sectionCount = static_cast<uint32_t>(sizeof(sources) / sizeof(sources[0]));
+
+    // Lay out the whole file first so it can be built in one buffer.
+    SceneFileSection sections[sizeof(sources) / sizeof(sources[0])] = {};
+    uint64_t offset = sizeof(SceneFileHeader) + sectionCount * sizeof(SceneFileSection);
+    for (uint32_t s = 0; s < sectionCount; ++s) {
+        offset = align_up(offset, SCENE_FILE_ALIGNMENT);
+        sections[s].id = sources[s].id;
+        sections[s].elementSize = sources[s].elementSize;
+        sections[s].offset = offset;
+        sections[s].count = sources[s].count;
+        offset += sources[s].count * sources[s].elementSize;
+    }
+    const uint64_t fileSize = offset;
+
+    SceneFileHeader header = {};
+    std::memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_FILE_VERSION;
+    header.endianTag = SCENE_FILE_ENDIAN_TAG;
+    header.headerSize = sizeof(SceneFileHeader);
+    header.sectionCount = sectionCount;
+    header.bodyCount = snapshot.BodyCount();
+    header.primitiveCount = snapshot.PrimitiveCount();
+    header.fileSize = fileSize;
+
+    // Copying the sections and writing them out count as half the work each.
+    const double totalWork = 2.0 * static_cast<double>(fileSize);
+    size_t workDone = 0;
+    auto report = [&](size_t bytes) {
+        workDone += bytes;
+        if (progress) *progress = static_cast<float>(workDone / totalWork);
+    };
+
+    std::vector<char> buffer(fileSize, 0);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    std::memcpy(buffer.data() + sizeof(header), sections, sectionCount * sizeof(SceneFileSection));
+    for (uint32_t s = 0; s < sectionCount; ++s) {
+        size_t bytes = sections[s].count * sections[s].elementSize;
+        if (bytes > 0) std::memcpy(buffer.data() + sections[s].offset, sources[s].data, bytes);
+        report(bytes);
+    }
+
+    const std::string temp_path = filename + ".tmp";
+    std::ofstream outfile(temp_path, std::ios::binary | std::ios::trunc);
+    if (!outfile.is_open()) {
+        error = "could not open " + temp_path + " for writing";
+        return false;
+    }
+    for (size_t written = 0; written < buffer.size() && outfile; ) {
+        size_t chunk = std::min(WRITE_CHUNK_BYTES, buffer.size() - written);
+        outfile.write(buffer.data() + written, static_cast<std::streamsize>(chunk));
+        written += chunk;
+        report(chunk);
+    }
+    outfile.close();
+    if (outfile.fail()) {
+        error = "failed while writing " + temp_path;
+        std::error_code ignored;
+        std::filesystem::remove(temp_path, ignored);
+        return false;
+    }
+
+    std::error_code rename_error;
+    std::filesystem::rename(temp_path, filename, rename_error);
+    if (rename_error) {
+        error = "could not replace " + filename + ": " + rename_error.message();
+        std::filesystem::remove(temp_path, rename_error);
+        return false;
+    }
+    if (progress) *progress = 1.0f;
+    return true;
+}
+
+bool is_binary_scene_file(const std::string& filename) {
+    std::ifstream infile(filename, std::ios::binary);
+    char magic[sizeof(SCENE_FILE_MAGIC)] = {};
+    infile.read(magic, sizeof(magic));
+    return infile.gcount() == sizeof(magic) && std::memcmp(magic, SCENE_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool load_binary_scene(const std::string& filename, std::vector<std::unique_ptr<SceneObject>>& objects, std::string& error) {
+    MappedFile file;
+    if (!file.Open(filename, error)) return false;
+
+    const char* base = file.Data();
+    const uint64_t size = file.Size();
+
+    SceneFileHeader header;
+    if (size < sizeof(header)) {
+        error = "file is too small to be a scene";
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+
+    if (std::memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        error = "not a binary scene file";
+        return false;
+    }
+    if (header.endianTag != SCENE_FILE_ENDIAN_TAG) {
+        error = "scene was written on a host with different byte order";
+        return false;
+    }
+    if (header.version == 0 || header.version > SCENE_FILE_VERSION) {
+        error = "unsupported scene version " + std::to_string(header.version);
+        return false;
+    }
+    // The section table has to fit between the header and the end of the
+    // file; headerSize is checked first so the subtraction cannot wrap.
+    if (header.headerSize < sizeof(header) || header.headerSize > size || header.fileSize != size ||
+        header.sectionCount > (size - header.headerSize) / sizeof(SceneFileSection)) {
+        error = "scene header is corrupt";
+        return false;
+    }
+
+    const SceneFileSection* sections = reinterpret_cast<const SceneFileSection*>(base + header.headerSize);
+    for (uint32_t s = 0; s < header.sectionCount; ++s) {
+        const SceneFileSection& section = sections[s];
+        bool in_bounds = section.offset <= size && section.elementSize > 0 &&
+                         section.count <= (size - section.offset) / section.elementSize;
+        if (!in_bounds || section.offset % 4 != 0) {
+            error = "section " + std::to_string(section.id) + " lies outside the file";
+            return false;
+        }
+    }
+
+    const uint64_t n = header.bodyCount;
+    const uint64_t primitiveCount = header.primitiveCount;
+    const uint32_t sectionCount = header.sectionCount;
+
+    const int32_t* types = find_section<int32_t>(base, sections, sectionCount, SECTION_BODY_TYPE, n, 4, error);
+    const uint32_t* flags = find_section<uint32_t>(base, sections, sectionCount, SECTION_BODY_FLAGS, n, 4, error);
+    const float* masses = find_section<float>(base, sections, sectionCount, SECTION_BODY_MASS, n, 4, error);
+    const float* positions = find_section<float>(base, sections, sectionCount, SECTION_BODY_POSITION, n, 12, error);
+    const float* velocities = find_section<float>(base, sections, sectionCount, SECTION_BODY_VELOCITY, n, 12, error);
+    const float* orientations = find_section<float>(base, sections, sectionCount, SECTION_BODY_ORIENTATION, n, 16, error);
+    const float* angularVelocities = find_section<float>(base, sections, sectionCount, SECTION_BODY_ANGULAR_VELOCITY, n, 12, error);
+    const uint32_t* primitiveRanges = find_section<uint32_t>(base, sections, sectionCount, SECTION_BODY_PRIMITIVES, n, 8, error);
+    const uint32_t* nameOffsets = find_section<uint32_t>(base, sections, sectionCount, SECTION_BODY_NAME_OFFSETS, n + 1, 4, error);
+    const int32_t* primitiveTypes = find_section<int32_t>(base, sections, sectionCount, SECTION_PRIMITIVE_TYPE, primitiveCount, 4, error);
+    const float* primitiveRadii = find_section<float>(base, sections, sectionCount, SECTION_PRIMITIVE_RADII, primitiveCount, 8, error);
+    const uint32_t* primitiveMaterials = find_section<uint32_t>(base, sections, sectionCount, SECTION_PRIMITIVE_MATERIAL, primitiveCount, 4, error);
+
+    // Variable-length tables: look them up by id and take their own counts.
+    const char* nameData = nullptr;
+    uint64_t nameBytes = 0;
+    const SceneFileMaterial* materials = nullptr;
+    uint64_t materialCount = 0;
+    for (uint32_t s = 0; s < sectionCount; ++s) {
+        if (sections[s].id == SECTION_NAME_DATA && sections[s].elementSize == 1) {
+            nameData = base + sections[s].offset;
+            nameBytes = sections[s].count;
+        }
+        else if (sections[s].id == SECTION_MATERIALS && sections[s].elementSize == sizeof(SceneFileMaterial)) {
+            materials = reinterpret_cast<const SceneFileMaterial*>(base + sections[s].offset);
+            materialCount = sections[s].count;
+        }
+    }
+
+    if (!types || !flags || !masses || !positions || !velocities || !orientations || !angularVelocities ||
+        !primitiveRanges || !nameOffsets || !primitiveTypes || !primitiveRadii || !primitiveMaterials) {
+        return false;
+    }
+    if (!nameData || !materials) {
+        error = "missing name or material table";
+        return false;
+    }
+
+    // Validate every index before building anything, so a bad file leaves the caller untouched.
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t first = primitiveRanges[2 * i];
+        uint64_t count = primitiveRanges[2 * i + 1];
+        if (types[i] < 0 || types[i] > MAX_OBJECT_TYPE || count == 0 || first + count > primitiveCount ||
+            nameOffsets[i] > nameOffsets[i + 1] || nameOffsets[i + 1] > nameBytes) {
+            error = "body " + std::to_string(i) + " is corrupt";
+            return false;
+        }
+    }
+    for (uint64_t p = 0; p < primitiveCount; ++p) {
+        if (primitiveMaterials[p] >= materialCount) {
+            error = "primitive " + std::to_string(p) + " references a missing material";
+            return false;
+        }
+    }
+
+    std::vector<GPUmaterial> materialTable(materialCount);
+    for (uint64_t m = 0; m < materialCount; ++m) {
+        materialTable[m] = from_file_material(materials[m]);
+    }
+
+    std::vector<std::unique_ptr<SceneObject>> loaded;
+    loaded.reserve(n);
+
+    for (uint64_t i = 0; i < n; ++i) {
+        auto new_scene_object = std::make_unique<SceneObject>(static_cast<ObjectType>(types[i]), vec3(0.0f), 0.0f);
+        SceneObject& sceneObj = *new_scene_object;
+
+        sceneObj.Name.assign(nameData + nameOffsets[i], nameData + nameOffsets[i + 1]);
+        sceneObj.hasRings = (flags[i] & SCENE_BODY_FLAG_RINGS) != 0;
+        sceneObj.TrailEnabled = (flags[i] & SCENE_BODY_FLAG_TRAIL) != 0;
+        sceneObj.Mass = masses[i];
+        sceneObj.velocity = vec3(velocities[3 * i], velocities[3 * i + 1], velocities[3 * i + 2]);
+        sceneObj.Orientation = vec4(orientations[4 * i], orientations[4 * i + 1], orientations[4 * i + 2], orientations[4 * i + 3]);
+        sceneObj.AngularVelocity = vec3(angularVelocities[3 * i], angularVelocities[3 * i + 1], angularVelocities[3 * i + 2]);
+
+        const vec3 center(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+        const uint32_t first = primitiveRanges[2 * i];
+        const uint32_t count = primitiveRanges[2 * i + 1];
+
+        sceneObj.gpuObjects.resize(count);
+        for (uint32_t k = 0; k < count; ++k) {
+            GPUobject& gpuObj = sceneObj.gpuObjects[k];
+            const uint32_t p = first + k;
+            gpuObj.m = materialTable[primitiveMaterials[p]];
+            gpuObj.rot_quat = sceneObj.Orientation;
+            gpuObj.center = center;
+            gpuObj.r1 = primitiveRadii[2 * p];
+            gpuObj.r2 = primitiveRadii[2 * p + 1];
+            gpuObj.type = primitiveTypes[p];
+        }
+
+        loaded.push_back(std::move(new_scene_object));
+    }
+
+    objects = std::move(loaded);
+    return true;
+}
+
+SceneSaver::~SceneSaver() {
+    // Let an in-flight save finish rather than leave a stray temp file.
+    if (worker.joinable()) worker.join();
+}
+
+bool SceneSaver::Start(const std::string& path, SceneSnapshot&& snapshot) {
+    if (running) return false;
+    if (worker.joinable()) worker.join();
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        pendingSnapshot = std::move(snapshot);
+        savePath = path;
+        saveError.clear();
+    }
+    progress = 0.0f;
+    finished = false;
+    running = true;
+    worker = std::thread(&SceneSaver::Run, this);
+    return true;
+}
+
+std::string SceneSaver::GetPath() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return savePath;
+}
+
+bool SceneSaver::PollFinished(std::string& path, std::string& error) {
+    if (!finished.exchange(false)) return false;
+    if (worker.joinable()) worker.join();
+
+    std::lock_guard<std::mutex> lock(stateMutex);
+    path = savePath;
+    error = saveError;
+    return true;
+}
+
+void SceneSaver::Run() {
+    SceneSnapshot snapshot;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        snapshot = std::move(pendingSnapshot);
+        path = savePath;
+    }
+
+    std::string error;
+    write_scene_snapshot(path, snapshot, error, &progress);
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        saveError = error;
+    }
+    finished = true;
+    running = false;
+}
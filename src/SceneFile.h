@@ -0,0 +1,140 @@
+#pragma once
+
+#include "SceneObject.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Versioned binary scene format (.sceneb).
+//
+//   [SceneFileHeader][SceneFileSection x sectionCount][section payloads...]
+//
+// Every payload starts on a 64-byte boundary and holds one tightly packed array
+// (structure of arrays over bodies / primitives), so a loader can read the
+// fields straight out of a mapped file. Unknown sections are skipped, which
+// lets newer writers add data without breaking older readers.
+
+const uint32_t SCENE_FILE_VERSION = 1;
+const uint32_t SCENE_FILE_ALIGNMENT = 64;
+
+enum SceneSectionId : uint32_t {
+    SECTION_BODY_TYPE = 1,            // int32 per body
+    SECTION_BODY_FLAGS,               // uint32 per body, see SCENE_BODY_FLAG_*
+    SECTION_BODY_MASS,                // float per body
+    SECTION_BODY_POSITION,            // float[3] per body
+    SECTION_BODY_VELOCITY,            // float[3] per body
+    SECTION_BODY_ORIENTATION,         // float[4] per body
+    SECTION_BODY_ANGULAR_VELOCITY,    // float[3] per body
+    SECTION_BODY_PRIMITIVES,          // uint32[2] (first, count) per body
+    SECTION_BODY_NAME_OFFSETS,        // uint32 per body + 1, into SECTION_NAME_DATA
+    SECTION_NAME_DATA,                // UTF-8 bytes, not terminated
+    SECTION_PRIMITIVE_TYPE,           // int32 per primitive
+    SECTION_PRIMITIVE_RADII,          // float[2] (r1, r2) per primitive
+    SECTION_PRIMITIVE_MATERIAL,       // uint32 index into SECTION_MATERIALS
+    SECTION_MATERIALS,                // SceneFileMaterial per unique material
+};
+
+const uint32_t SCENE_BODY_FLAG_RINGS = 1u << 0;
+const uint32_t SCENE_BODY_FLAG_TRAIL = 1u << 1;
+
+struct SceneFileHeader {
+    char magic[8];          // "SCENEBIN"
+    uint32_t version;
+    uint32_t endianTag;     // 0x01020304 as written by the host
+    uint32_t headerSize;
+    uint32_t sectionCount;
+    uint64_t bodyCount;
+    uint64_t primitiveCount;
+    uint64_t fileSize;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(SceneFileHeader) == 64, "SceneFileHeader must stay 64 bytes");
+
+struct SceneFileSection {
+    uint32_t id;
+    uint32_t elementSize;
+    uint64_t offset;
+    uint64_t count;
+    uint64_t reserved;
+};
+static_assert(sizeof(SceneFileSection) == 32, "SceneFileSection must stay 32 bytes");
+
+struct SceneFileMaterial {
+    float albedo[3];
+    float emission;
+    float metallic;
+    float roughness;
+    int32_t textureID;
+    uint32_t reserved;
+};
+static_assert(sizeof(SceneFileMaterial) == 32, "SceneFileMaterial must stay 32 bytes");
+
+// Plain copy of everything a save needs, laid out exactly like the file
+// sections. Capturing one is a flat copy; serializing it needs no scene access.
+struct SceneSnapshot {
+    std::vector<int32_t> types;
+    std::vector<uint32_t> flags;
+    std::vector<float> masses;
+    std::vector<float> positions;
+    std::vector<float> velocities;
+    std::vector<float> orientations;
+    std::vector<float> angularVelocities;
+    std::vector<uint32_t> primitiveRanges;
+    std::vector<uint32_t> nameOffsets;
+    std::vector<char> nameData;
+
+    std::vector<int32_t> primitiveTypes;
+    std::vector<float> primitiveRadii;
+    std::vector<uint32_t> primitiveMaterials;
+    std::vector<SceneFileMaterial> materials;
+
+    size_t BodyCount() const { return types.size(); }
+    size_t PrimitiveCount() const { return primitiveTypes.size(); }
+};
+
+void capture_scene_snapshot(const std::vector<std::unique_ptr<SceneObject>>& objects, SceneSnapshot& snapshot);
+
+// Serializes into one buffer, streams it to filename + ".tmp" and renames it
+// over filename, so an interrupted save never leaves a truncated scene behind.
+// progress (optional) is advanced from 0 to 1.
+bool write_scene_snapshot(const std::string& filename, const SceneSnapshot& snapshot, std::string& error,
+                          std::atomic<float>* progress = nullptr);
+
+bool is_binary_scene_file(const std::string& filename);
+bool load_binary_scene(const std::string& filename, std::vector<std::unique_ptr<SceneObject>>& objects, std::string& error);
+
+// Writes snapshots on a background thread. The main thread captures the scene,
+// hands the snapshot over with Start() and polls for completion each frame.
+class SceneSaver {
+public:
+    SceneSaver() = default;
+    ~SceneSaver();
+
+    // Returns false while another save is still in flight.
+    bool Start(const std::string& path, SceneSnapshot&& snapshot);
+
+    bool IsRunning() const { return running; }
+    float GetProgress() const { return progress; }
+    std::string GetPath();
+
+    // Returns true once per finished save; error is left empty on success.
+    bool PollFinished(std::string& path, std::string& error);
+
+private:
+    void Run();
+
+    std::thread worker;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> finished{ false };
+    std::atomic<float> progress{ 0.0f };
+
+    std::mutex stateMutex;
+    SceneSnapshot pendingSnapshot;
+    std::string savePath;
+    std::string saveError;
+};
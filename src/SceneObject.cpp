@@ -1,5 +1,6 @@
 #include "SceneObject.h"
 #include <iostream>
+#include <algorithm>
 
 
 SceneObject::SceneObject(ObjectType type, vec3 initial_position, float mass)
@@ -7,6 +8,7 @@ SceneObject::SceneObject(ObjectType type, vec3 initial_position, float mass)
       Orientation(0.0f, 0.0f, 0.0f, 1.0f),
       AngularVelocity(vec3(0.0f, 0.15f, 0.0f)) {
 
+    gpuObjects.reserve(2); // body and disk/rings; type transitions reuse the storage
     SetupAs(type);
     
     if (mass > 0.0f) {
@@ -19,8 +21,6 @@ SceneObject::SceneObject(ObjectType type, vec3 initial_position, float mass)
 SceneObject::~SceneObject() {}
 
 void SceneObject::Update(float dt) {
-    CheckForTypeTransition();
-
     vec3 displacement = velocity * dt;
     SetPosition(GetPosition() + displacement);
 
@@ -61,152 +61,198 @@ void SceneObject::ResetRotation() {
     Orientation = vec4(0.0f, 0.0f, 0.0f, 1.0f);
 }
 
+namespace {
+
+const float MASS_LIMIT_ROCKY_TO_GIANT = 50.0f;
+const float MASS_LIMIT_GIANT_TO_DWARF = 200.0f; // Approx. 13 Jupiter masses
+const float MASS_LIMIT_DWARF_TO_STAR  = 600.0f; // Approx. 80 Jupiter masses
+const float SCHWARZSCHILD_FACTOR      = 0.005f; // Artistic value for collapse
+
+const char* type_name(ObjectType type) {
+    switch (type) {
+        case ObjectType::Star:        return "Star";
+        case ObjectType::BrownDwarf:  return "Brown Dwarf";
+        case ObjectType::GasGiant:    return "Gas Giant";
+        case ObjectType::RockyPlanet: return "Rocky Planet";
+        case ObjectType::BlackHole:   return "Black Hole";
+    }
+    return "Object";
+}
+
+float default_radius(ObjectType type) {
+    switch (type) {
+        case ObjectType::Star:        return 8.0f;
+        case ObjectType::BrownDwarf:  return 4.0f;
+        case ObjectType::GasGiant:    return 1.5f;
+        case ObjectType::RockyPlanet: return 0.5f;
+        case ObjectType::BlackHole:   return 0.5f;
+    }
+    return 1.0f;
+}
+
+// One step along the mass ladder, or a collapse once the body fits inside its
+// Schwarzschild radius.
+ObjectType next_type(ObjectType type, float mass, float radius) {
+    if (type != ObjectType::BlackHole && radius < mass * SCHWARZSCHILD_FACTOR) return ObjectType::BlackHole;
+
+    switch (type) {
+        case ObjectType::Star:
+            if (mass < MASS_LIMIT_DWARF_TO_STAR) return ObjectType::BrownDwarf;
+            break;
+        case ObjectType::BrownDwarf:
+            if (mass > MASS_LIMIT_DWARF_TO_STAR) return ObjectType::Star;
+            if (mass < MASS_LIMIT_GIANT_TO_DWARF) return ObjectType::GasGiant;
+            break;
+        case ObjectType::GasGiant:
+            if (mass > MASS_LIMIT_GIANT_TO_DWARF) return ObjectType::BrownDwarf;
+            if (mass < MASS_LIMIT_ROCKY_TO_GIANT) return ObjectType::RockyPlanet;
+            break;
+        case ObjectType::RockyPlanet:
+            if (mass > MASS_LIMIT_ROCKY_TO_GIANT) return ObjectType::GasGiant;
+            break;
+        case ObjectType::BlackHole:
+            break;
+    }
+    return type;
+}
+
+} // namespace
+
 void SceneObject::SetupAs(ObjectType newType) {
+    ApplyTypeAppearance(newType);
+    Name = type_name(newType);
+
+    switch (newType) {
+        case ObjectType::Star:        Mass = 800.0f; break;
+        case ObjectType::BrownDwarf:  Mass = 250.0f; break;
+        case ObjectType::GasGiant:    Mass = 80.0f;  break;
+        case ObjectType::RockyPlanet: Mass = 1.0f;   break;
+        case ObjectType::BlackHole:   break;
+    }
+}
+
+// Rewrites the primitives for newType over the existing ones. Every body has
+// room for two primitives from construction, so this never allocates.
+void SceneObject::ApplyTypeAppearance(ObjectType newType) {
     this->Type = newType;
     vec3 currentPos = GetPosition();
-    vec4 currentRot = Orientation;
 
-    gpuObjects.clear(); 
+    if (newType == ObjectType::Star || newType == ObjectType::BrownDwarf) hasRings = false;
+    if (newType == ObjectType::BlackHole) hasRings = true;
+    gpuObjects.resize(hasRings ? 2 : 1);
+    for (auto& gpu_obj : gpuObjects) gpu_obj = GPUobject();
+
+    GPUobject& body = GetGpuObject(0);
+    body.r1 = default_radius(newType);
 
     switch (newType) {
         case ObjectType::Star:
-            Name = "Star";
-            hasRings = false;
-            gpuObjects.resize(1);
-            GetGpuObject(0).r1 = 8.0f; // Stars are large.
-            GetGpuObject(0).m.albedo = vec3(1.0, 0.8, 0.5);
-            GetGpuObject(0).m.emission = 1000.0f; // Sustained fusion is very bright.
-            Mass = 800.0f;
+            body.m.albedo = vec3(1.0, 0.8, 0.5);
+            body.m.emission = 1000.0f; // Sustained fusion is very bright.
             break;
 
         case ObjectType::BrownDwarf:
-            Name = "Brown Dwarf";
-            hasRings = false;
-            gpuObjects.resize(1);
-            GetGpuObject(0).r1 = 4.0f; 
-            GetGpuObject(0).m.albedo = vec3(0.4, 0.15, 0.1); // Dim, deep red glow.
-            GetGpuObject(0).m.emission = 7.0f; // Glows faintly.
-            Mass = 250.0f;
+            body.m.albedo = vec3(0.4, 0.15, 0.1); // Dim, deep red glow.
+            body.m.emission = 7.0f; // Glows faintly.
             break;
 
         case ObjectType::GasGiant:
-            Name = "Gas Giant";
-            gpuObjects.resize(hasRings ? 2 : 1);
-            GetGpuObject(0).r1 = 1.5f;
-            GetGpuObject(0).m.albedo = vec3(0.8, 0.7, 0.6);
-            GetGpuObject(0).m.emission = 0.0f; 
-            Mass = 80.0f;
+            body.m.albedo = vec3(0.8, 0.7, 0.6);
             if (hasRings) {
                 GetGpuObject(1).type = 1; 
-                GetGpuObject(1).r1 = GetGpuObject(0).r1 * 2.0f;
-                GetGpuObject(1).r2 = GetGpuObject(0).r1 * 1.2f;
+                GetGpuObject(1).r1 = body.r1 * 2.0f;
+                GetGpuObject(1).r2 = body.r1 * 1.2f;
                 GetGpuObject(1).m.albedo = vec3(0.6f);
             }
             break;
             
         case ObjectType::RockyPlanet:
-            Name = "Rocky Planet";
-            gpuObjects.resize(hasRings ? 2 : 1);
-            GetGpuObject(0).r1 = 0.5f;
-            GetGpuObject(0).m.albedo = vec3(0.5, 0.6, 0.8);
-            GetGpuObject(0).m.emission = 0.0f;
-            Mass = 1.0f;
+            body.m.albedo = vec3(0.5, 0.6, 0.8);
             if (hasRings) {
                  GetGpuObject(1).type = 1;
-                 GetGpuObject(1).r1 = GetGpuObject(0).r1 * 2.5f;
-                 GetGpuObject(1).r2 = GetGpuObject(0).r1 * 1.5f;
+                 GetGpuObject(1).r1 = body.r1 * 2.5f;
+                 GetGpuObject(1).r2 = body.r1 * 1.5f;
                  GetGpuObject(1).m.albedo = vec3(0.7f);
             }
             break;
 
-        case ObjectType::BlackHole:
-            Name = "Black Hole";
-            hasRings = true; 
-            gpuObjects.resize(2);
-            GetGpuObject(0).r1 = 0.5f; 
-            GetGpuObject(0).m.albedo = vec3(0.0f);
-            GetGpuObject(0).m.emission = 0.0f;
+        case ObjectType::BlackHole: {
+            body.m.albedo = vec3(0.0f);
             GPUobject& disk = GetGpuObject(1);
             disk.type = 1;
-            disk.r1 = GetGpuObject(0).r1 * 10.0f;
-            disk.r2 = GetGpuObject(0).r1 * 1.5f;
+            disk.r1 = body.r1 * 10.0f;
+            disk.r2 = body.r1 * 1.5f;
             disk.m.albedo = vec3(1.0, 0.8, 0.3);
             disk.m.emission = 500.0f;
             break;
+        }
     }
 
     SetPosition(currentPos);
-    Orientation = currentRot;
     for(auto& gpu_obj : gpuObjects) {
         gpu_obj.rot_quat = Orientation;
     }
 }
 
-void SceneObject::CheckForTypeTransition() {
+bool SceneObject::CheckForTypeTransition(TypeTransitionEvent& event) const {
+    if (gpuObjects.empty()) return false;
+
+    // Follow the ladder to the type the current mass settles on; each rung
+    // starts from that type's radius, as the body will after the transition.
+    ObjectType type = Type;
+    float radius = GetGpuObject(0).r1;
+    for (int rung = 0; rung < 5; ++rung) {
+        ObjectType next = next_type(type, Mass, radius);
+        if (next == type) break;
+        type = next;
+        radius = default_radius(type);
+    }
+    if (type == Type) return false;
+
+    event.object = const_cast<SceneObject*>(this);
+    event.from = Type;
+    event.to = type;
+    return true;
+}
 
-    const float MASS_LIMIT_ROCKY_TO_GIANT = 50.0f;
-    const float MASS_LIMIT_GIANT_TO_DWARF = 200.0f; // Approx. 13 Jupiter masses
-    const float MASS_LIMIT_DWARF_TO_STAR  = 600.0f; // Approx. 80 Jupiter masses
-    const float SCHWARZSCHILD_FACTOR      = 0.005f; // Artistic value for collapse
+// Mass, motion and orientation carry over; only the appearance and radius
+// change. Bodies that still carry their old type's default name are renamed.
+void SceneObject::ApplyTypeTransition(const TypeTransitionEvent& event) {
+    if (event.to == Type) return;
+    bool defaultName = Name == type_name(Type);
 
-    ObjectType currentType = this->Type;
-    float currentRadius = GetGpuObject(0).r1;
-    float schwarzschildRadius = this->Mass * SCHWARZSCHILD_FACTOR;
+    ApplyTypeAppearance(event.to);
+    if (defaultName) Name = type_name(event.to);
 
-    if (currentType != ObjectType::BlackHole && currentRadius < schwarzschildRadius) {
-        std::cout << "Object '" << Name << "' collapsed into a Black Hole!" << std::endl;
-        float collapsingMass = this->Mass;
-        SetupAs(ObjectType::BlackHole);
-        this->Mass = collapsingMass;
+    if (event.to == ObjectType::BlackHole) {
+        float schwarzschildRadius = Mass * SCHWARZSCHILD_FACTOR;
         GPUobject& sphere = GetGpuObject(0);
         sphere.r1 = schwarzschildRadius;
         sphere.m.roughness = 0.0f;
         GPUobject& disk = GetGpuObject(1);
         disk.r1 = schwarzschildRadius * 4.0f; 
         disk.r2 = schwarzschildRadius * 1.5f;
-        return; 
     }
+}
 
-    switch (currentType) {
-        case ObjectType::Star:
-            if (this->Mass < MASS_LIMIT_DWARF_TO_STAR) {
-                std::cout << "Star '" << Name << "' lost mass and became a Brown Dwarf." << std::endl;
-                SetupAs(ObjectType::BrownDwarf);
-            }
-            break;
-
-        case ObjectType::BrownDwarf:
-            if (this->Mass > MASS_LIMIT_DWARF_TO_STAR) {
-                std::cout << "Brown Dwarf '" << Name << "' gained enough mass to ignite as a Star!" << std::endl;
-                SetupAs(ObjectType::Star);
-            }
-            else if (this->Mass < MASS_LIMIT_GIANT_TO_DWARF) {
-                std::cout << "Brown Dwarf '" << Name << "' cooled into a Gas Giant." << std::endl;
-                SetupAs(ObjectType::GasGiant);
-            }
-            break;
-
-        case ObjectType::GasGiant:
-            if (this->Mass > MASS_LIMIT_GIANT_TO_DWARF) {
-                std::cout << "Gas Giant '" << Name << "' became a Brown Dwarf." << std::endl;
-                SetupAs(ObjectType::BrownDwarf);
-            }
-            else if (this->Mass < MASS_LIMIT_ROCKY_TO_GIANT) {
-                std::cout << "Gas Giant '" << Name << "' lost its atmosphere, revealing a Rocky Planet." << std::endl;
-                SetupAs(ObjectType::RockyPlanet);
-            }
-            break;
+std::string describe_type_transition(const TypeTransitionEvent& event) {
+    // A default name was swapped for the new type's; report the old one.
+    std::string name = event.object->Name == type_name(event.to) ? type_name(event.from) : event.object->Name;
+    std::string quoted = "'" + name + "'";
+    std::string from = type_name(event.from);
 
-        case ObjectType::RockyPlanet:
-            if (this->Mass > MASS_LIMIT_ROCKY_TO_GIANT) {
-                std::cout << "Rocky Planet '" << Name << "' accreted an atmosphere and became a Gas Giant." << std::endl;
-                SetupAs(ObjectType::GasGiant);
-            }
-            break;
-            
-        case ObjectType::BlackHole:
-            break;
-    }
+    if (event.to == ObjectType::BlackHole) return "Object " + quoted + " collapsed into a Black Hole!";
+    if (event.from == ObjectType::Star && event.to == ObjectType::BrownDwarf)
+        return from + " " + quoted + " lost mass and became a Brown Dwarf.";
+    if (event.from == ObjectType::BrownDwarf && event.to == ObjectType::Star)
+        return from + " " + quoted + " gained enough mass to ignite as a Star!";
+    if (event.from == ObjectType::BrownDwarf && event.to == ObjectType::GasGiant)
+        return from + " " + quoted + " cooled into a Gas Giant.";
+    if (event.from == ObjectType::GasGiant && event.to == ObjectType::RockyPlanet)
+        return from + " " + quoted + " lost its atmosphere, revealing a Rocky Planet.";
+    if (event.from == ObjectType::RockyPlanet && event.to == ObjectType::GasGiant)
+        return from + " " + quoted + " accreted an atmosphere and became a Gas Giant.";
+    return from + " " + quoted + " became a " + type_name(event.to) + ".";
 }
 
 size_t SceneObject::GetGpuObjectCount() const {
@@ -221,3 +267,18 @@ GPUobject& SceneObject::GetGpuObject(size_t index) {
     return gpuObjects.at(index);
 }
 
+
+void TrailHistory::push_front(const vec3& point) {
+    if (count == points.size()) {
+        // Grow and unwrap so the newest point ends up at index 0 again.
+        std::vector<vec3> grown(std::max<size_t>(16, points.size() * 2));
+        for (size_t i = 0; i < count; ++i) {
+            grown[i] = (*this)[i];
+        }
+        points.swap(grown);
+        head = 0;
+    }
+    head = (head + points.size() - 1) % points.size();
+    points[head] = point;
+    ++count;
+}
@@ -1,9 +1,9 @@
 #pragma once
 
 #include "UBOstructs.h"
+#include "SlotMap.h"
 #include <vector>
 #include <string>
-#include <deque>
 
 enum class ObjectType {
     Star,
@@ -13,6 +13,36 @@ enum class ObjectType {
     BlackHole
 };
 
+// Newest-first ring buffer of trail points with the subset of the std::deque
+// interface the trail code uses. It allocates nothing until the first point is
+// pushed, so bodies without trails stay cheap to create in large scenes.
+class TrailHistory {
+public:
+    void push_front(const vec3& point);
+    void pop_back() { if (count > 0) --count; }
+    void clear() { head = 0; count = 0; }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const vec3& operator[](size_t index) const { return points[(head + index) % points.size()]; }
+
+private:
+    std::vector<vec3> points;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+class SceneObject;
+
+// A body whose mass crossed a type threshold. Raised by CheckForTypeTransition
+// when mass changes (merges, edits) and applied later, typically in a batch at
+// the end of a physics step.
+struct TypeTransitionEvent {
+    SceneObject* object = nullptr;
+    ObjectType from = ObjectType::RockyPlanet;
+    ObjectType to = ObjectType::RockyPlanet;
+};
+
 vec4 quat_mult(vec4 q1, vec4 q2);
 vec4 quat_from_axis_angle(vec3 axis, float angle_rad);
 
@@ -29,13 +59,18 @@ public:
     void ApplyForce(const vec3& force, float dt);
     void ResetRotation();
     void SetupAs(ObjectType newType); 
-    void CheckForTypeTransition();
+
+    // Only needs calling when Mass changed. Returns true and fills event if the
+    // body should now be of another type; the body itself is left untouched.
+    bool CheckForTypeTransition(TypeTransitionEvent& event) const;
+    void ApplyTypeTransition(const TypeTransitionEvent& event);
 
 
     size_t GetGpuObjectCount() const;
     const GPUobject& GetGpuObject(size_t index) const;
     GPUobject& GetGpuObject(size_t index); // Non-const version for ImGui to modify
 
+    ObjectHandle Handle; // set by the owning scene; invalid for free-standing copies
     std::string Name;
     ObjectType Type;
     float Mass;
@@ -45,8 +80,14 @@ public:
     bool hasRings = false;
 
     int MaxTrailPoints = 500;
+    bool TrailEnabled = true;
 
-    std::deque<vec3> TrailPoints;
+    TrailHistory TrailPoints;
     std::vector<GPUobject> gpuObjects;
 
+private:
+    void ApplyTypeAppearance(ObjectType newType);
 };
+
+// Log line for a transition that has been applied to event.object.
+std::string describe_type_transition(const TypeTransitionEvent& event);
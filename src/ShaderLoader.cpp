@@ -0,0 +1,94 @@
+#include "ShaderLoader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+bool read_file(const std::string& path, std::string& contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+std::string describe(const std::vector<std::string>& files) {
+    std::string names;
+    for (const std::string& file : files) {
+        if (!names.empty()) names += " + ";
+        names += file;
+    }
+    return names;
+}
+
+} // namespace
+
+GLuint compile_shader_stage(GLenum type, const std::vector<std::string>& files, const std::string& preamble) {
+    // A #line in front of each file makes the log report lines within that
+    // file, with its position in files as the source string number.
+    std::vector<std::string> sources;
+    if (!preamble.empty()) sources.push_back(preamble);
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string contents;
+        if (!read_file(files[i], contents)) {
+            std::cerr << "Failed to read " << files[i] << std::endl;
+            return 0;
+        }
+        if (!preamble.empty() || i > 0) sources.push_back("#line 1 " + std::to_string(i) + "\n");
+        sources.push_back(contents);
+    }
+
+    std::vector<const GLchar*> strings;
+    for (const std::string& source : sources) strings.push_back(source.c_str());
+
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, static_cast<GLsizei>(strings.size()), strings.data(), nullptr);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        GLint logSize = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logSize);
+        std::string log(std::max(logSize, 1), '\0');
+        glGetShaderInfoLog(shader, logSize, nullptr, &log[0]);
+        std::cerr << describe(files) << " failed to compile:" << std::endl;
+        std::cerr << log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+GLuint link_shader_program(const std::vector<GLuint>& stages) {
+    bool complete = true;
+    for (GLuint stage : stages) complete = complete && stage != 0;
+
+    GLuint program = 0;
+    if (complete) {
+        program = glCreateProgram();
+        for (GLuint stage : stages) glAttachShader(program, stage);
+        glLinkProgram(program);
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            GLint logSize = 0;
+            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logSize);
+            std::string log(std::max(logSize, 1), '\0');
+            glGetProgramInfoLog(program, logSize, nullptr, &log[0]);
+            std::cerr << "Shader program failed to link:" << std::endl << log << std::endl;
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    for (GLuint stage : stages) {
+        if (stage != 0) glDeleteShader(stage);
+    }
+    return program;
+}
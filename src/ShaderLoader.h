@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Angel.h"
+
+#include <string>
+#include <vector>
+
+// GLSL version line for stages assembled from shared files, which carry none
+// of their own.
+const char* const GLSL_VERSION_LINE = "#version 460\n";
+
+// Compiles one shader stage from several files, in order, after preamble
+// (a #version line plus any #defines, or empty if the first file has its own).
+// This is how the path tracer stages share path_tracer_common.glsl. Prints the
+// compile log and returns 0 on failure.
+GLuint compile_shader_stage(GLenum type, const std::vector<std::string>& files, const std::string& preamble = "");
+
+// Links the stages into a program and deletes them. Returns 0, after printing
+// the log, if any stage is 0 or linking fails.
+GLuint link_shader_program(const std::vector<GLuint>& stages);
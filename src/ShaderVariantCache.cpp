@@ -0,0 +1,58 @@
+#include "ShaderVariantCache.h"
+
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+// 64-bit FNV-1a.
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t fnv1a(uint64_t hash, const std::string& bytes) {
+    for (unsigned char byte : bytes) {
+        hash ^= byte;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+} // namespace
+
+ShaderVariantCache::~ShaderVariantCache() {
+    Release();
+}
+
+uint64_t ShaderVariantCache::Hash(const std::string& name, const std::string& defines) {
+    // The separator keeps ("ab", "c") and ("a", "bc") apart.
+    return fnv1a(fnv1a(fnv1a(FNV_OFFSET_BASIS, name), std::string(1, '\0')), defines);
+}
+
+GLuint ShaderVariantCache::Get(const std::string& name, const std::string& defines, const std::function<GLuint()>& build) {
+    uint64_t key = Hash(name, defines);
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+        if (found->second.name == name && found->second.defines == defines) return found->second.program;
+        std::cerr << "Shader variant hash collision between " << name << " and " << found->second.name << "." << std::endl;
+        return 0;
+    }
+
+    Entry& entry = entries[key];
+    entry.name = name;
+    entry.defines = defines;
+    entry.program = build();
+    // The compiler or linker log has already gone to std::cerr; this names
+    // the variant it belongs to.
+    if (entry.program == 0) {
+        std::cerr << "Failed to build shader variant " << name << " [" << std::hex << std::setw(16) << std::setfill('0')
+                  << key << std::dec << std::setfill(' ') << "] with defines:" << std::endl << defines << std::endl;
+    }
+    return entry.program;
+}
+
+void ShaderVariantCache::Release() {
+    for (auto& item : entries) {
+        if (item.second.program != 0) glDeleteProgram(item.second.program);
+    }
+    entries.clear();
+}
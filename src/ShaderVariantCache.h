@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Angel.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+// Programs built from the same sources under different sets of #defines,
+// keyed by a 64-bit hash of the program's name and its defines. A variant is
+// compiled the first time it is asked for, on the calling thread (which needs
+// the GL context), so that frame stalls once; going back to it later is a
+// lookup. Failed builds are remembered as well, so a variant that does not
+// compile is not retried every frame. The cache owns every program it returns.
+class ShaderVariantCache {
+public:
+    ShaderVariantCache() = default;
+    ~ShaderVariantCache();
+
+    ShaderVariantCache(const ShaderVariantCache&) = delete;
+    ShaderVariantCache& operator=(const ShaderVariantCache&) = delete;
+
+    // The program for name under defines, calling build (which returns 0 on
+    // failure) if it is not cached yet. Returns 0 if the variant failed.
+    GLuint Get(const std::string& name, const std::string& defines, const std::function<GLuint()>& build);
+
+    // Deletes every program handed out.
+    void Release();
+
+    size_t GetVariantCount() const { return entries.size(); }
+
+    static uint64_t Hash(const std::string& name, const std::string& defines);
+
+private:
+    struct Entry {
+        std::string name;
+        std::string defines;
+        GLuint program = 0;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Stable reference to an element of a SlotMap. The slot index never changes
+// while the element lives; the generation tells a handle to a removed element
+// apart from one to whatever reuses its slot later.
+struct ObjectHandle {
+    static const uint32_t INVALID_INDEX = 0xffffffffu;
+
+    uint32_t index = INVALID_INDEX;
+    uint32_t generation = 0;
+
+    bool IsValid() const { return index != INVALID_INDEX; }
+    bool operator==(const ObjectHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const ObjectHandle& other) const { return !(*this == other); }
+};
+
+// Elements live densely in one vector (in no particular order) so iteration and
+// bulk consumers such as the physics step see a plain array; handles map to
+// dense positions through a slot table. Insert and Remove are O(1): removal
+// moves the last element into the hole.
+template <typename T>
+class SlotMap {
+public:
+    static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    ObjectHandle Insert(T value) {
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            slot = static_cast<uint32_t>(slots.size());
+            slots.push_back(Slot());
+        }
+        slots[slot].denseIndex = static_cast<uint32_t>(dense.size());
+        dense.push_back(std::move(value));
+        denseToSlot.push_back(slot);
+        return ObjectHandle{ slot, slots[slot].generation };
+    }
+
+    bool Remove(ObjectHandle handle) {
+        size_t index = DenseIndex(handle);
+        if (index == NOT_FOUND) return false;
+
+        size_t last = dense.size() - 1;
+        if (index != last) {
+            dense[index] = std::move(dense[last]);
+            denseToSlot[index] = denseToSlot[last];
+            slots[denseToSlot[index]].denseIndex = static_cast<uint32_t>(index);
+        }
+        dense.pop_back();
+        denseToSlot.pop_back();
+        Release(handle.index);
+        return true;
+    }
+
+    // Every outstanding handle becomes stale; slots are kept for reuse.
+    void Clear() {
+        for (uint32_t slot : denseToSlot) Release(slot);
+        dense.clear();
+        denseToSlot.clear();
+    }
+
+    void Reserve(size_t count) {
+        dense.reserve(count);
+        denseToSlot.reserve(count);
+    }
+
+    bool Contains(ObjectHandle handle) const { return DenseIndex(handle) != NOT_FOUND; }
+
+    size_t DenseIndex(ObjectHandle handle) const {
+        if (handle.index >= slots.size()) return NOT_FOUND;
+        const Slot& slot = slots[handle.index];
+        if (slot.generation != handle.generation || slot.denseIndex == FREE) return NOT_FOUND;
+        return slot.denseIndex;
+    }
+
+    T* Get(ObjectHandle handle) {
+        size_t index = DenseIndex(handle);
+        return index == NOT_FOUND ? nullptr : &dense[index];
+    }
+    const T* Get(ObjectHandle handle) const {
+        size_t index = DenseIndex(handle);
+        return index == NOT_FOUND ? nullptr : &dense[index];
+    }
+
+    ObjectHandle HandleAt(size_t denseIndex) const {
+        uint32_t slot = denseToSlot[denseIndex];
+        return ObjectHandle{ slot, slots[slot].generation };
+    }
+
+    // Upper bound on handle indices, for per-slot side tables.
+    size_t SlotCount() const { return slots.size(); }
+
+    // The dense storage itself. Others may erase elements from it in place as
+    // long as the survivors keep their order and Resync runs afterwards.
+    std::vector<T>& Dense() { return dense; }
+    const std::vector<T>& Dense() const { return dense; }
+
+    // Rebuilds the slot table after Dense() was compacted elsewhere (e.g. by
+    // merges in the physics step). handleOf reads an element's handle back;
+    // onRemoved is called with the handle of every element that disappeared.
+    template <typename HandleOf, typename OnRemoved>
+    void Resync(HandleOf handleOf, OnRemoved onRemoved) {
+        for (uint32_t slot : denseToSlot) slots[slot].denseIndex = FREE;
+
+        std::vector<uint32_t> previous;
+        previous.swap(denseToSlot);
+        denseToSlot.resize(dense.size());
+        for (size_t i = 0; i < dense.size(); ++i) {
+            uint32_t slot = handleOf(dense[i]).index;
+            slots[slot].denseIndex = static_cast<uint32_t>(i);
+            denseToSlot[i] = slot;
+        }
+
+        for (uint32_t slot : previous) {
+            if (slots[slot].denseIndex != FREE) continue;
+            ObjectHandle gone{ slot, slots[slot].generation };
+            Release(slot);
+            onRemoved(gone);
+        }
+    }
+
+    size_t size() const { return dense.size(); }
+    bool empty() const { return dense.empty(); }
+    T& operator[](size_t denseIndex) { return dense[denseIndex]; }
+    const T& operator[](size_t denseIndex) const { return dense[denseIndex]; }
+
+    typename std::vector<T>::iterator begin() { return dense.begin(); }
+    typename std::vector<T>::iterator end() { return dense.end(); }
+    typename std::vector<T>::const_iterator begin() const { return dense.begin(); }
+    typename std::vector<T>::const_iterator end() const { return dense.end(); }
+
+private:
+    static const uint32_t FREE = 0xffffffffu;
+
+    struct Slot {
+        uint32_t denseIndex = FREE;
+        uint32_t generation = 0;
+    };
+
+    void Release(uint32_t slot) {
+        slots[slot].denseIndex = FREE;
+        slots[slot].generation++;
+        freeSlots.push_back(slot);
+    }
+
+    std::vector<T> dense;
+    std::vector<uint32_t> denseToSlot;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+};
@@ -0,0 +1,101 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) {
+    Resize(threadCount);
+}
+
+ThreadPool::~ThreadPool() {
+    StopWorkers();
+}
+
+void ThreadPool::Resize(int threadCount) {
+    threadCount = std::max(1, threadCount);
+    if (threadCount == GetThreadCount()) return;
+
+    StopWorkers();
+    unsigned long long currentGeneration;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+        currentGeneration = generation;
+    }
+    // New workers start at the current generation so they wait for the next
+    // job instead of picking up the finished one.
+    for (int i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, i, currentGeneration);
+    }
+}
+
+void ThreadPool::StopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+    workers.clear();
+}
+
+static void chunk_range(size_t count, int worker, int workerCount, size_t& begin, size_t& end) {
+    size_t chunk = (count + workerCount - 1) / workerCount;
+    begin = std::min(count, chunk * worker);
+    end = std::min(count, begin + chunk);
+}
+
+void ThreadPool::RunParallel(size_t count, const std::function<void(size_t begin, size_t end, int worker)>& fn) {
+    if (count == 0) return;
+
+    int workerCount = GetThreadCount();
+    if (workerCount == 1 || count < static_cast<size_t>(workerCount)) {
+        fn(0, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        pending = workerCount - 1;
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    size_t begin, end;
+    chunk_range(count, 0, workerCount, begin, end);
+    fn(begin, end, 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return pending == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::WorkerLoop(int worker, unsigned long long seenGeneration) {
+    while (true) {
+        const std::function<void(size_t, size_t, int)>* currentJob;
+        size_t count;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) return;
+            seenGeneration = generation;
+            currentJob = job;
+            count = jobCount;
+        }
+        // Nothing to run, and no RunParallel waiting on this worker.
+        if (currentJob == nullptr) continue;
+
+        size_t begin, end;
+        chunk_range(count, worker, GetThreadCount(), begin, end);
+        if (begin < end) (*currentJob)(begin, end, worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+        }
+        doneCondition.notify_one();
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fork/join pool used by the physics step. The calling thread always
+// takes part as worker 0, so a pool of size 1 runs everything inline.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threadCount = 1);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Splits [0, count) into one contiguous chunk per worker and blocks until all are done.
+    // fn is only referenced, never copied, so large closures cost no allocation.
+    template <typename Fn>
+    void ParallelFor(size_t count, const Fn& fn) { RunParallel(count, std::cref(fn)); }
+
+    void Resize(int threadCount);
+    int GetThreadCount() const { return static_cast<int>(workers.size()) + 1; }
+
+private:
+    void RunParallel(size_t count, const std::function<void(size_t begin, size_t end, int worker)>& fn);
+    void WorkerLoop(int worker, unsigned long long seenGeneration);
+    void StopWorkers();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+
+    const std::function<void(size_t, size_t, int)>* job = nullptr;
+    size_t jobCount = 0;
+    unsigned long long generation = 0;
+    int pending = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,80 @@
+#include "TileCuller.h"
+
+#include "ShaderLoader.h"
+#include "UBOstructs.h"
+
+#include <iostream>
+#include <string>
+
+namespace {
+
+const char* const KERNEL_NAMES[] = { "TILE_CULL_OBJECTS", "TILE_CULL_LIGHTS" };
+
+const GLuint OBJECT_GROUP_SIZE = 64;
+
+} // namespace
+
+TileCuller::~TileCuller() {
+    Release();
+}
+
+bool TileCuller::Init() {
+    Release();
+    for (int kernel = 0; kernel < KERNEL_COUNT; ++kernel) {
+        std::string preamble = std::string(GLSL_VERSION_LINE) + "#define " + KERNEL_NAMES[kernel] + "\n";
+        GLuint stage = compile_shader_stage(GL_COMPUTE_SHADER,
+                                            { "./src/shaders/path_tracer_common.glsl", "./src/shaders/tile_cull_cs.glsl" },
+                                            preamble);
+        programs[kernel] = link_shader_program({ stage });
+        if (programs[kernel] == 0) {
+            std::cerr << "Tile culling kernel " << KERNEL_NAMES[kernel] << " is unavailable." << std::endl;
+            Release();
+            return false;
+        }
+    }
+    ready = true;
+    return true;
+}
+
+void TileCuller::Release() {
+    for (GLuint& program : programs) {
+        if (program != 0) glDeleteProgram(program);
+        program = 0;
+    }
+    if (tileBuffer != 0) glDeleteBuffers(1, &tileBuffer);
+    tileBuffer = 0;
+    tileColumns = tileRows = 0;
+    bufferBytes = 0;
+    ready = false;
+}
+
+void TileCuller::Build(int width, int height, int objectCount) {
+    if (!ready || width <= 0 || height <= 0) return;
+
+    int columns = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+    if (columns != tileColumns || rows != tileRows) {
+        if (tileBuffer == 0) glGenBuffers(1, &tileBuffer);
+        bufferBytes = static_cast<size_t>(columns) * rows * sizeof(GPUtile);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, bufferBytes, nullptr, GL_DYNAMIC_COPY);
+        tileColumns = columns;
+        tileRows = rows;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_BINDING, tileBuffer);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    if (objectCount > 0) {
+        glUseProgram(programs[OBJECTS]);
+        glDispatchCompute((static_cast<GLuint>(objectCount) + OBJECT_GROUP_SIZE - 1) / OBJECT_GROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        glUseProgram(programs[LIGHTS]);
+        glDispatchCompute(static_cast<GLuint>(columns), static_cast<GLuint>(rows), 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Angel.h"
+
+#include <cstddef>
+
+// Screen-space culling pre-pass of the path tracer (tile_cull_cs.glsl). Every
+// camera ray tests every object it might hit, and with a BVH that still
+// costs a walk from the root; but an object only covers the tiles its
+// projected bounding sphere does. Each frame this bins the objects into
+// TILE_SIZE tiles, so a camera ray tests just its tile's short list and
+// primary visibility follows how much overlaps locally, not the scene size.
+// The same pass picks out the lights that matter most to each tile, which
+// next event estimation at the first vertex favours.
+class TileCuller {
+public:
+    // Mirrors path_tracer_common.glsl.
+    static const int TILE_SIZE = 16;
+
+    TileCuller() = default;
+    ~TileCuller();
+
+    TileCuller(const TileCuller&) = delete;
+    TileCuller& operator=(const TileCuller&) = delete;
+
+    // Builds the kernels; needs a current GL context. Returns false, leaving
+    // the culler unusable, if either fails to compile or link.
+    bool Init();
+    void Release();
+    bool IsReady() const { return ready; }
+
+    // The kernel programs; they take the path tracer's camera uniforms.
+    const GLuint* GetPrograms() const { return programs; }
+    static int GetProgramCount() { return KERNEL_COUNT; }
+
+    // Fills and binds the tile buffer for a width x height image of the
+    // scene in the bound object and light buffers, which hold objectCount
+    // objects. Call before the path tracer runs.
+    void Build(int width, int height, int objectCount);
+
+    size_t GetBufferBytes() const { return bufferBytes; }
+
+private:
+    enum Kernel { OBJECTS, LIGHTS, KERNEL_COUNT };
+
+    static const GLuint TILE_BINDING = 12;
+
+    bool ready = false;
+    GLuint programs[KERNEL_COUNT] = {};
+
+    int tileColumns = 0;
+    int tileRows = 0;
+    size_t bufferBytes = 0;
+    GLuint tileBuffer = 0;
+};
@@ -2,6 +2,10 @@
 
 #include "Angel.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
 struct alignas(16) GPUmaterial {
     vec3 albedo = vec3(1.0);
     float emission = 0.0f;
@@ -19,9 +23,159 @@ struct alignas(16) GPUobject {
     int type = 0;    
 };
 
-const int MAX_OBJECTS_CPP = 16;
+// Objects whose material emits at least this much are sampled as lights.
+const float LIGHT_EMISSION_THRESHOLD = 0.05f;
+
+const uint32_t GPU_OBJECT_TYPE_MASK = 0xFu;
+const uint32_t GPU_OBJECT_EMISSIVE_BIT = 0x10u;
+const uint32_t GPU_OBJECT_TEXTURED_BIT = 0x20u;
+const uint32_t GPU_OBJECT_MATERIAL_SHIFT = 8;
+
+// What the path tracer streams every frame for one GPUobject: its shape, the
+// orientation as a unit quaternion in snorm16 pairs (load_object turns it
+// into the local axes once per fetch, so the intersection tests still get a
+// rotation matrix), and the material replaced by an index into the material
+// table. Matches packed_object in path_tracer_common.glsl (std430, 32 bytes).
+struct alignas(16) GPUpackedObject {
+    vec3 center;
+    float r1;
+    uint32_t rot_xy;    // rot_quat, normalized, as snorm16 pairs like GLSL packSnorm2x16
+    uint32_t rot_zw;
+    float r2;
+    uint32_t bits;      // type | emissive and textured bits | material index << GPU_OBJECT_MATERIAL_SHIFT
+};
+static_assert(sizeof(GPUpackedObject) == 32, "GPUpackedObject must match the std430 packed_object");
+static_assert(sizeof(GPUmaterial) == 32, "GPUmaterial must match the std430 material");
+
+inline uint32_t pack_snorm2x16(float x, float y) {
+    auto pack = [](float v) {
+        return static_cast<uint32_t>(static_cast<uint16_t>(static_cast<int16_t>(std::round(std::clamp(v, -1.0f, 1.0f) * 32767.0f))));
+    };
+    return pack(x) | (pack(y) << 16);
+}
+
+inline GPUpackedObject pack_gpu_object(const GPUobject& obj, uint32_t materialIndex) {
+    vec4 q = obj.rot_quat;
+    float norm = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    q = norm > 0.0f ? q / norm : vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    GPUpackedObject packed;
+    packed.center = obj.center;
+    packed.r1 = obj.r1;
+    packed.rot_xy = pack_snorm2x16(q.x, q.y);
+    packed.rot_zw = pack_snorm2x16(q.z, q.w);
+    packed.r2 = obj.r2;
+    packed.bits = (static_cast<uint32_t>(obj.type) & GPU_OBJECT_TYPE_MASK) |
+                  (obj.m.emission >= LIGHT_EMISSION_THRESHOLD ? GPU_OBJECT_EMISSIVE_BIT : 0u) |
+                  (obj.m.textureID > -1 ? GPU_OBJECT_TEXTURED_BIT : 0u) |
+                  (materialIndex << GPU_OBJECT_MATERIAL_SHIFT);
+    return packed;
+}
+
+// Start of the std430 object storage buffer; the GPUpackedObject array follows
+// it at offset sizeof(ObjectBufferHeader) and is as long as the scene needs.
+// Materials live in their own buffer, indexed like the objects.
+struct alignas(16) ObjectBufferHeader {
+    int num_objects_active = 0;
+    int num_bvh_nodes = 0;
+};
+
+const uint32_t GPU_BVH_COUNT_MASK = 0xFu;
+const uint32_t GPU_BVH_FIRST_SHIFT = 4;
+
+// One node of the object BVH, stored in depth-first order so it can be walked
+// without a stack: a node's first child follows it, and miss is where to go
+// once the node's subtree is done or its box is missed (-1 ends the walk).
+// Matches bvh_node in path_tracer_common.glsl (std430, 32 bytes).
+struct alignas(16) GPUbvhNode {
+    vec3 bmin;
+    int32_t miss = -1;
+    vec3 bmax;
+    uint32_t prims = 0; // leaves: first primitive index << GPU_BVH_FIRST_SHIFT | count; 0 for inner nodes
+};
+static_assert(sizeof(GPUbvhNode) == 32, "GPUbvhNode must match the std430 bvh_node");
+
+// Alias table entry for picking one emitter in proportion to its power: take
+// entry i uniformly, keep it with probability threshold, otherwise take entry
+// alias. pdf is the overall chance of ending up with entry i's object.
+// Matches light_entry in path_tracer_common.glsl (std430, 16 bytes).
+struct GPUlight {
+    uint32_t object;
+    float threshold;
+    uint32_t alias;
+    float pdf;
+};
+
+// Start of the std430 light buffer; GPUlight entries follow it directly.
+struct LightBufferHeader {
+    int num_lights = 0;
+    float total_power = 0.0f; // lets the shader work out the pdf of an emitter it hit
+};
+
+// List lengths of a screen tile; MAX_TILE_OBJECTS and MAX_TILE_LIGHTS in
+// path_tracer_common.glsl.
+const int GPU_TILE_MAX_OBJECTS = 32;
+const int GPU_TILE_MAX_LIGHTS = 8;
+
+// Screen tile of the path tracer's culling pre-pass (tile_cull_cs.glsl),
+// which only the GPU reads and writes; mirrored here for the buffer size.
+struct GPUtileLight {
+    uint32_t object;
+    float weight;
+    float lightPdf;
+};
+static_assert(sizeof(GPUtileLight) == 12, "GPUtileLight must match the std430 tile_light");
+
+struct GPUtile {
+    uint32_t objectCount;
+    uint32_t lightCount;
+    float lightWeightSum;
+    uint32_t objects[GPU_TILE_MAX_OBJECTS];
+    GPUtileLight lights[GPU_TILE_MAX_LIGHTS];
+};
+static_assert(sizeof(GPUtile) == 236, "GPUtile must match the std430 tile_record");
 
-struct ObjectUBOData {
-    GPUobject objects[MAX_OBJECTS_CPP];
-    int num_objects_active;
-};
\ No newline at end of file
+// Per-pixel state of the wavefront path tracer (path_tracer_wavefront_cs.glsl),
+// which only the GPU reads and writes; mirrored here for the buffer sizes.
+struct alignas(16) GPUwavefrontPath {
+    vec3 origin;
+    float bsdfPdf;
+    vec3 direction;
+    float specularPdf;
+    vec3 throughput;
+    uint32_t flags;
+    vec3 radiance;
+    uint32_t samplerDimension;
+    vec3 misVertex;
+    int32_t hitId;
+};
+static_assert(sizeof(GPUwavefrontPath) == 80, "GPUwavefrontPath must match the std430 path_state");
+
+struct alignas(16) GPUwavefrontShadowRay {
+    vec3 origin;
+    float tMax;
+    vec3 direction;
+    int32_t skipId;
+    vec3 contribution;
+    float u;
+};
+static_assert(sizeof(GPUwavefrontShadowRay) == 48, "GPUwavefrontShadowRay must match the std430 shadow_ray");
+
+struct alignas(16) GPUwavefrontPixel {
+    vec3 sum;
+    float luminanceSq;
+    int32_t samples;
+};
+
+// Queue counters; the three group triples are read by glDispatchComputeIndirect.
+struct alignas(16) GPUwavefrontCounters {
+    uint32_t extendGroups[3];
+    uint32_t rayCount;
+    uint32_t shadowGroups[3];
+    uint32_t shadowCount;
+    uint32_t generateGroups[3];
+    uint32_t maxSamples;
+    uint32_t nextRayCount;
+    uint32_t nextShadowCount;
+};
+static_assert(sizeof(GPUwavefrontCounters) == 64, "GPUwavefrontCounters must match the std430 wavefront_counters");
@@ -0,0 +1,144 @@
+#include "VisibilityPrepass.h"
+
+#include "ShaderLoader.h"
+
+#include <iostream>
+
+namespace {
+
+const char* const PIXEL_CLASS_DEFINES[] = { "VISIBILITY_SKY", "VISIBILITY_SINGLE_OBJECT", "VISIBILITY_OVERLAPPED" };
+
+// What primary_gbuffer writes for a miss.
+const GLfloat MISS_NORMAL[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+const GLfloat MISS_ALBEDO[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+const GLfloat MISS_POSITION[4] = { 0.0f, 0.0f, 1.0e18f, 1.0f };
+const GLfloat MISS_OBJECT_INFO[4] = { -1.0f, 0.0f, 0.0f, 1.0f };
+const GLint NO_OBJECT[4] = { -1, 0, 0, 0 };
+
+} // namespace
+
+const char* VisibilityPrepass::GetPixelClassDefine(PixelClass pixelClass) {
+    return PIXEL_CLASS_DEFINES[pixelClass];
+}
+
+VisibilityPrepass::~VisibilityPrepass() {
+    Release();
+}
+
+bool VisibilityPrepass::Init() {
+    Release();
+    const std::string common = "./src/shaders/path_tracer_common.glsl";
+    program = link_shader_program({
+        compile_shader_stage(GL_VERTEX_SHADER, { common, "./src/shaders/visibility_vs.glsl" }, GLSL_VERSION_LINE),
+        compile_shader_stage(GL_FRAGMENT_SHADER, { common, "./src/shaders/visibility_fs.glsl" }, GLSL_VERSION_LINE)
+    });
+    if (program == 0) {
+        std::cerr << "Visibility pre-pass program is unavailable." << std::endl;
+        return false;
+    }
+    // The impostors come from gl_VertexID and gl_InstanceID alone.
+    glGenVertexArrays(1, &vao);
+    ready = true;
+    return true;
+}
+
+void VisibilityPrepass::Release() {
+    if (program != 0) glDeleteProgram(program);
+    program = 0;
+    if (vao != 0) glDeleteVertexArrays(1, &vao);
+    vao = 0;
+    glDeleteFramebuffers(2, framebuffers);
+    framebuffers[0] = framebuffers[1] = 0;
+    if (depthStencilTexture != 0) glDeleteTextures(1, &depthStencilTexture);
+    depthStencilTexture = 0;
+    if (objectTexture != 0) glDeleteTextures(1, &objectTexture);
+    objectTexture = 0;
+    width = height = 0;
+    ready = false;
+}
+
+void VisibilityPrepass::Resize(int newWidth, int newHeight, const GLuint gbuffers[10]) {
+    if (depthStencilTexture != 0) glDeleteTextures(1, &depthStencilTexture);
+    if (objectTexture != 0) glDeleteTextures(1, &objectTexture);
+    depthStencilTexture = objectTexture = 0;
+    // Immutable storage cannot be empty; Render skips until a real size.
+    width = height = 0;
+    if (newWidth <= 0 || newHeight <= 0) return;
+
+    if (framebuffers[0] == 0) glGenFramebuffers(2, framebuffers);
+    width = newWidth;
+    height = newHeight;
+
+    // Reversed float depth: 1 / (1 + t), cleared to 0 with GL_GREATER.
+    glGenTextures(1, &depthStencilTexture);
+    glBindTexture(GL_TEXTURE_2D, depthStencilTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH32F_STENCIL8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &objectTexture);
+    glBindTexture(GL_TEXTURE_2D, objectTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32I, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLenum attachments[5] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3,
+                              GL_COLOR_ATTACHMENT4 };
+    for (int i = 0; i < 2; ++i) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+        for (int j = 0; j < 4; ++j)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[j], GL_TEXTURE_2D, gbuffers[i * 5 + 1 + j], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[4], GL_TEXTURE_2D, objectTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthStencilTexture, 0);
+        glDrawBuffers(5, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::FRAMEBUFFER:: Visibility FBO " << i << " is not complete!" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void VisibilityPrepass::Render(int target, int objectCount) {
+    if (!ready || width <= 0 || height <= 0) return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[target]);
+    glViewport(0, 0, width, height);
+    glClearBufferfv(GL_COLOR, 0, MISS_NORMAL);
+    glClearBufferfv(GL_COLOR, 1, MISS_ALBEDO);
+    glClearBufferfv(GL_COLOR, 2, MISS_POSITION);
+    glClearBufferfv(GL_COLOR, 3, MISS_OBJECT_INFO);
+    glClearBufferiv(GL_COLOR, 4, NO_OBJECT);
+    glClearBufferfi(GL_DEPTH_STENCIL, 0, 0.0f, 0);
+
+    if (objectCount > 0) {
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_GREATER);
+        // Every fragment counts, whether or not its ray hits.
+        glEnable(GL_STENCIL_TEST);
+        glStencilFunc(GL_ALWAYS, 0, 0xFF);
+        glStencilOp(GL_KEEP, GL_INCR, GL_INCR);
+
+        glUseProgram(program);
+        glBindVertexArray(vao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, objectCount);
+
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        glDisable(GL_STENCIL_TEST);
+        glDepthFunc(GL_LESS);
+        glDisable(GL_DEPTH_TEST);
+    }
+}
+
+void VisibilityPrepass::SelectPixels(PixelClass pixelClass) {
+    glEnable(GL_STENCIL_TEST);
+    switch (pixelClass) {
+    case SKY:           glStencilFunc(GL_EQUAL, 0, 0xFF); break;
+    case SINGLE_OBJECT: glStencilFunc(GL_EQUAL, 1, 0xFF); break;
+    default:            glStencilFunc(GL_LESS, 1, 0xFF); break; // 1 < stencil
+    }
+}
+
+void VisibilityPrepass::EndPixels() {
+    glStencilFunc(GL_ALWAYS, 0, 0xFF);
+    glDisable(GL_STENCIL_TEST);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Angel.h"
+
+// Rasterized primary visibility for the fragment path tracer
+// (visibility_vs.glsl, visibility_fs.glsl). Each object is drawn as a
+// screen rectangle around its projected bounding sphere whose fragments
+// ray-cast just that object, so the depth test settles the G-buffer's first
+// hit instead of every pixel walking the scene for it. The same draw counts
+// in the stencil how many objects cover each pixel and keeps the object that
+// won it, and the path tracer is then drawn once per class of pixel: where
+// nothing covers a pixel its camera rays can only see the sky, where one
+// object does it is the only one they can hit first, and where several do
+// the stored object bounds how far they have to look.
+class VisibilityPrepass {
+public:
+    // Pixels by how many objects' bounds cover them; path_tracer_fs.glsl is
+    // built once for each.
+    enum PixelClass { SKY, SINGLE_OBJECT, OVERLAPPED, PIXEL_CLASS_COUNT };
+
+    // The #define that builds path_tracer_fs.glsl for pixelClass.
+    static const char* GetPixelClassDefine(PixelClass pixelClass);
+
+    VisibilityPrepass() = default;
+    ~VisibilityPrepass();
+
+    VisibilityPrepass(const VisibilityPrepass&) = delete;
+    VisibilityPrepass& operator=(const VisibilityPrepass&) = delete;
+
+    // Builds the program; needs a current GL context. Returns false, leaving
+    // the pre-pass unusable, if it fails to compile or link.
+    bool Init();
+    void Release();
+    bool IsReady() const { return ready; }
+
+    // The impostor program; it takes the path tracer's camera uniforms and
+    // textures.
+    GLuint GetProgram() const { return program; }
+
+    // (Re)creates the targets for a width x height image. gbuffers holds the
+    // path tracer's two sets of five targets (colour, normal, albedo,
+    // position, object info); the pass writes the last four of a set and its
+    // own object texture. The depth-stencil texture has to be attached to
+    // the path tracer's framebuffers as well, for SelectPixels. An empty size
+    // frees the targets and leaves Render doing nothing.
+    void Resize(int width, int height, const GLuint gbuffers[10]);
+    GLuint GetDepthStencilTexture() const { return depthStencilTexture; }
+    // R32I: for each covered pixel, the object its unjittered camera ray hits
+    // first, or the first object covering it if that ray hits none.
+    GLuint GetObjectTexture() const { return objectTexture; }
+
+    // Writes G-buffer set target for the scene in the bound object buffers,
+    // which hold objectCount objects, and leaves its framebuffer bound.
+    void Render(int target, int objectCount);
+
+    // Limits the following draws into a path tracer framebuffer to the
+    // pixels of pixelClass in the last Render; EndPixels lifts that.
+    void SelectPixels(PixelClass pixelClass);
+    void EndPixels();
+
+private:
+    bool ready = false;
+    GLuint program = 0;
+    GLuint vao = 0;
+
+    int width = 0;
+    int height = 0;
+    GLuint depthStencilTexture = 0;
+    GLuint objectTexture = 0;
+    GLuint framebuffers[2] = {};
+};
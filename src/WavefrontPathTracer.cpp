@@ -0,0 +1,171 @@
+#include "WavefrontPathTracer.h"
+
+#include "ShaderLoader.h"
+#include "UBOstructs.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace {
+
+const char* const KERNEL_NAMES[] = {
+    "WAVEFRONT_GENERATE", "WAVEFRONT_SETUP", "WAVEFRONT_EXTEND", "WAVEFRONT_SHADE", "WAVEFRONT_SHADOW", "WAVEFRONT_RESOLVE"
+};
+
+const GLuint PIXEL_GROUP_SIZE = 8; // generate and resolve run in 8x8 tiles
+
+const GLbitfield KERNEL_BARRIER_BITS = GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT;
+
+GLuint create_storage_buffer(size_t size) {
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return buffer;
+}
+
+} // namespace
+
+WavefrontPathTracer::~WavefrontPathTracer() {
+    Release();
+}
+
+bool WavefrontPathTracer::Init(ShaderVariantCache& cache) {
+    Release();
+    ready = SetVariant(cache, PathTracerVariant());
+    return ready;
+}
+
+void WavefrontPathTracer::Release() {
+    for (GLuint& program : programs) program = 0;
+    ReleaseBuffers();
+    ready = false;
+}
+
+bool WavefrontPathTracer::SetVariant(ShaderVariantCache& cache, const PathTracerVariant& newVariant) {
+    if (ready && newVariant == variant) return true;
+
+    GLuint kernels[KERNEL_COUNT] = {};
+    std::string defines = newVariant.ToDefines();
+    for (int kernel = 0; kernel < KERNEL_COUNT; ++kernel) {
+        std::string preamble = std::string(GLSL_VERSION_LINE) + "#define " + KERNEL_NAMES[kernel] + "\n" + defines;
+        kernels[kernel] = cache.Get(KERNEL_NAMES[kernel], defines, [&preamble]() {
+            return link_shader_program({ compile_shader_stage(GL_COMPUTE_SHADER,
+                                                              { "./src/shaders/path_tracer_common.glsl", "./src/shaders/path_tracer_wavefront_cs.glsl" },
+                                                              preamble) });
+        });
+        if (kernels[kernel] == 0) return false; // the cache has reported it
+    }
+    for (int kernel = 0; kernel < KERNEL_COUNT; ++kernel) programs[kernel] = kernels[kernel];
+    variant = newVariant;
+    return true;
+}
+
+void WavefrontPathTracer::ReleaseBuffers() {
+    GLuint buffers[] = { pathBuffer, rayQueues[0], rayQueues[1], shadowRayBuffer, shadowQueueBuffer, counterBuffer, pixelBuffer };
+    for (GLuint buffer : buffers) {
+        if (buffer != 0) glDeleteBuffers(1, &buffer);
+    }
+    pathBuffer = rayQueues[0] = rayQueues[1] = shadowRayBuffer = shadowQueueBuffer = counterBuffer = pixelBuffer = 0;
+    bufferWidth = bufferHeight = 0;
+    bufferBytes = 0;
+}
+
+// One path slot, queue entry and set of shadow rays per pixel.
+void WavefrontPathTracer::Allocate(int width, int height) {
+    ReleaseBuffers();
+    size_t pixels = static_cast<size_t>(width) * height;
+
+    pathBuffer = create_storage_buffer(pixels * sizeof(GPUwavefrontPath));
+    rayQueues[0] = create_storage_buffer(pixels * sizeof(uint32_t));
+    rayQueues[1] = create_storage_buffer(pixels * sizeof(uint32_t));
+    shadowRayBuffer = create_storage_buffer(pixels * LIGHT_SAMPLES_PER_VERTEX * sizeof(GPUwavefrontShadowRay));
+    shadowQueueBuffer = create_storage_buffer(pixels * sizeof(uint32_t));
+    pixelBuffer = create_storage_buffer(pixels * sizeof(GPUwavefrontPixel));
+
+    GPUwavefrontCounters counters = {};
+    glGenBuffers(1, &counterBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(counters), &counters, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    bufferWidth = width;
+    bufferHeight = height;
+    bufferBytes = pixels * (sizeof(GPUwavefrontPath) + 3 * sizeof(uint32_t) +
+                            LIGHT_SAMPLES_PER_VERTEX * sizeof(GPUwavefrontShadowRay) + sizeof(GPUwavefrontPixel));
+}
+
+void WavefrontPathTracer::Dispatch(Kernel kernel, GLuint groupsX, GLuint groupsY) {
+    glUseProgram(programs[kernel]);
+    glDispatchCompute(groupsX, groupsY, 1);
+    glMemoryBarrier(KERNEL_BARRIER_BITS);
+}
+
+void WavefrontPathTracer::DispatchIndirect(Kernel kernel, GLintptr offset) {
+    glUseProgram(programs[kernel]);
+    glDispatchComputeIndirect(offset);
+    glMemoryBarrier(KERNEL_BARRIER_BITS);
+}
+
+void WavefrontPathTracer::SetSamplePass(Kernel kernel, int samplePass) {
+    glUseProgram(programs[kernel]);
+    glUniform1i(glGetUniformLocation(programs[kernel], "wavefront_sample"), samplePass);
+}
+
+void WavefrontPathTracer::Render(int width, int height, bool adaptiveSampling, const GLuint targets[5], GLuint statsTarget) {
+    if (!ready || width <= 0 || height <= 0) return;
+    if (width != bufferWidth || height != bufferHeight) Allocate(width, height);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PATH_BINDING, pathBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADOW_RAY_BINDING, shadowRayBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADOW_QUEUE_BINDING, shadowQueueBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, counterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PIXEL_BINDING, pixelBuffer);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counterBuffer);
+
+    const GLintptr extendGroups = offsetof(GPUwavefrontCounters, extendGroups);
+    const GLintptr shadowGroups = offsetof(GPUwavefrontCounters, shadowGroups);
+    const GLintptr generateGroups = offsetof(GPUwavefrontCounters, generateGroups);
+    GLuint groupsX = (static_cast<GLuint>(width) + PIXEL_GROUP_SIZE - 1) / PIXEL_GROUP_SIZE;
+    GLuint groupsY = (static_cast<GLuint>(height) + PIXEL_GROUP_SIZE - 1) / PIXEL_GROUP_SIZE;
+
+    // Generate covers the image until setup finds every pixel's samples
+    // taken; maxSamples is gathered again by the first pass.
+    const GLuint generateReset[4] = { groupsX, groupsY, 1, 0 };
+    glBufferSubData(GL_DISPATCH_INDIRECT_BUFFER, generateGroups, sizeof(generateReset), generateReset);
+    int samplePasses = adaptiveSampling ? MAX_SAMPLES_PER_PIXEL : variant.samplesPerFrame;
+    int pathSegments = variant.maxBounces + (variant.Has(PathTracerVariant::ALPHA) ? TRANSLUCENT_PATH_SEGMENTS : 0);
+
+    // Queues ping-pong: whatever generate or shade appended is the next
+    // round's input. Dispatches for rounds with nothing queued are empty, and
+    // so are whole passes once no pixel owes a sample.
+    int output = 0;
+    for (int pass = 0; pass < samplePasses; ++pass) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_QUEUE_OUT_BINDING, rayQueues[output]);
+        SetSamplePass(GENERATE, pass);
+        DispatchIndirect(GENERATE, generateGroups);
+        SetSamplePass(SETUP, pass);
+        Dispatch(SETUP, 1, 1);
+
+        SetSamplePass(SHADE, pass);
+        for (int segment = 0; segment < pathSegments; ++segment) {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_QUEUE_IN_BINDING, rayQueues[output]);
+            output = 1 - output;
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RAY_QUEUE_OUT_BINDING, rayQueues[output]);
+
+            DispatchIndirect(EXTEND, extendGroups);
+            DispatchIndirect(SHADE, extendGroups);
+            Dispatch(SETUP, 1, 1);
+            DispatchIndirect(SHADOW, shadowGroups);
+        }
+    }
+
+    for (int i = 0; i < 5; ++i) glBindImageTexture(i, targets[i], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glBindImageTexture(5, statsTarget, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    SetSamplePass(RESOLVE, samplePasses);
+    glDispatchCompute(groupsX, groupsY, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Angel.h"
+#include "PathTracerVariant.h"
+#include "ShaderVariantCache.h"
+
+#include <cstddef>
+
+// Compute-shader version of the path tracing pass
+// (path_tracer_wavefront_cs.glsl). The fragment pass follows each path to
+// the end in one invocation, so invocations whose paths end early, skip
+// through translucent rings or wait on shadow rays leave the rest of their
+// warp idle. Here paths advance one segment per round instead, and a round is
+// a chain of small kernels (extend, shade, shadow) that only run over the
+// paths still queued for them. Results land in the same targets as the
+// fragment pass, so everything after it is unchanged.
+class WavefrontPathTracer {
+public:
+    // Mirror path_tracer_common.glsl.
+    static const int MAX_SAMPLES_PER_PIXEL = 16;
+    static const int LIGHT_SAMPLES_PER_VERTEX = 1;
+    // Extend/shade rounds per sample pass on top of the variant's bounces,
+    // for rays that go on through translucent surfaces (variants with
+    // translucent textures only). Paths still going after that are cut off.
+    static const int TRANSLUCENT_PATH_SEGMENTS = 5;
+
+    WavefrontPathTracer() = default;
+    ~WavefrontPathTracer();
+
+    WavefrontPathTracer(const WavefrontPathTracer&) = delete;
+    WavefrontPathTracer& operator=(const WavefrontPathTracer&) = delete;
+
+    // Builds the kernels of the general variant into cache; needs a current
+    // GL context. Returns false, leaving the tracer unusable, if any of them
+    // fails to compile or link.
+    bool Init(ShaderVariantCache& cache);
+    void Release();
+    bool IsReady() const { return ready; }
+
+    // Switches to the kernels of variant, building them into cache if need
+    // be. Returns false, keeping the current kernels, if any fails.
+    bool SetVariant(ShaderVariantCache& cache, const PathTracerVariant& variant);
+
+    // The kernel programs, owned by the cache. Each takes the fragment pass's
+    // uniforms (camera, sampler, frame_count, texture units) and must be
+    // given the same values.
+    const GLuint* GetPrograms() const { return programs; }
+    static int GetProgramCount() { return KERNEL_COUNT; }
+
+    // Traces this frame into targets (colour, normal, albedo, position, object
+    // info; RGBA16F) and statsTarget (RGBA32F), reading the scene buffers and
+    // textures bound for the fragment pass. Adaptive sampling issues
+    // MAX_SAMPLES_PER_PIXEL sample passes, since only the GPU knows how many
+    // samples each pixel asked for, but the passes after the largest count
+    // dispatch empty indirect groups. Per-pixel buffers follow the size.
+    void Render(int width, int height, bool adaptiveSampling, const GLuint targets[5], GLuint statsTarget);
+
+    // GPU memory of the per-pixel buffers.
+    size_t GetBufferBytes() const { return bufferBytes; }
+
+private:
+    enum Kernel { GENERATE, SETUP, EXTEND, SHADE, SHADOW, RESOLVE, KERNEL_COUNT };
+
+    // Storage buffer bindings used by the kernels; 0-4 hold the scene.
+    static const GLuint PATH_BINDING = 5;
+    static const GLuint RAY_QUEUE_IN_BINDING = 6;
+    static const GLuint RAY_QUEUE_OUT_BINDING = 7;
+    static const GLuint SHADOW_RAY_BINDING = 8;
+    static const GLuint SHADOW_QUEUE_BINDING = 9;
+    static const GLuint COUNTER_BINDING = 10;
+    static const GLuint PIXEL_BINDING = 11;
+
+    void Allocate(int width, int height);
+    void ReleaseBuffers();
+    void Dispatch(Kernel kernel, GLuint groupsX, GLuint groupsY);
+    void DispatchIndirect(Kernel kernel, GLintptr offset);
+    void SetSamplePass(Kernel kernel, int samplePass);
+
+    bool ready = false;
+    GLuint programs[KERNEL_COUNT] = {};
+    PathTracerVariant variant;
+
+    int bufferWidth = 0;
+    int bufferHeight = 0;
+    size_t bufferBytes = 0;
+    GLuint pathBuffer = 0;
+    GLuint rayQueues[2] = {};
+    GLuint shadowRayBuffer = 0;
+    GLuint shadowQueueBuffer = 0;
+    GLuint counterBuffer = 0;
+    GLuint pixelBuffer = 0;
+};
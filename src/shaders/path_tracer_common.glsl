@@ -0,0 +1,1209 @@
+// Scene, sampling and shading code shared by the fragment path tracer
+// (path_tracer_fs.glsl) and the wavefront kernels
+// (path_tracer_wavefront_cs.glsl). It has no #version line: the loader puts
+// one in front (see ShaderLoader.h). Textures are read with explicit LOD so
+// the code also compiles for compute stages.
+#define PI_F 3.14159265358979f
+#define FLT_MAX 1e+7
+#define T_MIN 0.01
+
+// Variant settings (PathTracerVariant.h puts them after the #version line).
+// HAS_* and NEXT_EVENT_ESTIMATION keep the code for a feature when 1; a
+// stage compiled without them gets every feature.
+#ifndef MAX_BOUNCES
+#define MAX_BOUNCES 5
+#endif
+#ifndef SAMPLES_PER_FRAME
+#define SAMPLES_PER_FRAME 9             // average per pixel; the frame's ray budget
+#endif
+#ifndef HAS_RINGS
+#define HAS_RINGS 1
+#endif
+#ifndef HAS_TEXTURES
+#define HAS_TEXTURES 1
+#endif
+#ifndef HAS_ALPHA
+#define HAS_ALPHA HAS_TEXTURES          // translucent texels; needs textures
+#endif
+#ifndef NEXT_EVENT_ESTIMATION
+#define NEXT_EVENT_ESTIMATION 1
+#endif
+
+
+
+const int MAX_SPHERE_TEXTURES = 8;
+
+struct ray {
+    vec3 origin;
+    vec3 direction;
+};
+
+struct material {
+    vec3 albedo;
+    float emission;
+    float metallic;     // 0.0 for pure diffuse, 1.0 for pure metal
+    float roughness;    // 0.0 for smooth/mirror, up to 1.0 for very rough
+    int textureID;
+};
+
+struct hit_record {
+    float t;
+    vec3 p;
+    vec3 normal;
+    material m;
+    int obj_type;
+};
+
+struct object {
+    vec4 orientation;   // unit quaternion; see object_rotation
+    vec3 center;
+    float r1;
+    float r1_sq;
+    float r2_sq;
+    int type;
+    int material_id;
+    bool emissive;
+    bool textured;
+};
+
+// Per-frame transform stream, 32 bytes per object (see GPUpackedObject).
+struct packed_object {
+    vec3 center;
+    float r1;
+    uint rot_xy;        // unit quaternion as snorm16 pairs
+    uint rot_zw;
+    float r2;
+    uint bits;          // type, emissive and textured flags, material index
+};
+
+const uint OBJECT_TYPE_MASK = 0xFu;
+const uint OBJECT_EMISSIVE_BIT = 0x10u;
+const uint OBJECT_TEXTURED_BIT = 0x20u;
+const uint OBJECT_MATERIAL_SHIFT = 8u;
+
+// Sized from the scene on the CPU; only the first num_objects_active entries are valid.
+layout ( std430, binding = 0 ) readonly buffer object_buf {
+    int num_objects_active;
+    int num_bvh_nodes;
+    packed_object objects[];
+};
+
+// Looked up only once a ray has hit an object.
+layout ( std430, binding = 1 ) readonly buffer material_buf {
+    material materials[];
+};
+
+// Depth-first BVH over the objects (see GPUbvhNode): the first child of an
+// inner node follows it, and miss is the next node once this one is done.
+struct bvh_node {
+    vec3 bmin;
+    int miss;
+    vec3 bmax;
+    uint prims;         // leaves: first << 4 | count into bvh_prims; 0 for inner nodes
+};
+
+layout ( std430, binding = 2 ) readonly buffer bvh_buf {
+    bvh_node bvh_nodes[];
+};
+
+layout ( std430, binding = 3 ) readonly buffer bvh_prim_buf {
+    uint bvh_prims[];
+};
+
+// Power-weighted alias table over the emitters (see GPUlight).
+struct light_entry {
+    uint object;
+    float threshold;
+    uint alias;
+    float pdf;
+};
+
+layout ( std430, binding = 4 ) readonly buffer light_buf {
+    int num_lights;
+    float total_light_power;
+    light_entry lights[];
+};
+
+// Screen tiles of TILE_SIZE pixels, filled each frame by tile_cull_cs.glsl:
+// the objects whose bounding spheres cover the tile, which is all a camera
+// ray through it can hit, and the lights most likely to matter there.
+// object_count above MAX_TILE_OBJECTS means the list overflowed and the
+// tile's camera rays walk the BVH instead.
+const int TILE_SIZE = 16;
+const int MAX_TILE_OBJECTS = 32;
+const int MAX_TILE_LIGHTS = 8;
+
+// Matches GPUtileLight in UBOstructs.h.
+struct tile_light {
+    uint object;
+    float weight;           // bound on the light's contribution to the tile
+    float light_pdf;        // its pdf in the global alias table
+};
+
+// Matches GPUtile in UBOstructs.h.
+struct tile_record {
+    uint object_count;
+    uint light_count;
+    float light_weight_sum;
+    uint objects[MAX_TILE_OBJECTS];
+    tile_light lights[MAX_TILE_LIGHTS];
+};
+
+layout ( std430, binding = 12 ) buffer tile_buf {
+    tile_record tiles[];
+};
+
+// Lights sampled per path vertex for next event estimation; none without it.
+const int LIGHT_SAMPLES_PER_VERTEX = NEXT_EVENT_ESTIMATION != 0 ? 1 : 0;
+// Specular bounces below this roughness are treated as mirrors by MIS.
+const float DELTA_ROUGHNESS = 0.02;
+// Camera paths traced per pixel per frame (SAMPLES_PER_FRAME on average, up
+// to MAX_BOUNCES long); accumulation does the rest.
+const int MAX_SAMPLES_PER_PIXEL = 16;   // cap for a single pixel when sampling adaptively
+
+// The orientation is decoded only where it is used: sphere tests never need
+// it, rings only need their plane normal.
+object load_object(int j) {
+    packed_object p = objects[j];
+    object o;
+    o.orientation = vec4(unpackSnorm2x16(p.rot_xy), unpackSnorm2x16(p.rot_zw));
+    o.center = p.center;
+    o.r1 = p.r1;
+    o.r1_sq = p.r1 * p.r1;
+    o.r2_sq = p.r2 * p.r2;
+    o.type = int(p.bits & OBJECT_TYPE_MASK);
+    o.material_id = int(p.bits >> OBJECT_MATERIAL_SHIFT);
+    o.emissive = (p.bits & OBJECT_EMISSIVE_BIT) != 0u;
+    o.textured = (p.bits & OBJECT_TEXTURED_BIT) != 0u;
+    return o;
+}
+
+// o's local axes in world space, the columns of its rotation; v * rotation
+// undoes it.
+mat3 object_rotation(const object o) {
+    vec4 q = normalize(o.orientation);
+    vec3 q2 = q.xyz * q.xyz;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    return mat3(1.0 - 2.0 * (q2.y + q2.z), 2.0 * (xy + wz), 2.0 * (xz - wy),
+                2.0 * (xy - wz), 1.0 - 2.0 * (q2.x + q2.z), 2.0 * (yz + wx),
+                2.0 * (xz + wy), 2.0 * (yz - wx), 1.0 - 2.0 * (q2.x + q2.y));
+}
+
+// The second column alone: a ring's plane normal.
+vec3 object_axis_y(const object o) {
+    vec4 q = normalize(o.orientation);
+    return vec3(2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x));
+}
+
+uniform vec4 camPos;
+uniform vec4 camRot_quat;
+uniform float camFov;
+uniform vec2 res;
+uniform uint frame_index;
+uniform int frame_count;
+uniform sampler2D previous_acc;
+uniform sampler2D previous_stats; // mipmapped; the top level holds the mean error
+uniform int adaptive_sampling;
+uniform sampler2D skyDomeTexture;
+uniform sampler2DArray sphere_texture_array;
+uniform float nearPlane;
+uniform float farPlane;
+uniform int tile_culling; // whether the tile buffer is filled this frame
+
+
+vec3 point_at_parameter(ray r, float t) { return r.origin + t * r.direction; }
+
+vec4 quat_conj(vec4 q) { 
+    return vec4(-q.x, -q.y, -q.z, q.w); 
+}
+vec4 quat_inv(vec4 q) { 
+    return quat_conj(q) * (1 / dot(q, q)); 
+}
+vec4 quat_mult(vec4 q1, vec4 q2) { 
+	vec4 qr;
+	qr.x = (q1.w * q2.x) + (q1.x * q2.w) + (q1.y * q2.z) - (q1.z * q2.y);
+	qr.y = (q1.w * q2.y) - (q1.x * q2.z) + (q1.y * q2.w) + (q1.z * q2.x);
+	qr.z = (q1.w * q2.z) + (q1.x * q2.y) - (q1.y * q2.x) + (q1.z * q2.w);
+	qr.w = (q1.w * q2.w) - (q1.x * q2.x) - (q1.y * q2.y) - (q1.z * q2.z);
+	return qr;
+}
+vec3 rotate(vec4 qr, vec3 v) { 
+	vec4 qr_conj = quat_conj(qr);
+	vec4 q_pos = vec4(v.xyz, 0.0);
+	vec4 q_tmp = quat_mult(qr, q_pos);
+	return quat_mult(q_tmp, qr_conj).xyz;
+}
+// Camera ray direction through a point on the image, in pixels.
+vec3 getRayDir(vec2 coord) {
+	vec2 ndc = (coord / res - 0.5) * 2.0;
+    float aspectRatio = res.x / res.y;
+    float half_h = tan(camFov / 2.0);
+
+    vec3 initial_dir;
+    initial_dir.x = ndc.x * half_h * aspectRatio;
+    initial_dir.y = ndc.y * half_h;
+    initial_dir.z = -1.0;
+	return normalize(rotate(camRot_quat, initial_dir));
+}
+
+int tile_columns() {
+    return (int(res.x) + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+// Tile of a pixel, or -1 when tile culling is off.
+int pixel_tile(uvec2 pixel) {
+    if (tile_culling == 0) return -1;
+    return int(pixel.y) / TILE_SIZE * tile_columns() + int(pixel.x) / TILE_SIZE;
+}
+
+// Bounding sphere of an object: a ring's is its outer radius.
+float object_bound_radius(const object o) {
+    return sqrt(max(o.r1_sq, o.r2_sq));
+}
+
+vec3 to_view(vec3 p) {
+    return rotate(quat_inv(camRot_quat), p - camPos.xyz);
+}
+
+// Image plane (z = -1) coordinates of the lines from the eye tangent to a
+// circle of radius r at (x, depth), in the plane of one image axis.
+vec2 tangent_bounds(float x, float depth, float r) {
+    float d = depth * depth - r * r;
+    float s = r * sqrt(x * x + d);
+    return vec2(x * depth - s, x * depth + s) / d;
+}
+
+// Pixel rectangle o's projected bounding sphere covers, one pixel wider for
+// rounding. Spheres reaching behind the eye project without bounds and get
+// the whole image; false if the sphere is entirely behind the camera.
+bool object_pixel_bounds(const object o, out vec2 pixel_lo, out vec2 pixel_hi) {
+    float r = object_bound_radius(o);
+    vec3 c = to_view(o.center);
+    float depth = -c.z;
+    if (depth + r <= 0.0) return false;
+
+    pixel_lo = vec2(-1.0);
+    pixel_hi = res + 1.0;
+    if (depth - r > 0.0) {
+        float half_h = tan(camFov / 2.0);
+        vec2 half_extent = vec2(half_h * res.x / res.y, half_h);
+        vec2 lo = vec2(tangent_bounds(c.x, depth, r).x, tangent_bounds(c.y, depth, r).x) / half_extent;
+        vec2 hi = vec2(tangent_bounds(c.x, depth, r).y, tangent_bounds(c.y, depth, r).y) / half_extent;
+        pixel_lo = (lo * 0.5 + 0.5) * res - 1.0;
+        pixel_hi = (hi * 0.5 + 0.5) * res + 1.0;
+    }
+    return true;
+}
+
+uint hash( uint x ) {
+    x += ( x << 10u );
+    x ^= ( x >>  6u );
+    x += ( x <<  3u );
+    x ^= ( x >> 11u );
+    x += ( x << 15u );
+    return x;
+}
+uint hash( uvec3 v ) { 
+    return hash( v.x ^ hash(v.y) ^ hash(v.z));
+}
+
+// Every path draws its random numbers in the same order, one dimension (a 2D
+// pair) per decision, so the n-th sample of a dimension can come from a
+// sequence that spreads a pixel's samples evenly over the frames instead of
+// from independent hashes.
+//   SAMPLER_SOBOL: the first two Sobol dimensions, Owen-scrambled. The index
+//     is shuffled and the point scrambled per pixel and per dimension, so
+//     pixels and dimensions stay decorrelated and every prefix of the
+//     sequence stays stratified.
+//   SAMPLER_BLUE_NOISE: a tiled blue-noise texture, shifted per dimension and
+//     advanced every sample along the R2 sequence, so the error left in each
+//     frame is spread at high frequencies in screen space and over time.
+const int SAMPLER_SOBOL = 0;
+const int SAMPLER_BLUE_NOISE = 1;
+uniform int sampler_mode;
+uniform sampler2D blueNoiseTexture;
+
+uvec2 sampler_pixel;
+uint sampler_pixel_seed;
+uint sampler_index;
+uint sampler_dimension;
+
+// Starts the sequence of the path-th sample of this frame in a pixel.
+void init_sampler(uvec2 pixel, uint path) {
+    sampler_pixel = pixel;
+    sampler_pixel_seed = hash(uvec3(pixel, 0x2545f491u));
+    sampler_index = frame_index * uint(MAX_SAMPLES_PER_PIXEL) + path;
+    sampler_dimension = 0u;
+}
+
+float unit_float(uint x) {
+    return float(x >> 8) * (1.0 / 16777216.0); // top 24 bits, so never rounds to 1
+}
+
+// Laine and Karras' hash, which only lets a bit affect higher bits; applied
+// to reversed bits it is a nested uniform (Owen) scramble.
+uint laine_karras_permutation(uint x, uint seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+uint nested_uniform_scramble(uint x, uint seed) {
+    return bitfieldReverse(laine_karras_permutation(bitfieldReverse(x), seed));
+}
+
+// Second Sobol dimension; the first is bitfieldReverse(index).
+uint sobol_dimension_1(uint index) {
+    uint x = 0u;
+    for (uint v = 1u << 31; index != 0u; index >>= 1, v ^= v >> 1) {
+        if ((index & 1u) != 0u) x ^= v;
+    }
+    return x;
+}
+
+vec2 sample_2d() {
+    uint dimension = sampler_dimension++;
+    if (sampler_mode == SAMPLER_BLUE_NOISE) {
+        ivec2 size = textureSize(blueNoiseTexture, 0);
+        uint shift = hash(dimension + 1u);
+        ivec2 p = (ivec2(sampler_pixel) + ivec2(shift & 0xffffu, shift >> 16)) % size;
+        vec2 noise = texelFetch(blueNoiseTexture, p, 0).rg;
+        // R2 offsets in 0.32 fixed point, so large indices keep their precision.
+        uvec2 r2 = uvec2(sampler_index * 3242174889u, sampler_index * 2447445413u);
+        return fract(noise + vec2(unit_float(r2.x), unit_float(r2.y)));
+    }
+
+    uint seed = hash(sampler_pixel_seed ^ hash(dimension));
+    uint index = nested_uniform_scramble(sampler_index, seed);
+    uint x = nested_uniform_scramble(bitfieldReverse(index), hash(seed ^ 0xa511e9b3u));
+    uint y = nested_uniform_scramble(sobol_dimension_1(index), hash(seed ^ 0x63d83595u));
+    return vec2(unit_float(x), unit_float(y));
+}
+
+float sample_1d() {
+    return sample_2d().x;
+}
+
+// Picks an emitter in proportion to its power; returns its object index and
+// the probability of having picked it.
+int sample_light(float u, out float pdf) {
+    u *= float(num_lights);
+    int i = min(int(u), num_lights - 1);
+    light_entry entry = lights[i];
+    if (u - float(i) >= entry.threshold) entry = lights[entry.alias];
+    pdf = entry.pdf;
+    return int(entry.object);
+}
+
+// Chance of picking a light from the tile's list rather than the global table.
+// The global share keeps every light reachable from every tile, including
+// those the list left out.
+const float TILE_LIGHT_SHARE = 0.75;
+
+bool tile_has_lights(int tile) {
+    return tile >= 0 && tiles[tile].light_count > 0u;
+}
+
+// Probability of the tile's list yielding object j.
+float tile_light_share(int tile, int j) {
+    uint count = tiles[tile].light_count;
+    for (uint k = 0u; k < count; k++) {
+        if (int(tiles[tile].lights[k].object) == j) return tiles[tile].lights[k].weight / tiles[tile].light_weight_sum;
+    }
+    return 0.0;
+}
+
+// Chance of sample_vertex_light picking object j, whose global pdf is
+// light_pdf, at a vertex seen through tile (-1 for none).
+float vertex_light_pdf(int tile, int j, float light_pdf) {
+    if (!tile_has_lights(tile)) return light_pdf;
+    return TILE_LIGHT_SHARE * tile_light_share(tile, j) + (1.0 - TILE_LIGHT_SHARE) * light_pdf;
+}
+
+// sample_light for a vertex seen through tile: mostly from the tile's list,
+// by weight, otherwise from the global table.
+int sample_vertex_light(int tile, float u, out float pdf) {
+    if (!tile_has_lights(tile)) return sample_light(u, pdf);
+
+    int j;
+    float light_pdf;
+    if (u < TILE_LIGHT_SHARE) {
+        uint count = tiles[tile].light_count;
+        float target = u / TILE_LIGHT_SHARE * tiles[tile].light_weight_sum;
+        uint k = 0u;
+        while (k + 1u < count && target >= tiles[tile].lights[k].weight) {
+            target -= tiles[tile].lights[k].weight;
+            k++;
+        }
+        j = int(tiles[tile].lights[k].object);
+        light_pdf = tiles[tile].lights[k].light_pdf;
+    }
+    else {
+        j = sample_light((u - TILE_LIGHT_SHARE) / (1.0 - TILE_LIGHT_SHARE), light_pdf);
+    }
+    pdf = vertex_light_pdf(tile, j, light_pdf);
+    return j;
+}
+
+// Orthonormal basis around w.
+void make_basis(vec3 w, out vec3 u, out vec3 v) {
+    vec3 up = abs(w.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    u = normalize(cross(up, w));
+    v = cross(w, u);
+}
+
+// Cosine-weighted direction around N (pdf dot(N, L) / PI), by Malley's
+// method: a uniform disk point lifted onto the hemisphere.
+vec3 cosine_sample_hemisphere(vec3 N, vec2 u) {
+    float r = sqrt(u.x);
+    float phi = 2.0 * PI_F * u.y;
+    vec3 t, b;
+    make_basis(N, t, b);
+    return normalize(t * (r * cos(phi)) + b * (r * sin(phi)) + N * sqrt(max(0.0, 1.0 - u.x)));
+}
+
+// 1 - cos of the half-angle of the cone a sphere fills as seen from a point
+// at squared distance dist_sq; 0 from inside. Written as sin^2 / (1 + cos) so
+// distant stars keep their precision.
+float sphere_cone_size(float radius, float dist_sq) {
+    float sin2_max = radius * radius / dist_sq;
+    if (sin2_max >= 1.0) return 0.0;
+    return sin2_max / (1.0 + sqrt(1.0 - sin2_max));
+}
+
+// Samples a direction from p towards light o, returning its solid angle pdf
+// (0 if there is nothing to sample) along with the distance to and normal at
+// the point it reaches. Spheres are sampled uniformly inside the cone they
+// fill, so no sample lands on the far side; rings and disks by area.
+float sample_light_direction(const object o, vec3 p, vec2 u, out vec3 dir, out float dist, out vec3 normal_on_light) {
+    float r1 = u.x;
+    float r2 = u.y;
+
+    if (o.type == 0) {
+        vec3 to_center = o.center - p;
+        float dist_sq = dot(to_center, to_center);
+        float cone = sphere_cone_size(o.r1, dist_sq);
+        if (cone <= 0.0) return 0.0;
+
+        float one_minus_cos = r1 * cone;
+        float cos_theta = 1.0 - one_minus_cos;
+        float sin_theta = sqrt(max(0.0, one_minus_cos * (2.0 - one_minus_cos)));
+        float phi = 2.0 * PI_F * r2;
+        vec3 w = to_center / sqrt(dist_sq);
+        vec3 u, v;
+        make_basis(w, u, v);
+        dir = normalize(u * (cos(phi) * sin_theta) + v * (sin(phi) * sin_theta) + w * cos_theta);
+
+        float b = dot(to_center, dir);
+        dist = b - sqrt(max(0.0, o.r1 * o.r1 - (dist_sq - b * b)));
+        normal_on_light = normalize(p + dir * dist - o.center);
+        return 1.0 / (2.0 * PI_F * cone);
+    }
+#if HAS_RINGS
+    else if (o.type == 1) {
+        float theta = 2.0 * PI_F * r1;
+        float radius = sqrt(o.r2_sq + r2 * (o.r1_sq - o.r2_sq));
+
+        // Point on a base ring (XZ plane)
+        vec3 local_point = vec3(radius * cos(theta), 0.0, radius * sin(theta));
+        mat3 rotation = object_rotation(o);
+        vec3 point_on_light = o.center + rotation * local_point;
+        normal_on_light = rotation[1];
+
+        vec3 to_light = point_on_light - p;
+        float dist_sq = dot(to_light, to_light);
+        if (dist_sq < 0.0001) return 0.0;
+        dist = sqrt(dist_sq);
+        dir = to_light / dist;
+
+        float cos_light = abs(dot(normal_on_light, dir));
+        float area = PI_F * (o.r1_sq - o.r2_sq);
+        if (cos_light < 0.0001 || area <= 0.0) return 0.0;
+        return dist_sq / (cos_light * area);
+    }
+#endif
+    return 0.0;
+}
+
+// Solid angle pdf of sample_light_direction producing dir from p, when dir
+// reaches light o at distance dist where its normal is normal_on_light.
+float light_direction_pdf(const object o, vec3 p, vec3 dir, float dist, vec3 normal_on_light) {
+    if (o.type == 0) {
+        vec3 to_center = o.center - p;
+        float cone = sphere_cone_size(o.r1, dot(to_center, to_center));
+        return cone > 0.0 ? 1.0 / (2.0 * PI_F * cone) : 0.0;
+    }
+#if HAS_RINGS
+    else if (o.type == 1) {
+        float cos_light = abs(dot(normal_on_light, dir));
+        float area = PI_F * (o.r1_sq - o.r2_sq);
+        if (cos_light < 0.0001 || area <= 0.0) return 0.0;
+        return dist * dist / (cos_light * area);
+    }
+#endif
+    return 0.0;
+}
+
+// Chance of sample_light picking object o; mirrors emitted_power on the CPU.
+float light_selection_pdf(const object o, const material m) {
+    if (!o.emissive || total_light_power <= 0.0) return 0.0;
+    float area;
+    if (o.type == 0) area = 4.0 * PI_F * o.r1_sq;
+#if HAS_RINGS
+    else if (o.type == 1) area = PI_F * (o.r1_sq - o.r2_sq);
+#endif
+    else return 0.0;
+    float luminance = dot(m.albedo, vec3(0.2126, 0.7152, 0.0722));
+    return max(0.0, luminance * m.emission * area) / total_light_power;
+}
+
+// Irradiance on a surface from a uniformly bright sphere of unit radiance:
+// cos_theta is between the normal and the direction to the sphere's centre,
+// sin2_sigma the squared sine of its angular radius. Exact, including a
+// sphere partly below the horizon (Snyder's patch-to-sphere form factor).
+float sphere_irradiance(float cos_theta, float sin2_sigma) {
+    if (cos_theta * cos_theta > sin2_sigma) return PI_F * sin2_sigma * max(cos_theta, 0.0);
+    if (sin2_sigma >= 1.0) return PI_F * 0.5 * (1.0 + cos_theta); // touching the surface
+
+    float sin_theta = sqrt(max(1.0 - cos_theta * cos_theta, 1e-12));
+    float cot_sigma = sqrt(1.0 / sin2_sigma - 1.0);
+    float y = clamp(-cot_sigma * cos_theta / sin_theta, -1.0, 1.0);
+    float sin_theta_sqrt_y = sin_theta * sqrt(1.0 - y * y);
+    return max(0.0, (cos_theta * acos(y) - cot_sigma * sin_theta_sqrt_y) * sin2_sigma + atan(sin_theta_sqrt_y / cot_sigma));
+}
+
+float power_heuristic(float pdf_a, float pdf_b) {
+    float a2 = pdf_a * pdf_a;
+    float b2 = pdf_b * pdf_b;
+    return a2 + b2 > 0.0 ? a2 / (a2 + b2) : 0.0;
+}
+
+// Texture coordinates of point p on o.
+vec2 get_object_uv(const object o, vec3 p) {
+    vec3 local_p = (p - o.center) * object_rotation(o);
+    if (o.type == 0) {
+        vec3 local_normal = local_p / o.r1;
+        float phi = atan(local_normal.z, local_normal.x);
+        float theta = acos(clamp(local_normal.y, -1.0, 1.0));
+        float u = 1.0 - ((phi + PI_F) / (2.0 * PI_F));
+        float v = 1.0 - (theta / PI_F);
+        return vec2(u, v);
+    }
+#if HAS_RINGS
+    else if (o.type == 1) {
+        float hit_radius = length(local_p.xz);
+        float r2 = sqrt(o.r2_sq);
+        float v = (hit_radius - r2) / (o.r1 - r2);
+
+        float angle = atan(local_p.z, local_p.x);
+        float u = (angle + PI_F) / (2.0 * PI_F);
+        return vec2(v, u);
+    }
+#endif
+    return vec2(0.0);
+}
+
+// Distance t along r to where it first meets o within (t_min, t_max), and
+// nothing else: the normal, material and texture wait for object_hit, so
+// candidates that lose to a closer hit, and shadow rays, never pay for them.
+// Both shapes are tested in world space.
+bool intersect_object(const object o, const ray r, float t_min, float t_max, out float t) {
+    vec3 oc = r.origin - o.center;
+    if (o.type == 0) {
+        float a = dot(r.direction, r.direction);
+        float b = dot(oc, r.direction);
+        float c = dot(oc, oc) - o.r1_sq;
+        float discriminant = b*b - a*c;
+        if (discriminant <= 0.0) return false;
+        float root = sqrt(discriminant);
+        t = (-b - root) / a;
+        if (t < t_max && t > t_min) return true;
+        t = (-b + root) / a;
+        return t < t_max && t > t_min;
+    }
+#if HAS_RINGS
+    else if (o.type == 1) {
+        vec3 n = object_axis_y(o);
+        float denom = dot(r.direction, n);
+        if (abs(denom) <= 1e-6) return false;
+        t = -dot(oc, n) / denom;
+        if (!(t > t_min && t < t_max)) return false;
+        vec3 in_plane = oc + t * r.direction;
+        float dist_sq = dot(in_plane, in_plane);
+        return dist_sq < o.r1_sq && dist_sq > o.r2_sq;
+    }
+#endif
+    return false;
+}
+
+// The hit record where r meets o at t, as found by intersect_object.
+hit_record object_hit(const object o, const ray r, float t) {
+    hit_record rec;
+    rec.t = t;
+    rec.p = point_at_parameter(r, t);
+    if (o.type == 0) rec.normal = (rec.p - o.center) / o.r1;
+#if HAS_RINGS
+    else {
+        vec3 n = object_axis_y(o);
+        rec.normal = dot(r.direction, n) < 0.0 ? n : -n;
+    }
+#endif
+    rec.m = materials[o.material_id];
+    rec.obj_type = o.type;
+    return rec;
+}
+
+bool hit_object(const object o, const ray r, float t_min, float t_max, inout hit_record rec) {
+    float t;
+    if (!intersect_object(o, r, t_min, t_max, t)) return false;
+    rec = object_hit(o, r, t);
+    return true;
+}
+
+bool hit_bvh_node(const bvh_node n, const ray r, vec3 inv_dir, float t_max) {
+    vec3 t0 = (n.bmin - r.origin) * inv_dir;
+    vec3 t1 = (n.bmax - r.origin) * inv_dir;
+    vec3 t_near = min(t0, t1);
+    vec3 t_far = max(t0, t1);
+    return max(max(t_near.x, t_near.y), max(t_near.z, 0.0)) <= min(min(t_far.x, t_far.y), min(t_far.z, t_max));
+}
+
+vec3 ray_inverse_direction(vec3 d) {
+    return 1.0 / mix(d, vec3(1e-20), equal(d, vec3(0.0)));
+}
+
+// Closest object along r before t_max. Walks the BVH without a stack: a node
+// whose box is hit continues into its first child, anything else jumps to miss.
+// Only the winner's hit record is filled in.
+bool hit_scene(const ray r, float t_max, inout hit_record rec, out int hit_id) {
+    vec3 inv_dir = ray_inverse_direction(r.direction);
+    float closest_t = t_max;
+    hit_id = -1;
+
+    int node_index = num_bvh_nodes > 0 ? 0 : -1;
+    while (node_index >= 0) {
+        bvh_node n = bvh_nodes[node_index];
+        if (hit_bvh_node(n, r, inv_dir, closest_t)) {
+            uint count = n.prims & 0xFu;
+            if (count == 0u) {
+                node_index++;
+                continue;
+            }
+            uint first = n.prims >> 4;
+            for (uint k = first; k < first + count; k++) {
+                int j = int(bvh_prims[k]);
+                float t;
+                if (intersect_object(load_object(j), r, T_MIN, closest_t, t)) {
+                    closest_t = t;
+                    hit_id = j;
+                }
+            }
+        }
+        node_index = n.miss;
+    }
+    if (hit_id < 0) return false;
+    rec = object_hit(load_object(hit_id), r, closest_t);
+    return true;
+}
+
+// hit_scene for a ray along a camera ray through tile: only the objects
+// binned into the tile can be hit. Overflowed tiles, and tile -1, use the BVH.
+bool hit_camera_ray(const ray r, int tile, float t_max, inout hit_record rec, out int hit_id) {
+    if (tile < 0 || tiles[tile].object_count > uint(MAX_TILE_OBJECTS)) return hit_scene(r, t_max, rec, hit_id);
+
+    float closest_t = t_max;
+    hit_id = -1;
+    uint count = tiles[tile].object_count;
+    for (uint k = 0u; k < count; k++) {
+        int j = int(tiles[tile].objects[k]);
+        float t;
+        if (intersect_object(load_object(j), r, T_MIN, closest_t, t)) {
+            closest_t = t;
+            hit_id = j;
+        }
+    }
+    if (hit_id < 0) return false;
+    rec = object_hit(load_object(hit_id), r, closest_t);
+    return true;
+}
+
+// Whether anything opaque lies on r before t_max, ignoring object skip_id (the
+// light being sampled). Any hit will do, so the walk ends at the first
+// untextured one without looking at its material (at the first one at all
+// without HAS_ALPHA). Textured objects let the ray through by their alpha,
+// decided by u: a ray that passes one occluder rescales u to the range that
+// let it pass, so it stays uniform for the next.
+bool is_occluded(const ray r, float t_max, int skip_id, float u) {
+    vec3 inv_dir = ray_inverse_direction(r.direction);
+
+    int node_index = num_bvh_nodes > 0 ? 0 : -1;
+    while (node_index >= 0) {
+        bvh_node n = bvh_nodes[node_index];
+        if (hit_bvh_node(n, r, inv_dir, t_max)) {
+            uint count = n.prims & 0xFu;
+            if (count == 0u) {
+                node_index++;
+                continue;
+            }
+            uint first = n.prims >> 4;
+            for (uint k = first; k < first + count; k++) {
+                int j = int(bvh_prims[k]);
+                if (j == skip_id) continue;
+
+                object occluder = load_object(j);
+                float t;
+                if (!intersect_object(occluder, r, T_MIN, t_max, t)) continue;
+#if HAS_ALPHA
+                if (!occluder.textured) return true;
+
+                vec2 shadow_uv = get_object_uv(occluder, point_at_parameter(r, t));
+                int texture_id = materials[occluder.material_id].textureID;
+                float shadow_alpha = textureLod(sphere_texture_array, vec3(shadow_uv, float(texture_id)), 0.0).a;
+                if (shadow_alpha < 0.99) {
+                    float transmission = 1.0 - shadow_alpha;
+                    if (u < transmission) {
+                        u /= transmission;
+                        continue;
+                    }
+                }
+#endif
+                return true;
+            }
+        }
+        node_index = n.miss;
+    }
+    return false;
+}
+
+float D_GGX(vec3 N, vec3 H, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH = max(dot(N, H), 0.0);
+    float NdotH2 = NdotH * NdotH;
+
+    float nom   = a2;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    denom = PI_F * denom * denom;
+
+    return nom / max(denom, 0.0001);
+}
+float G_SchlickGGX(float NdotV, float roughness) {
+    float r = (roughness + 1.0);
+    float k = (r * r) / 8.0;
+    float nom = NdotV;
+    float denom = NdotV * (1.0 - k) + k;
+    return nom / max(denom, 0.0001);
+}
+float G_Smith(vec3 N, vec3 V, vec3 L, float roughness) {
+    float NdotV = max(dot(N, V), 0.0);
+    float NdotL = max(dot(N, L), 0.0);
+    float ggx2 = G_SchlickGGX(NdotV, roughness);
+    float ggx1 = G_SchlickGGX(NdotL, roughness);
+    return ggx1 * ggx2;
+}
+vec3 F_FresnelSchlick(float cosTheta, vec3 f0) {
+    return f0 + (1.0 - f0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+vec3 importance_sample_GGX(vec2 rand_uv, vec3 N, float roughness) {
+    float a = roughness * roughness;
+    float phi = 2.0 * PI_F * rand_uv.x;
+    float cosTheta = sqrt((1.0 - rand_uv.y) / (1.0 + (a*a - 1.0) * rand_uv.y));
+    float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+
+    vec3 H;
+    H.x = cos(phi) * sinTheta;
+    H.y = sin(phi) * sinTheta;
+    H.z = cosTheta;
+
+    vec3 up        = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent   = normalize(cross(up, N));
+    vec3 bitangent = cross(N, tangent);
+
+    vec3 sampleVec = tangent * H.x + bitangent * H.y + N * H.z;
+    return normalize(sampleVec);
+}
+
+void scatter(const ray r_in, const hit_record rec, const vec3 surface_albedo, inout vec3 attenuation, inout ray scattered, inout bool was_specular_scatter) {
+    vec3 N = rec.normal;
+    vec3 V = -r_in.direction;
+
+    vec3 f0 = mix(vec3(0.04), surface_albedo, rec.m.metallic);
+    vec3 diffuse_color = surface_albedo * (1.0 - rec.m.metallic);
+
+    vec3 f = F_FresnelSchlick(max(dot(N, V), 0.0), f0);
+    float specular_chance = max(f.r, max(f.g, f.b));
+    float diffuse_chance = 1.0 - specular_chance;
+
+    float r1 = sample_1d();
+    vec2 u = sample_2d();
+
+    if (r1 < diffuse_chance) {
+        scattered = ray(rec.p, cosine_sample_hemisphere(N, u));
+        attenuation = diffuse_color;
+        was_specular_scatter = false;
+    }
+    else {
+        vec3 H = importance_sample_GGX(u, N, rec.m.roughness);
+        vec3 L = reflect(-V, H);
+
+        if (dot(L, N) <= 0.0) {
+            attenuation = vec3(0.0);
+            was_specular_scatter = true;
+            scattered = ray(rec.p, N);
+        }
+        else {
+            scattered = ray(rec.p, normalize(L));
+            attenuation = f;
+            was_specular_scatter = true;
+        }
+    }
+
+    float path_prob = diffuse_chance + specular_chance;
+    if (path_prob > 0.0) attenuation /= path_prob;
+}
+// Solid angle densities of scatter() sending a ray from V to L through its
+// cosine-weighted diffuse and its GGX specular lobe, each including the
+// chance of picking that lobe.
+void bsdf_lobe_pdfs(const hit_record rec, const vec3 surface_albedo, vec3 V, vec3 L, out float diffuse_pdf, out float specular_pdf) {
+    diffuse_pdf = 0.0;
+    specular_pdf = 0.0;
+    vec3 N = rec.normal;
+    float NdotL = dot(N, L);
+    if (NdotL <= 0.0) return;
+
+    vec3 f0 = mix(vec3(0.04), surface_albedo, rec.m.metallic);
+    vec3 f = F_FresnelSchlick(max(dot(N, V), 0.0), f0);
+    float specular_chance = max(f.r, max(f.g, f.b));
+
+    vec3 H = normalize(V + L);
+    diffuse_pdf = (1.0 - specular_chance) * NdotL / PI_F;
+    specular_pdf = specular_chance * D_GGX(N, H, rec.m.roughness) * max(dot(N, H), 0.0) / (4.0 * max(dot(V, H), 0.0001));
+}
+
+float bsdf_pdf(const hit_record rec, const vec3 surface_albedo, vec3 V, vec3 L) {
+    float diffuse_pdf, specular_pdf;
+    bsdf_lobe_pdfs(rec, surface_albedo, V, L, diffuse_pdf, specular_pdf);
+    return diffuse_pdf + specular_pdf;
+}
+
+vec3 emitted(material m) {
+    return m.albedo * m.emission;
+}
+
+
+// What a path remembers about the vertex it scattered from, to weight an
+// emitter its next ray hits against light sampling at that vertex.
+struct mis_state {
+    // 0 when the ray was not sampled by a BSDF lobe light sampling could
+    // also produce (camera ray, mirror bounce).
+    float bsdf_pdf;
+    float specular_pdf;
+    vec3 vertex;
+    // Set when the vertex lit its diffuse lobe from sphere lights
+    // analytically; BSDF rays then only count sphere lights in the specular lobe.
+    bool analytic;
+    bool was_diffuse;
+    int light_tile;         // tile the vertex's light sample drew on, or -1
+};
+
+mis_state camera_mis_state(vec3 origin) {
+    return mis_state(0.0, 0.0, origin, false, false, -1);
+}
+
+// Surface albedo at a hit with its texture applied, and the texture's alpha.
+vec4 surface_albedo_alpha(const object o, const hit_record rec) {
+    vec4 surface = vec4(rec.m.albedo, 1.0);
+#if HAS_TEXTURES
+    if (rec.m.textureID > -1) {
+        vec2 uv = get_object_uv(o, rec.p);
+        surface *= textureLod(sphere_texture_array, vec3(uv, float(rec.m.textureID)), 0.0);
+    }
+#endif
+    return surface;
+}
+
+// Whether a ray goes on through a translucent surface instead of hitting it.
+bool passes_through(float alpha) {
+#if HAS_ALPHA
+    return alpha < 0.99 && sample_1d() < 1.0 - alpha;
+#else
+    return false;
+#endif
+}
+
+vec3 sky_radiance(vec3 direction) {
+    vec3 ray_dir = normalize(direction);
+    float phi = atan(ray_dir.z, ray_dir.x);
+    float theta = acos(ray_dir.y);
+    vec2 sky_uv;
+    sky_uv.x = (phi + PI_F) / (2.0 * PI_F);
+    sky_uv.y = 1 - (theta / PI_F);
+
+    return textureLod(skyDomeTexture, sky_uv, 0.0).rgb * 0.75;
+}
+
+// Emission a ray along direction picks up from emitter o (object id) at
+// bounce i, weighted against light sampling from the vertex it left.
+vec3 emitter_radiance(const object o, int id, const hit_record rec, vec3 direction, int bounce, const mis_state mis) {
+    float max_indirect_contrib = 10000.0;
+    if (bounce > 0) max_indirect_contrib = 10.0;
+    float mis_weight = 1.0;
+#if NEXT_EVENT_ESTIMATION
+    if (mis.bsdf_pdf > 0.0) {
+        float light_pdf = vertex_light_pdf(mis.light_tile, id, light_selection_pdf(o, rec.m)) * float(LIGHT_SAMPLES_PER_VERTEX) *
+                          light_direction_pdf(o, mis.vertex, direction, length(rec.p - mis.vertex), rec.normal);
+        if (mis.analytic && o.type == 0) 
+            mis_weight = mis.was_diffuse ? 0.0 : power_heuristic(mis.specular_pdf, light_pdf);
+        else mis_weight = power_heuristic(mis.bsdf_pdf, light_pdf);
+    }
+#endif
+    return min(emitted(rec.m), vec3(max_indirect_contrib)) * mis_weight;
+}
+
+// Shadow ray of a light sample, with the sample is_occluded uses for
+// translucent occluders.
+struct shadow_query {
+    ray r;
+    float t_max;
+    int skip_id;
+    float u;
+};
+
+// One next event estimation sample at rec, seen from V: picks an emitter by
+// power (favouring tile's lights, if rec was seen through one) and a
+// direction towards it, and returns the light it adds if q turns out
+// unoccluded (0 if there is nothing to add).
+vec3 sample_direct_light(const hit_record rec, int hit_id, int tile, vec3 surface_albedo, vec3 V, out shadow_query q) {
+    q = shadow_query(ray(rec.p, rec.normal), 0.0, -1, 0.0);
+    if (num_lights <= 0) return vec3(0.0);
+
+    float light_select_pdf;
+    int j = sample_vertex_light(tile, sample_1d(), light_select_pdf);
+    if (j == hit_id) return vec3(0.0); // a convex emitter does not light itself
+    object light = load_object(j);
+    material light_m = materials[light.material_id];
+
+    vec3 dir_to_light, n_on_light;
+    float dist_to_light;
+    float light_dir_pdf = sample_light_direction(light, rec.p, sample_2d(), dir_to_light, dist_to_light, n_on_light);
+    if (light_dir_pdf <= 0.0) return vec3(0.0);
+    q = shadow_query(ray(rec.p, dir_to_light), dist_to_light - T_MIN, j, sample_1d());
+
+    vec3 N = rec.normal;
+    vec3 L = dir_to_light;
+    vec3 direct = vec3(0.0);
+
+    // Power heuristic against the BSDF having sampled L.
+    float light_pdf = light_select_pdf * float(LIGHT_SAMPLES_PER_VERTEX) * light_dir_pdf;
+    float light_weight = power_heuristic(light_pdf, bsdf_pdf(rec, surface_albedo, V, L)) / light_pdf;
+
+#if HAS_RINGS
+    if (rec.obj_type == 1) {
+        float NdotL = abs(dot(N, L));
+        if (NdotL > 0.0) {
+            vec3 brdf = surface_albedo / PI_F;
+            vec3 direct_light = emitted(light_m) * brdf * NdotL;
+
+            float grazing_angle_factor = 1.0 - NdotL;
+            float rim_power = 3.5;
+            float rim_intensity = 0.2; 
+            vec3 rim_color = pow(grazing_angle_factor, rim_power) * rim_intensity * surface_albedo;
+            
+            vec3 rim_contribution = emitted(light_m) * rim_color;
+            
+            direct_light += rim_contribution;
+            
+            direct += direct_light * light_weight;
+        }
+    }
+    else
+#endif
+    {
+        vec3 f0 = mix(vec3(0.04), surface_albedo, rec.m.metallic);
+        // Sphere lights: the diffuse lobe gets the exact unshadowed
+        // irradiance, with the shadow ray as its visibility.
+        bool analytic = light.type == 0;
+        if (analytic) {
+            vec3 to_center = light.center - rec.p;
+            float dist_sq = dot(to_center, to_center);
+            float irradiance = sphere_irradiance(dot(N, to_center) * inversesqrt(dist_sq), light.r1 * light.r1 / dist_sq);
+            vec3 kD = (vec3(1.0) - F_FresnelSchlick(max(dot(N, V), 0.0), f0)) * (1.0 - rec.m.metallic);
+            direct += emitted(light_m) * kD * surface_albedo / PI_F * irradiance /
+                      (light_select_pdf * float(LIGHT_SAMPLES_PER_VERTEX));
+        }
+
+        float NdotL = max(dot(N, L), 0.0);
+        if (NdotL > 0.0) {
+            vec3 H = normalize(V + L);
+            vec3 F = F_FresnelSchlick(max(dot(H, V), 0.0), f0);
+            
+            float D = D_GGX(N, H, rec.m.roughness);
+            float G = G_Smith(N, V, L, rec.m.roughness);
+            vec3 specular_brdf = (D * G * F) / max(4.0 * max(dot(N, V), 0.0) * NdotL, 0.001);
+            
+            vec3 kS = F;
+            vec3 kD = (vec3(1.0) - kS) * (1.0 - rec.m.metallic);
+            vec3 diffuse_brdf = kD * surface_albedo / PI_F;
+
+            vec3 brdf = analytic ? specular_brdf : diffuse_brdf + specular_brdf;
+            float weight = light_weight;
+            if (analytic) {
+                float diffuse_pdf, specular_pdf;
+                bsdf_lobe_pdfs(rec, surface_albedo, V, L, diffuse_pdf, specular_pdf);
+                weight = power_heuristic(light_pdf, specular_pdf) / light_pdf;
+            }
+            direct += emitted(light_m) * brdf * NdotL * weight;
+        }
+    }
+    return direct;
+}
+
+// Scatters r_in at rec and records the vertex, whose light sample drew on
+// light_tile, in mis. Returns the factor the path throughput picks up.
+vec3 scatter_path(const ray r_in, const hit_record rec, vec3 surface_albedo, int light_tile, out ray scattered, inout mis_state mis) {
+    vec3 attenuation;
+    bool was_specular;
+    scatter(r_in, rec, surface_albedo, attenuation, scattered, was_specular);
+
+    // Near-mirror lobes are too peaked for light sampling to find, so
+    // whatever they hit keeps its full weight.
+    bool delta_scatter = was_specular && rec.m.roughness < DELTA_ROUGHNESS;
+    float diffuse_pdf, specular_pdf;
+    bsdf_lobe_pdfs(rec, surface_albedo, -r_in.direction, scattered.direction, diffuse_pdf, specular_pdf);
+    mis.bsdf_pdf = delta_scatter ? 0.0 : diffuse_pdf + specular_pdf;
+    mis.specular_pdf = specular_pdf;
+    mis.was_diffuse = !was_specular;
+    mis.analytic = rec.obj_type != 1 && num_lights > 0;
+    mis.vertex = rec.p;
+    mis.light_tile = light_tile;
+    return attenuation;
+}
+
+// Whether a path goes on after bounce i: it ends once its throughput is gone
+// and, from the third bounce, by Russian roulette, which reweights survivors.
+bool survives_roulette(int bounce, inout vec3 throughput) {
+    float m = max(throughput.r, max(throughput.g, throughput.b));
+    if (m < 0.00001) 
+        return false; 
+
+    if (bounce > 1) {
+        m = min(m, 0.95);
+
+        if (sample_1d() > m) 
+            return false; 
+        throughput /= m;
+    }
+    return true;
+}
+
+float luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Samples this frame's colour is blended with: the pixel's accumulated
+// count, capped at what frame_count - 1 full frames would hold so the moving
+// average used while time runs keeps its length. previous receives the
+// pixel's statistics from the last frame.
+float pixel_history(ivec2 pixel, out vec4 previous) {
+    previous = vec4(0.0);
+    if (frame_count <= 1) return 0.0;
+    previous = texelFetch(previous_stats, pixel, 0);
+    return min(previous.g, float((frame_count - 1) * SAMPLES_PER_FRAME));
+}
+
+// Share of the frame's budget for a pixel whose estimate has the given
+// relative error: SAMPLES_PER_FRAME scaled by its error over the mean error
+// of the last frame, so the total stays at SAMPLES_PER_FRAME per pixel up to
+// the clamp. ADAPTIVE_ERROR_FLOOR keeps some samples going to converged
+// pixels so they notice when the scene changes under them. The fraction is
+// rounded stochastically, so a pixel owed 0.25 samples traces one every
+// fourth frame on average.
+const float ADAPTIVE_ERROR_FLOOR = 0.05;
+
+int adaptive_sample_count(ivec2 pixel, float error) {
+    int top_level = textureQueryLevels(previous_stats) - 1;
+    float mean_error = textureLod(previous_stats, vec2(0.5), float(top_level)).b;
+    if (!(mean_error > 0.0)) return SAMPLES_PER_FRAME;
+
+    float share = (error + ADAPTIVE_ERROR_FLOOR * mean_error) / (mean_error * (1.0 + ADAPTIVE_ERROR_FLOOR));
+    float expected = min(share * float(SAMPLES_PER_FRAME), float(MAX_SAMPLES_PER_PIXEL));
+    float u = unit_float(hash(uvec3(uvec2(pixel), frame_index)));
+    return int(expected + u);
+}
+
+// Camera paths to trace through a pixel this frame.
+int pixel_sample_count(ivec2 pixel, vec4 previous) {
+    if (adaptive_sampling != 0 && frame_count > 1) return adaptive_sample_count(pixel, previous.b);
+    return SAMPLES_PER_FRAME;
+}
+
+// Standard error of the pixel's mean luminance relative to the luminance
+// itself (plus a little, so black pixels do not divide by zero). Pixels
+// with fewer than two samples have no variance estimate and count as noisy.
+float relative_error(float mean, float second_moment, float count) {
+    if (count < 2.0) return 1.0;
+    float variance = max(second_moment - mean * mean, 0.0) * count / (count - 1.0);
+    return sqrt(variance / count) / (mean + 0.01);
+}
+
+// Blends the mean colour and squared luminance of this frame's n paths into
+// the pixel's history; returns the accumulated colour and statistics
+// (luminance second moment, sample count, relative error).
+void accumulate_pixel(ivec2 pixel, vec3 hdr_color, float luminance_sq, int n, vec4 previous, float history, out vec4 final_color, out vec4 stats) {
+    float total = history + float(n);
+    if (history > 0.0) {
+        vec3 previous_color = texelFetch(previous_acc, pixel, 0).rgb;
+        float blend_f = float(n) / total;
+        hdr_color = mix(previous_color, hdr_color, blend_f);
+        luminance_sq = mix(previous.r, luminance_sq, blend_f);
+    }
+
+    final_color = vec4(hdr_color, 1.0);
+    stats = vec4(luminance_sq, total, relative_error(luminance(hdr_color), luminance_sq, total), 0.0);
+}
+
+float viewZToNDC(float viewZ) {
+    float A = -(farPlane + nearPlane) / (farPlane - nearPlane);
+    float B = -(2.0 * farPlane * nearPlane) / (farPlane - nearPlane);
+    return (A * viewZ + B) / -viewZ;
+}
+
+// Denoiser inputs for a primary ray's hit rec on object obj_id.
+void gbuffer_hit(const object o, int obj_id, const hit_record rec, out vec4 world_normal, out vec4 albedo, out vec4 world_pos, out vec4 object_info) {
+    world_normal = vec4(normalize(rec.normal), 1.0);
+
+    albedo = surface_albedo_alpha(o, rec);
+
+    vec3 world_p = rec.p;
+    vec3 view_p = rotate(quat_inv(camRot_quat), world_p - camPos.xyz);
+    float ndcDepth = viewZToNDC(view_p.z);
+    world_pos = vec4(view_p, ndcDepth); 
+
+    object_info = vec4(float(obj_id), rec.m.metallic, rec.m.roughness, 1.0);
+}
+
+// Denoiser inputs for a primary ray that hits nothing; also what
+// VisibilityPrepass clears its targets to.
+void gbuffer_miss(out vec4 world_normal, out vec4 albedo, out vec4 world_pos, out vec4 object_info) {
+    world_normal = vec4(0.0);
+    albedo = vec4(0.0);
+    world_pos = vec4(0.0, 0.0, 1.0e18, 1.0);
+    object_info = vec4(-1.0, 0.0, 0.0, 1.0);
+}
+
+// Denoiser inputs from an unjittered primary ray through coord.
+void primary_gbuffer(vec2 coord, out vec4 world_normal, out vec4 albedo, out vec4 world_pos, out vec4 object_info) {
+    hit_record gbuffer_rec;
+    ray r = ray(camPos.xyz, getRayDir(coord));
+    int obj_id;
+    if (hit_camera_ray(r, pixel_tile(uvec2(coord)), FLT_MAX, gbuffer_rec, obj_id)) {
+        gbuffer_hit(load_object(obj_id), obj_id, gbuffer_rec, world_normal, albedo, world_pos, object_info);
+    } 
+    else {
+        gbuffer_miss(world_normal, albedo, world_pos, object_info);
+    }
+}
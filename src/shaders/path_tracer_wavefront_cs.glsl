@@ -0,0 +1,336 @@
+// Wavefront path tracer: the fragment pass split into compute kernels that
+// hand rays to each other through queues, so every kernel runs one short,
+// uniform step for many paths at once instead of one invocation following a
+// whole path. Compiled after path_tracer_common.glsl with one of the
+// WAVEFRONT_* kernel names defined (see WavefrontPathTracer).
+//
+// Each pixel owns one path slot. A frame runs sample passes; in each,
+// generate starts a camera path in every pixel that still owes a sample,
+// then extend (closest hit), shade (emission, light sample, scatter) and
+// shadow (visibility of the light samples) alternate until no path is left.
+// setup turns the queue counters into the next kernels' dispatch sizes, and
+// once no pixel owes another sample it empties generate's, so the passes
+// left in the frame dispatch no work.
+// resolve writes the same targets as the fragment pass.
+
+// Matches GPUwavefrontPath in UBOstructs.h.
+struct path_state {
+    vec3 origin;
+    float bsdf_pdf;         // mis_state of the vertex the ray left
+    vec3 direction;
+    float specular_pdf;
+    vec3 throughput;
+    uint flags;             // bounce in the low byte, PATH_* bits above
+    vec3 radiance;
+    uint sampler_dimension;
+    vec3 mis_vertex;
+    int hit_id;             // closest hit from extend; -1 for a miss
+};
+
+const uint PATH_BOUNCE_MASK = 0xFFu;
+const uint PATH_ANALYTIC_BIT = 0x100u;
+const uint PATH_WAS_DIFFUSE_BIT = 0x200u;
+
+// Matches GPUwavefrontShadowRay in UBOstructs.h; LIGHT_SAMPLES_PER_VERTEX
+// slots per path, a zero contribution marks an unused slot.
+struct shadow_ray {
+    vec3 origin;
+    float t_max;
+    vec3 direction;
+    int skip_id;
+    vec3 contribution;      // path throughput included
+    float u;
+};
+
+// Matches GPUwavefrontPixel in UBOstructs.h.
+struct pixel_accum {
+    vec3 sum;
+    float luminance_sq;     // sum of squared luminance
+    int samples;            // paths this frame
+};
+
+layout ( std430, binding = 5 ) buffer path_buf {
+    path_state paths[];
+};
+
+layout ( std430, binding = 6 ) readonly buffer ray_queue_in {
+    uint queue_in[];
+};
+
+layout ( std430, binding = 7 ) writeonly buffer ray_queue_out {
+    uint queue_out[];
+};
+
+layout ( std430, binding = 8 ) buffer shadow_ray_buf {
+    shadow_ray shadow_rays[];
+};
+
+layout ( std430, binding = 9 ) buffer shadow_queue_buf {
+    uint shadow_queue[];
+};
+
+// Matches GPUwavefrontCounters in UBOstructs.h. The *_groups fields double
+// as glDispatchComputeIndirect arguments.
+layout ( std430, binding = 10 ) buffer wavefront_counters {
+    uvec3 extend_groups;
+    uint ray_count;         // paths in queue_in
+    uvec3 shadow_groups;
+    uint shadow_count;      // paths in shadow_queue
+    uvec3 generate_groups;  // set by the host each frame, emptied by setup
+    uint max_samples;       // most samples any pixel asked for this frame
+    uint next_ray_count;    // appended to queue_out by generate and shade
+    uint next_shadow_count; // appended to shadow_queue by shade
+};
+
+layout ( std430, binding = 11 ) buffer pixel_buf {
+    pixel_accum pixel_sums[];
+};
+
+const uint WAVEFRONT_GROUP_SIZE = 64u;
+
+uniform int wavefront_sample; // sample pass of generate and setup; resolve gets the pass count
+
+uint pixel_slot(uvec2 pixel) {
+    return pixel.y * uint(res.x) + pixel.x;
+}
+
+uvec2 slot_pixel(uint slot) {
+    return uvec2(slot % uint(res.x), slot / uint(res.x));
+}
+
+void resume_sampler(uint slot, int sample_pass, uint dimension) {
+    init_sampler(slot_pixel(slot), uint(sample_pass));
+    sampler_dimension = dimension;
+}
+
+// Only the primary vertex samples lights through a tile, and it is always the
+// one a path at bounce 1 left, so the tile need not be stored.
+mis_state path_mis_state(const path_state path, uint slot) {
+    int light_tile = (path.flags & PATH_BOUNCE_MASK) == 1u ? pixel_tile(slot_pixel(slot)) : -1;
+    return mis_state(path.bsdf_pdf, path.specular_pdf, path.mis_vertex,
+                     (path.flags & PATH_ANALYTIC_BIT) != 0u, (path.flags & PATH_WAS_DIFFUSE_BIT) != 0u, light_tile);
+}
+
+void store_mis_state(inout path_state path, const mis_state mis) {
+    path.bsdf_pdf = mis.bsdf_pdf;
+    path.specular_pdf = mis.specular_pdf;
+    path.mis_vertex = mis.vertex;
+    path.flags &= PATH_BOUNCE_MASK;
+    if (mis.analytic) path.flags |= PATH_ANALYTIC_BIT;
+    if (mis.was_diffuse) path.flags |= PATH_WAS_DIFFUSE_BIT;
+}
+
+void push_ray(uint slot) {
+    queue_out[atomicAdd(next_ray_count, 1u)] = slot;
+}
+
+// Adds the finished path of the pixel's sample pass s to its sums.
+void deposit_path(inout pixel_accum acc, uint slot, int s) {
+    if (s < 0 || s >= acc.samples) return;
+    vec3 c = paths[slot].radiance;
+    if (any(isinf(c)) || any(isnan(c))) c = vec3(0.0);
+    acc.sum += c;
+    acc.luminance_sq += luminance(c) * luminance(c);
+}
+
+#if defined(WAVEFRONT_GENERATE)
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+void main() {
+    uvec2 pixel = gl_GlobalInvocationID.xy;
+    if (any(greaterThanEqual(vec2(pixel), res))) return;
+    uint slot = pixel_slot(pixel);
+
+    pixel_accum acc;
+    if (wavefront_sample == 0) {
+        vec4 previous;
+        pixel_history(ivec2(pixel), previous);
+        acc = pixel_accum(vec3(0.0), 0.0, pixel_sample_count(ivec2(pixel), previous));
+        atomicMax(max_samples, uint(acc.samples));
+    }
+    else {
+        acc = pixel_sums[slot];
+        deposit_path(acc, slot, wavefront_sample - 1);
+    }
+    pixel_sums[slot] = acc;
+    if (wavefront_sample >= acc.samples) return;
+
+    init_sampler(pixel, uint(wavefront_sample));
+    vec2 offset = sample_2d() - 0.5;
+    mis_state mis = camera_mis_state(camPos.xyz);
+
+    path_state path;
+    path.origin = camPos.xyz;
+    path.direction = getRayDir(vec2(pixel) + 0.5 + offset);
+    path.throughput = vec3(1.0);
+    path.radiance = vec3(0.0);
+    path.flags = 0u;
+    path.sampler_dimension = sampler_dimension;
+    path.hit_id = -1;
+    store_mis_state(path, mis);
+    paths[slot] = path;
+    push_ray(slot);
+}
+
+#elif defined(WAVEFRONT_SETUP)
+
+layout(local_size_x = 1) in;
+
+void main() {
+    // The next pass would only deposit this one's paths; resolve does that.
+    if (max_samples <= uint(wavefront_sample) + 1u) generate_groups = uvec3(0u, 1u, 1u);
+
+    ray_count = next_ray_count;
+    next_ray_count = 0u;
+    extend_groups = uvec3((ray_count + WAVEFRONT_GROUP_SIZE - 1u) / WAVEFRONT_GROUP_SIZE, 1u, 1u);
+
+    shadow_count = next_shadow_count;
+    next_shadow_count = 0u;
+    shadow_groups = uvec3((shadow_count + WAVEFRONT_GROUP_SIZE - 1u) / WAVEFRONT_GROUP_SIZE, 1u, 1u);
+}
+
+#elif defined(WAVEFRONT_EXTEND)
+
+layout(local_size_x = 64) in;
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= ray_count) return;
+    uint slot = queue_in[index];
+
+    // Until the first bounce the ray still runs along the camera ray.
+    int tile = (paths[slot].flags & PATH_BOUNCE_MASK) == 0u ? pixel_tile(slot_pixel(slot)) : -1;
+    hit_record rec;
+    int hit_id;
+    if (!hit_camera_ray(ray(paths[slot].origin, paths[slot].direction), tile, FLT_MAX, rec, hit_id)) hit_id = -1;
+    paths[slot].hit_id = hit_id;
+}
+
+#elif defined(WAVEFRONT_SHADE)
+
+layout(local_size_x = 64) in;
+
+// One iteration of color()'s bounce loop in path_tracer_fs.glsl; the light
+// sample's shadow ray is left to the shadow kernel.
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= ray_count) return;
+    uint slot = queue_in[index];
+
+    path_state path = paths[slot];
+    resume_sampler(slot, wavefront_sample, path.sampler_dimension);
+    ray cr = ray(path.origin, path.direction);
+    int bounce = int(path.flags & PATH_BOUNCE_MASK);
+    int vertex_tile = bounce == 0 ? pixel_tile(slot_pixel(slot)) : -1;
+
+    bool shadowed = false;
+    for (int s = 0; s < LIGHT_SAMPLES_PER_VERTEX; s++)
+        shadow_rays[slot * uint(LIGHT_SAMPLES_PER_VERTEX) + uint(s)].contribution = vec3(0.0);
+
+    if (path.hit_id < 0) {
+        paths[slot].radiance = path.radiance + path.throughput * sky_radiance(cr.direction);
+        return;
+    }
+
+    object hit_obj = load_object(path.hit_id);
+    hit_record rec;
+    hit_object(hit_obj, cr, T_MIN, FLT_MAX, rec);
+
+    vec4 surface = surface_albedo_alpha(hit_obj, rec);
+    if (passes_through(surface.a)) {
+        // Same bounce, from the far side of the translucent surface.
+        path.origin = rec.p;
+        path.sampler_dimension = sampler_dimension;
+        paths[slot] = path;
+        push_ray(slot);
+        return;
+    }
+
+    mis_state mis = path_mis_state(path, slot);
+    if (hit_obj.emissive)
+        path.radiance += path.throughput * emitter_radiance(hit_obj, path.hit_id, rec, cr.direction, bounce, mis);
+
+    for (int s = 0; s < LIGHT_SAMPLES_PER_VERTEX; s++) {
+        shadow_query q;
+        vec3 direct = sample_direct_light(rec, path.hit_id, vertex_tile, surface.rgb, -cr.direction, q);
+        if (direct == vec3(0.0)) continue;
+        shadow_rays[slot * uint(LIGHT_SAMPLES_PER_VERTEX) + uint(s)] =
+            shadow_ray(q.r.origin, q.t_max, q.r.direction, q.skip_id, path.throughput * direct, q.u);
+        shadowed = true;
+    }
+    if (shadowed) shadow_queue[atomicAdd(next_shadow_count, 1u)] = slot;
+
+    ray scattered;
+    path.throughput *= scatter_path(cr, rec, surface.rgb, vertex_tile, scattered, mis);
+    store_mis_state(path, mis);
+
+    bool alive = survives_roulette(bounce, path.throughput) && bounce + 1 < MAX_BOUNCES;
+    path.origin = scattered.origin;
+    path.direction = scattered.direction;
+    path.flags = (path.flags & ~PATH_BOUNCE_MASK) | uint(bounce + 1);
+    path.sampler_dimension = sampler_dimension;
+    paths[slot] = path;
+    if (alive) push_ray(slot);
+}
+
+#elif defined(WAVEFRONT_SHADOW)
+
+layout(local_size_x = 64) in;
+
+// A path has at most one set of shadow rays in flight, so adding to its
+// radiance here does not race with anything.
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= shadow_count) return;
+    uint slot = shadow_queue[index];
+
+    vec3 light = vec3(0.0);
+    for (int s = 0; s < LIGHT_SAMPLES_PER_VERTEX; s++) {
+        shadow_ray sr = shadow_rays[slot * uint(LIGHT_SAMPLES_PER_VERTEX) + uint(s)];
+        if (sr.contribution == vec3(0.0)) continue;
+        if (!is_occluded(ray(sr.origin, sr.direction), sr.t_max, sr.skip_id, sr.u)) light += sr.contribution;
+    }
+    paths[slot].radiance += light;
+}
+
+#elif defined(WAVEFRONT_RESOLVE)
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(rgba16f, binding = 0) uniform writeonly image2D out_color;
+layout(rgba16f, binding = 1) uniform writeonly image2D out_normal;
+layout(rgba16f, binding = 2) uniform writeonly image2D out_albedo;
+layout(rgba16f, binding = 3) uniform writeonly image2D out_position;
+layout(rgba16f, binding = 4) uniform writeonly image2D out_object_info;
+layout(rgba32f, binding = 5) uniform writeonly image2D out_stats;
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(vec2(pixel), res))) return;
+    uint slot = pixel_slot(uvec2(pixel));
+
+    // The last pass that ran; generate was emptied for any after it.
+    pixel_accum acc = pixel_sums[slot];
+    deposit_path(acc, slot, int(min(uint(wavefront_sample), max_samples)) - 1);
+
+    vec4 previous;
+    float history = pixel_history(pixel, previous);
+    int n = acc.samples;
+    vec3 hdr_color = n > 0 ? acc.sum / float(n) : vec3(0.0);
+    float luminance_sq = n > 0 ? acc.luminance_sq / float(n) : 0.0;
+
+    vec4 final_color, stats;
+    accumulate_pixel(pixel, hdr_color, luminance_sq, n, previous, history, final_color, stats);
+    imageStore(out_color, pixel, final_color);
+    imageStore(out_stats, pixel, stats);
+
+    vec4 world_normal, albedo, world_pos, object_info;
+    primary_gbuffer(vec2(pixel) + 0.5, world_normal, albedo, world_pos, object_info);
+    imageStore(out_normal, pixel, world_normal);
+    imageStore(out_albedo, pixel, albedo);
+    imageStore(out_position, pixel, world_pos);
+    imageStore(out_object_info, pixel, object_info);
+}
+
+#endif
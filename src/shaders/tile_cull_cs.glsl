@@ -0,0 +1,133 @@
+// Tile culling pre-pass of the path tracer: fills tile_buf (see
+// path_tracer_common.glsl) for this frame's camera. Compiled after
+// path_tracer_common.glsl with TILE_CULL_OBJECTS or TILE_CULL_LIGHTS defined
+// (see TileCuller). tile_buf starts the frame zeroed.
+//
+// objects bins every object into the tiles its projected bounding sphere
+// covers. lights then bounds each light's contribution to the points those
+// objects can put in the tile and keeps the lights within
+// TILE_LIGHT_CUTOFF of the strongest.
+
+// Lights with less than this fraction of the tile's largest bound stay with
+// the global table.
+const float TILE_LIGHT_CUTOFF = 0.01;
+
+#if defined(TILE_CULL_OBJECTS)
+
+layout(local_size_x = 64) in;
+
+void main() {
+    int j = int(gl_GlobalInvocationID.x);
+    if (j >= num_objects_active) return;
+
+    object o = load_object(j);
+    vec2 pixel_lo, pixel_hi;
+    if (!object_pixel_bounds(o, pixel_lo, pixel_hi)) return; // behind the camera
+    if (any(lessThan(pixel_hi, vec2(0.0))) || any(greaterThanEqual(pixel_lo, res))) return;
+
+    ivec2 tiles_size = ivec2(tile_columns(), (int(res.y) + TILE_SIZE - 1) / TILE_SIZE);
+    ivec2 first = max(ivec2(floor(pixel_lo)) / TILE_SIZE, ivec2(0));
+    ivec2 last = min(ivec2(floor(pixel_hi)) / TILE_SIZE, tiles_size - 1);
+
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++) {
+            int tile = y * tiles_size.x + x;
+            uint slot = atomicAdd(tiles[tile].object_count, 1u);
+            if (slot < uint(MAX_TILE_OBJECTS)) tiles[tile].objects[slot] = uint(j);
+        }
+    }
+}
+
+#elif defined(TILE_CULL_LIGHTS)
+
+layout(local_size_x = 64) in;
+
+// Depth range of the tile's objects, as float bits (they are not negative,
+// so the bits order like the values).
+shared uint near_bits;
+shared uint far_bits;
+shared uint max_weight_bits;
+shared uint light_count;
+shared tile_light kept[MAX_TILE_LIGHTS];
+
+// Bound on what light i of the alias table can add to a point within radius
+// of center: its power over its squared distance from the nearest such
+// point, or from its own surface if that is nearer.
+float light_weight(int i, vec3 center, float radius, int only_object) {
+    int j = int(lights[i].object);
+    if (j == only_object) return 0.0; // a convex emitter does not light itself
+    object light = load_object(j);
+    float r = object_bound_radius(light);
+    float dist = max(length(light.center - center) - radius, r);
+    return lights[i].pdf / (dist * dist);
+}
+
+void main() {
+    int tile = int(gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x);
+    uint count = tiles[tile].object_count;
+    // Empty tiles have no vertices to light and overflowed ones use the global table.
+    if (count == 0u || count > uint(MAX_TILE_OBJECTS) || num_lights <= 0) return;
+
+    uint local = gl_LocalInvocationID.x;
+    if (local == 0u) {
+        near_bits = floatBitsToUint(FLT_MAX);
+        far_bits = 0u;
+        max_weight_bits = 0u;
+        light_count = 0u;
+    }
+    barrier();
+
+    for (uint k = local; k < count; k += gl_WorkGroupSize.x) {
+        object o = load_object(int(tiles[tile].objects[k]));
+        float r = object_bound_radius(o);
+        float depth = -to_view(o.center).z;
+        atomicMin(near_bits, floatBitsToUint(max(depth - r, 0.0)));
+        atomicMax(far_bits, floatBitsToUint(max(depth + r, 0.0)));
+    }
+    barrier();
+
+    // Sphere around the tile's frustum between those depths, in world space.
+    float half_h = tan(camFov / 2.0);
+    vec2 half_extent = vec2(half_h * res.x / res.y, half_h);
+    vec2 ndc_lo = vec2(gl_WorkGroupID.xy * uint(TILE_SIZE)) / res * 2.0 - 1.0;
+    vec2 ndc_hi = min(vec2((gl_WorkGroupID.xy + 1u) * uint(TILE_SIZE)) / res, vec2(1.0)) * 2.0 - 1.0;
+    float z_near = uintBitsToFloat(near_bits);
+    float z_far = uintBitsToFloat(far_bits);
+    vec3 corners[8];
+    vec3 view_center = vec3(0.0);
+    for (int k = 0; k < 8; k++) {
+        vec2 ndc = vec2((k & 1) != 0 ? ndc_hi.x : ndc_lo.x, (k & 2) != 0 ? ndc_hi.y : ndc_lo.y);
+        float z = (k & 4) != 0 ? z_far : z_near;
+        corners[k] = vec3(ndc * half_extent * z, -z);
+        view_center += corners[k] / 8.0;
+    }
+    float radius = 0.0;
+    for (int k = 0; k < 8; k++) radius = max(radius, length(corners[k] - view_center));
+    vec3 center = camPos.xyz + rotate(camRot_quat, view_center);
+    int only_object = count == 1u ? int(tiles[tile].objects[0]) : -1;
+
+    for (int i = int(local); i < num_lights; i += int(gl_WorkGroupSize.x))
+        atomicMax(max_weight_bits, floatBitsToUint(light_weight(i, center, radius, only_object)));
+    barrier();
+
+    float cutoff = uintBitsToFloat(max_weight_bits) * TILE_LIGHT_CUTOFF;
+    for (int i = int(local); i < num_lights; i += int(gl_WorkGroupSize.x)) {
+        float w = light_weight(i, center, radius, only_object);
+        if (!(w > 0.0) || w < cutoff) continue;
+        uint slot = atomicAdd(light_count, 1u);
+        if (slot < uint(MAX_TILE_LIGHTS)) kept[slot] = tile_light(lights[i].object, w, lights[i].pdf);
+    }
+    barrier();
+
+    if (local != 0u) return;
+    uint kept_count = min(light_count, uint(MAX_TILE_LIGHTS));
+    float sum = 0.0;
+    for (uint k = 0u; k < kept_count; k++) {
+        tiles[tile].lights[k] = kept[k];
+        sum += kept[k].weight;
+    }
+    tiles[tile].light_count = kept_count;
+    tiles[tile].light_weight_sum = sum;
+}
+
+#endif
@@ -7,6 +7,7 @@ out vec4 FragColor;
 
 uniform vec3 trailColor;
 uniform sampler2D gbufferData; 
+uniform float dashCount;     // > 0 draws the line dashed (predicted paths)
 
 void main() {
 
@@ -15,6 +16,7 @@ void main() {
     float sceneNdcDepth = texture(gbufferData, texCoord).w;
 
     if (ndc.z > sceneNdcDepth + 0.00001) discard;
+    if (dashCount > 0.0 && fract(vAge * dashCount) > 0.5) discard;
     
     float alpha = 1.0 - vAge;
     FragColor = vec4(trailColor, alpha * alpha);
@@ -0,0 +1,35 @@
+// Visibility pre-pass, fragment stage (see VisibilityPrepass): casts the
+// pixel's unjittered camera ray, the one primary_gbuffer traces, at the
+// impostor's object. A hit writes the object's G-buffer values with a depth
+// that grows as the hit nears, so the depth test keeps the closest object; a
+// miss writes the miss values with a depth below any hit's, which only beats
+// the cleared depth. Either way the fragment counts in the stencil, and the
+// object that wins the pixel is stored with it: path_tracer_fs.glsl reads it
+// back as visibility_objects to start its camera rays from.
+// Compiled after path_tracer_common.glsl.
+
+flat in int object_id;
+
+layout(location = 0) out vec4 g_WorldNormal;
+layout(location = 1) out vec4 g_Albedo;
+layout(location = 2) out vec4 g_WorldPos;
+layout(location = 3) out vec4 g_ObjectInfo;
+layout(location = 4) out int g_VisibleObject;
+
+// Below 1 / (1 + t) for every hit, as t < FLT_MAX.
+const float MISS_DEPTH = 1.0e-30;
+
+void main() {
+    g_VisibleObject = object_id;
+
+    ray r = ray(camPos.xyz, getRayDir(gl_FragCoord.xy));
+    object o = load_object(object_id);
+    float t;
+    if (!intersect_object(o, r, T_MIN, FLT_MAX, t)) {
+        gbuffer_miss(g_WorldNormal, g_Albedo, g_WorldPos, g_ObjectInfo);
+        gl_FragDepth = MISS_DEPTH;
+        return;
+    }
+    gbuffer_hit(o, object_id, object_hit(o, r, t), g_WorldNormal, g_Albedo, g_WorldPos, g_ObjectInfo);
+    gl_FragDepth = 1.0 / (1.0 + t);
+}
@@ -0,0 +1,17 @@
+// Visibility pre-pass, vertex stage (see VisibilityPrepass): instance j is
+// the rectangle object j's bounding sphere covers on screen, the same bound
+// tile_cull_cs.glsl bins by, as a four-vertex strip. Compiled after
+// path_tracer_common.glsl.
+
+flat out int object_id;
+
+void main() {
+    object_id = gl_InstanceID;
+    vec2 pixel_lo, pixel_hi;
+    if (!object_pixel_bounds(load_object(gl_InstanceID), pixel_lo, pixel_hi)) {
+        gl_Position = vec4(0.0); // behind the camera: a degenerate quad
+        return;
+    }
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    gl_Position = vec4(mix(pixel_lo, pixel_hi, corner) / res * 2.0 - 1.0, 0.0, 1.0);
+}